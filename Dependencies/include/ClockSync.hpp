@@ -0,0 +1,109 @@
+/*
+Copyright (c) 2025 Dave Quinn <qcent@yahoo.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#pragma once
+
+#include <cstdint>
+
+// NTP style estimate of the sender's clock against ours from timestamp round trips:
+// t1 our stamp in the feedback, t2 / t3 the sender's receive / echo time, t4 the echo's arrival.
+// offset = ((t1 - t2) + (t4 - t3)) / 2, round trip = (t4 - t1) - (t3 - t2)
+// Frame timestamps are 32 bit, so offsets are kept modulo 2^32 and only differences are signed
+class ClockSync {
+public:
+    static constexpr int WINDOW = 8;                    // samples, the shortest round trip wins
+    static constexpr int64_t MAX_ROUND_TRIP_US = 2000000; // longer round trips are stale echoes
+    static constexpr int64_t DRIFT_SPAN_US = 10000000;  // drift is measured once estimates span this long
+
+    uint32_t samples = 0;
+
+private:
+    struct Sample {
+        int64_t roundTrip = 0;
+        uint32_t offset = 0;        // our clock - sender clock
+        int64_t time = 0;           // our clock at t4
+    };
+    Sample window[WINDOW];
+    int count = 0;
+    int next = 0;
+
+    bool synced = false;
+    Sample best;                    // current estimate
+    bool haveAnchor = false;
+    Sample anchor;                  // first estimate, the drift is the slope from it
+    double drift = 0.0;             // us of offset change per us
+
+public:
+    void reset() {
+        count = next = 0;
+        samples = 0;
+        synced = haveAnchor = false;
+        drift = 0.0;
+    }
+
+    // Returns the sample's round trip (us), -1 when it was rejected
+    int64_t add_sample(uint32_t t1, uint32_t t2, uint32_t t3, int64_t t4) {
+        const uint32_t arrival = static_cast<uint32_t>(t4);
+        int64_t elapsed = static_cast<int32_t>(arrival - t1);
+        int64_t held = static_cast<int32_t>(t3 - t2);
+        int64_t roundTrip = elapsed - held;
+        if (elapsed > MAX_ROUND_TRIP_US || held < 0 || roundTrip < 0) return -1;
+
+        uint32_t a = t1 - t2;
+        uint32_t b = arrival - t3;
+        Sample& s = window[next];
+        s.roundTrip = roundTrip;
+        s.offset = a + static_cast<uint32_t>(static_cast<int32_t>(b - a) / 2);
+        s.time = t4;
+        next = (next + 1) % WINDOW;
+        if (count < WINDOW) ++count;
+        ++samples;
+
+        const Sample* min = &window[0];
+        for (int i = 1; i < count; ++i) {
+            if (window[i].roundTrip < min->roundTrip) min = &window[i];
+        }
+        best = *min;
+        synced = true;
+
+        if (!haveAnchor) {
+            anchor = best;
+            haveAnchor = true;
+        }
+        else if (best.time - anchor.time >= DRIFT_SPAN_US) {
+            // the longer the span the less the round trip noise of either end matters
+            drift = static_cast<int32_t>(best.offset - anchor.offset) / static_cast<double>(best.time - anchor.time);
+        }
+        return roundTrip;
+    }
+
+    bool is_synced() const { return synced; }
+    double round_trip_ms() const { return best.roundTrip / 1000.0; }
+    double drift_ppm() const { return drift * 1e6; }
+
+    // Microseconds a frame stamped sendStamp by the sender spent on the way, if it arrived at arrival (our clock)
+    int64_t one_way_delay(uint32_t sendStamp, int64_t arrival) const {
+        if (!synced) return 0;
+        uint32_t offset = best.offset + static_cast<uint32_t>(static_cast<int64_t>(drift * (arrival - best.time)));
+        return static_cast<int32_t>(static_cast<uint32_t>(arrival) - sendStamp - offset);
+    }
+};
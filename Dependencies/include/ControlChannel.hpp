@@ -0,0 +1,150 @@
+/*
+Copyright (c) 2025 Dave Quinn <qcent@yahoo.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <winsock2.h>
+
+constexpr int CONTROL_RTO_MILLISECONDS = 20;        // first resend, doubles each time
+constexpr int CONTROL_MAX_RTO_MILLISECONDS = 160;
+constexpr int CONTROL_TIMEOUT_MILLISECONDS = 400;   // an unanswered signal is given up after this
+constexpr int MAX_CONTROL_PENDING = 16;
+constexpr int CONTROL_HISTORY = 16;
+
+// A control signal waiting for its acknowledgement, or due for a resend
+struct ControlSignal {
+    uint8_t type;           // Of UDPConnection::PacketType
+    uint16_t sessionId;
+    uint16_t seq;           // never 0, a seq_number of 0 means "no ack wanted"
+    sockaddr_in to;
+};
+
+// Bookkeeping for acked control signals (hang-up, ...) between peers that agreed to them
+// (NETJOY_CAP_ACKED_SIGNALS). Sent signals are kept with a doubling resend timer until acknowledged
+// or CONTROL_TIMEOUT_MILLISECONDS pass; received ones are remembered so a resend whose ack was
+// lost is acked again but not acted on twice. Input frames never go through here.
+// Times are netjoy_clock_us() microseconds: a 20 ms RTO is barely more than one ~15.6 ms
+// GetTickCount64 step. A feedback thread and the send loop may share one channel
+class ControlChannel {
+private:
+    struct Pending {
+        ControlSignal signal;
+        int64_t resendAt;
+        int64_t giveUpAt;
+        int64_t rto;
+        bool used;
+    };
+    struct Delivered {
+        sockaddr_in from;
+        uint16_t sessionId;
+        uint16_t seq;
+    };
+
+    mutable std::mutex mtx;
+    Pending pending[MAX_CONTROL_PENDING] = {};
+    Delivered delivered[CONTROL_HISTORY] = {};
+    int deliveredCount = 0;
+    int deliveredNext = 0;
+    uint16_t nextSeq = 1;
+
+    static bool same_peer(const sockaddr_in& a, const sockaddr_in& b) {
+        return a.sin_addr.s_addr == b.sin_addr.s_addr && a.sin_port == b.sin_port;
+    }
+
+public:
+    void reset() {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (auto& p : pending) p.used = false;
+        deliveredCount = 0;
+        deliveredNext = 0;
+    }
+
+    // Gives a signal for to a fresh seq and keeps it for resending, returns the seq. When every slot
+    // is busy the oldest signal is given up for it
+    uint16_t track(uint8_t type, uint16_t sessionId, const sockaddr_in& to, int64_t now) {
+        std::lock_guard<std::mutex> lock(mtx);
+        Pending* slot = &pending[0];
+        for (auto& p : pending) {
+            if (!p.used) { slot = &p; break; }
+            if (p.giveUpAt < slot->giveUpAt) slot = &p;
+        }
+        const uint16_t seq = nextSeq++;
+        if (nextSeq == 0) nextSeq = 1;
+
+        slot->signal = { type, sessionId, seq, to };
+        slot->rto = CONTROL_RTO_MILLISECONDS * 1000LL;
+        slot->resendAt = now + slot->rto;
+        slot->giveUpAt = now + CONTROL_TIMEOUT_MILLISECONDS * 1000LL;
+        slot->used = true;
+        return seq;
+    }
+
+    // Called with the ack_number of a PACKET_SIG_ACK from a peer
+    void acknowledge(uint16_t seq, const sockaddr_in& from) {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (auto& p : pending) {
+            if (p.used && p.signal.seq == seq && same_peer(p.signal.to, from)) p.used = false;
+        }
+    }
+
+    // true while the signal sent with seq is neither acknowledged nor given up
+    bool is_pending(uint16_t seq) const {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (const auto& p : pending) {
+            if (p.used && p.signal.seq == seq) return true;
+        }
+        return false;
+    }
+
+    // Next signal whose resend timer has run out (its timer is doubled), false when none is.
+    // Signals past their deadline are dropped
+    bool next_due(int64_t now, ControlSignal& out) {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (auto& p : pending) {
+            if (!p.used || now < p.resendAt) continue;
+            if (now >= p.giveUpAt) {
+                p.used = false;
+                continue;
+            }
+            if (p.rto < CONTROL_MAX_RTO_MILLISECONDS * 1000LL) p.rto *= 2;
+            p.resendAt = now + p.rto;
+            out = p.signal;
+            return true;
+        }
+        return false;
+    }
+
+    // true the first time a signal arrives, false for a resend of one already acted on
+    bool first_delivery(const sockaddr_in& from, uint16_t sessionId, uint16_t seq) {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (int i = 0; i < deliveredCount; ++i) {
+            const Delivered& d = delivered[i];
+            if (d.seq == seq && d.sessionId == sessionId && same_peer(d.from, from)) return false;
+        }
+        delivered[deliveredNext] = { from, sessionId, seq };
+        deliveredNext = (deliveredNext + 1) % CONTROL_HISTORY;
+        if (deliveredCount < CONTROL_HISTORY) ++deliveredCount;
+        return true;
+    }
+};
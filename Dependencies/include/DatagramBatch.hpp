@@ -0,0 +1,185 @@
+/*
+Copyright (c) 2025 Dave Quinn <qcent@yahoo.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#pragma once
+
+#include <cstring>
+#ifdef _WIN32
+#include <winsock2.h>
+typedef SOCKET DatagramSocket;
+#else
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+typedef int DatagramSocket;
+#endif
+
+// Preallocated datagrams for receive_datagrams / send_datagrams, each tagged with its peer address
+struct UDPBatch {
+    static constexpr int MAX_PACKETS = 64;
+    static constexpr int PACKET_SIZE = 512;
+
+    struct Packet {
+        sockaddr_in address;
+        int size;
+        char data[PACKET_SIZE];
+    };
+    Packet packets[MAX_PACKETS];
+    int count = 0;
+
+    bool full() const { return count == MAX_PACKETS; }
+    void clear() { count = 0; }
+
+    // Queues a datagram for send_datagrams, returns false when the batch is full or it does not fit
+    bool add(const char* data, int size, const sockaddr_in& to) {
+        if (full() || size < 0 || size > PACKET_SIZE) return false;
+        Packet& p = packets[count++];
+        p.address = to;
+        p.size = size;
+        std::memcpy(p.data, data, size);
+        return true;
+    }
+};
+
+// Appends the datagrams already queued on s to batch without waiting (until it is full), returns how
+// many were added. error is set to what stopped the drain, 0 when the socket ran dry.
+// Linux takes the whole lot in one recvmmsg, elsewhere it is one recvfrom per datagram and on
+// Winsock the socket has to be non-blocking for the call (UDPConnection::receive_batch sees to it).
+// A datagram from a peer that went away (ICMP port unreachable) or one too big for a packet is skipped
+inline int receive_datagrams(DatagramSocket s, UDPBatch& batch, int& error) {
+    error = 0;
+    const int first = batch.count;
+#if defined(__linux__)
+    mmsghdr headers[UDPBatch::MAX_PACKETS];
+    iovec vectors[UDPBatch::MAX_PACKETS];
+    while (!batch.full()) {
+        const int room = UDPBatch::MAX_PACKETS - batch.count;
+        for (int i = 0; i < room; ++i) {
+            UDPBatch::Packet& p = batch.packets[batch.count + i];
+            vectors[i].iov_base = p.data;
+            vectors[i].iov_len = UDPBatch::PACKET_SIZE;
+            std::memset(&headers[i].msg_hdr, 0, sizeof(headers[i].msg_hdr));
+            headers[i].msg_hdr.msg_name = &p.address;
+            headers[i].msg_hdr.msg_namelen = sizeof(p.address);
+            headers[i].msg_hdr.msg_iov = &vectors[i];
+            headers[i].msg_hdr.msg_iovlen = 1;
+        }
+        int n = recvmmsg(s, headers, room, MSG_DONTWAIT, nullptr);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) error = errno;
+            break;
+        }
+        // recvmmsg fills the slots in order, close the gaps truncated datagrams leave
+        int kept = batch.count;
+        for (int i = 0; i < n; ++i) {
+            if (headers[i].msg_hdr.msg_flags & MSG_TRUNC) continue;
+            if (kept != batch.count + i) batch.packets[kept] = batch.packets[batch.count + i];
+            batch.packets[kept++].size = static_cast<int>(headers[i].msg_len);
+        }
+        batch.count = kept;
+        if (n < room) break;
+    }
+#else
+    int skipped = 0;
+    while (!batch.full()) {
+        UDPBatch::Packet& p = batch.packets[batch.count];
+#ifdef _WIN32
+        int fromLen = sizeof(p.address);
+        p.size = recvfrom(s, p.data, UDPBatch::PACKET_SIZE, 0, (sockaddr*)&p.address, &fromLen);
+        if (p.size != SOCKET_ERROR) {
+            ++batch.count;
+            continue;
+        }
+        int err = WSAGetLastError();
+        if (err == WSAEWOULDBLOCK) break;
+        if ((err == WSAECONNRESET || err == WSAEMSGSIZE) && ++skipped < UDPBatch::MAX_PACKETS) continue;
+#else
+        iovec vector = { p.data, UDPBatch::PACKET_SIZE };
+        msghdr header{};
+        header.msg_name = &p.address;
+        header.msg_namelen = sizeof(p.address);
+        header.msg_iov = &vector;
+        header.msg_iovlen = 1;
+        p.size = static_cast<int>(recvmsg(s, &header, MSG_DONTWAIT));
+        if (p.size >= 0) {
+            if (!(header.msg_flags & MSG_TRUNC)) ++batch.count;
+            continue;
+        }
+        int err = errno;
+        if (err == EAGAIN || err == EWOULDBLOCK) break;
+        if ((err == EINTR || err == ECONNREFUSED) && ++skipped < UDPBatch::MAX_PACKETS) continue;
+#endif
+        error = err;
+        break;
+    }
+#endif
+    return batch.count - first;
+}
+
+// Sends every datagram in the batch, returns how many went out. error is set to the last send that
+// failed, a failed datagram does not hold up the rest. Linux hands the batch over in one sendmmsg
+inline int send_datagrams(DatagramSocket s, const UDPBatch& batch, int& error) {
+    error = 0;
+    int sent = 0;
+#if defined(__linux__)
+    mmsghdr headers[UDPBatch::MAX_PACKETS];
+    iovec vectors[UDPBatch::MAX_PACKETS];
+    for (int i = 0; i < batch.count; ++i) {
+        const UDPBatch::Packet& p = batch.packets[i];
+        vectors[i].iov_base = const_cast<char*>(p.data);
+        vectors[i].iov_len = p.size;
+        std::memset(&headers[i].msg_hdr, 0, sizeof(headers[i].msg_hdr));
+        headers[i].msg_hdr.msg_name = const_cast<sockaddr_in*>(&p.address);
+        headers[i].msg_hdr.msg_namelen = sizeof(p.address);
+        headers[i].msg_hdr.msg_iov = &vectors[i];
+        headers[i].msg_hdr.msg_iovlen = 1;
+    }
+    int next = 0;
+    while (next < batch.count) {
+        int n = sendmmsg(s, headers + next, batch.count - next, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            error = errno;
+            ++next;     // sendmmsg stops at the datagram that failed, skip it
+            continue;
+        }
+        sent += n;
+        next += n;
+    }
+#else
+    for (int i = 0; i < batch.count; ++i) {
+        const UDPBatch::Packet& p = batch.packets[i];
+        if (sendto(s, p.data, p.size, 0, (const sockaddr*)&p.address, sizeof(p.address)) < 0) {
+#ifdef _WIN32
+            error = WSAGetLastError();
+#else
+            error = errno;
+#endif
+            continue;
+        }
+        ++sent;
+    }
+#endif
+    return sent;
+}
@@ -0,0 +1,202 @@
+/*
+Copyright (c) 2025 Dave Quinn <qcent@yahoo.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include "NetJoyProtocol.h"
+
+// Stands in for input frames that are lost or late. While no real report is due it extrapolates the
+// analog axes (sticks, triggers and on a DS4 the gyro / accel words) of the last two real reports along
+// their slope, one report per sender frame interval, for at most the horizon. Once the horizon has
+// passed one more report puts the last real one back, so a pad that lost its sender is not left
+// wherever the extrapolation ended. Buttons are copied from the last real report, so a predicted
+// report never presses or releases anything. The next real report replaces the prediction as is
+// (snap to truth), and how far off the prediction was is kept
+class DeadReckoning {
+public:
+    // An analog value inside a report: offset, 1 (uint8) or 2 (int16) bytes
+    struct Axis { int offset; int width; };
+
+    static constexpr Axis XUSB_AXES[] = { { 2, 1 }, { 3, 1 }, { 4, 2 }, { 6, 2 }, { 8, 2 }, { 10, 2 } };
+    static constexpr Axis DS4_AXES[] = { { 0, 1 }, { 1, 1 }, { 2, 1 }, { 3, 1 }, { 7, 1 }, { 8, 1 },
+        { DS4_MOTION_OFFSET, 2 }, { DS4_MOTION_OFFSET + 2, 2 }, { DS4_MOTION_OFFSET + 4, 2 },
+        { DS4_MOTION_OFFSET + 6, 2 }, { DS4_MOTION_OFFSET + 8, 2 }, { DS4_MOTION_OFFSET + 10, 2 } };
+    static constexpr int XUSB_REPORT_SIZE = 12;
+    static constexpr int DS4_REPORT_SIZE = 61;
+
+    // Counters for output
+    uint32_t predicted = 0;         // reports made up
+    uint32_t gaps = 0;              // gaps a real report ended after predictions
+    uint32_t restored = 0;          // gaps that outlasted the horizon, last real report put back
+    double errorSum = 0.0;          // per gap, largest axis error as a fraction of the axis range
+    double errorMax = 0.0;
+
+private:
+    int64_t horizonUs = 0;
+    char last[MAX_FRAME_PAYLOAD_SIZE];
+    char before[MAX_FRAME_PAYLOAD_SIZE];
+    char guess[MAX_FRAME_PAYLOAD_SIZE];
+    int size = 0;
+    int history = 0;                // real reports held, up to 2
+    uint32_t lastStamp = 0;         // sender clock of last / before, us
+    uint32_t beforeStamp = 0;
+    int64_t lastAt = 0;             // our clock when last was handed out
+    int run = 0;                    // reports predicted since last
+    bool settled = false;           // last put back after the horizon, nothing more until a real report
+    int64_t ahead = 0;              // us past last on the sender's timeline of the newest prediction
+
+    const Axis* axes(int& count) const {
+        if (size == DS4_REPORT_SIZE) {
+            count = sizeof(DS4_AXES) / sizeof(Axis);
+            return DS4_AXES;
+        }
+        count = (size == XUSB_REPORT_SIZE) ? sizeof(XUSB_AXES) / sizeof(Axis) : 0;
+        return XUSB_AXES;
+    }
+
+    static int read_axis(const char* report, const Axis& a) {
+        if (a.width == 1) return static_cast<uint8_t>(report[a.offset]);
+        int16_t v;
+        std::memcpy(&v, report + a.offset, sizeof(v));
+        return v;
+    }
+
+    static void write_axis(char* report, const Axis& a, double value) {
+        const double low = (a.width == 1) ? 0.0 : -32768.0;
+        const double high = (a.width == 1) ? 255.0 : 32767.0;
+        value = value < low ? low : value > high ? high : value;
+        int v = static_cast<int>(value + (value < 0 ? -0.5 : 0.5));
+        if (a.width == 1) {
+            report[a.offset] = static_cast<char>(v);
+            return;
+        }
+        int16_t w = static_cast<int16_t>(v);
+        std::memcpy(report + a.offset, &w, sizeof(w));
+    }
+
+    // Sender frame interval, from the client's rate or the last two stamps
+    int64_t interval_us(int clientRate) const {
+        if (clientRate > 0) return 1000000 / clientRate;
+        int64_t spacing = static_cast<int32_t>(lastStamp - beforeStamp);
+        return spacing > 0 ? spacing : 0;
+    }
+
+public:
+    DeadReckoning(int horizonMillisec = 0) : horizonUs(horizonMillisec * 1000LL) {}
+
+    bool enabled() const { return horizonUs > 0; }
+    // How far past the last real report the newest prediction reached, us
+    int64_t horizon_us() const { return ahead; }
+
+    void reset() {
+        history = 0;
+        size = 0;
+        run = 0;
+        settled = false;
+        predicted = gaps = restored = 0;
+        errorSum = errorMax = 0.0;
+    }
+
+    // A real report handed to the pad, sendStamp is its sender clock
+    void observe(const char* report, int reportSize, uint32_t sendStamp, int64_t now) {
+        if (!enabled()) return;
+        if (reportSize != size) history = 0;
+        if (run > 0 && history == 2) {
+            // how far the last prediction was from the truth that replaces it
+            int count;
+            const Axis* a = axes(count);
+            double worst = 0.0;
+            for (int i = 0; i < count; ++i) {
+                double range = (a[i].width == 1) ? 255.0 : 65535.0;
+                double error = (read_axis(report, a[i]) - read_axis(guess, a[i])) / range;
+                if (error < 0) error = -error;
+                if (error > worst) worst = error;
+            }
+            ++gaps;
+            errorSum += worst;
+            if (worst > errorMax) errorMax = worst;
+        }
+        if (history > 0) {
+            std::memcpy(before, last, size);
+            beforeStamp = lastStamp;
+        }
+        size = reportSize;
+        std::memcpy(last, report, size);
+        lastStamp = sendStamp;
+        lastAt = now;
+        if (history < 2) ++history;
+        run = 0;
+        settled = false;
+    }
+
+    // Microseconds until a report should be made up, -1 when none will be (no slope yet, or past the
+    // horizon with the last real report put back)
+    int64_t time_until_due(int clientRate, int64_t now) const {
+        if (!enabled() || history < 2 || settled) return -1;
+        const int64_t interval = interval_us(clientRate);
+        if (interval <= 0) return -1;
+        // half an interval of slack, a real report a little late is not a gap
+        const int64_t due = lastAt + interval * (run + 1) + interval / 2;
+        // past the horizon only the report putting last back is left, none when nothing was predicted
+        if (due - lastAt > horizonUs && run == 0) return -1;
+        return due > now ? due - now : 0;
+    }
+
+    // Writes the predicted report into out when one is due, returns its size or 0. The report due
+    // after the horizon is the last real one, it is not counted as predicted
+    int predict(char* out, int clientRate, int64_t now) {
+        if (time_until_due(clientRate, now) != 0) return 0;
+        const int64_t interval = interval_us(clientRate);
+        if (interval * (run + 1) + interval / 2 > horizonUs) {
+            settled = true;
+            ++restored;
+            std::memcpy(out, last, size);
+            return size;
+        }
+        const int64_t spacing = static_cast<int32_t>(lastStamp - beforeStamp);
+        // a report ahead on the sender's timeline, for each interval passed
+        ahead = interval * (run + 1);
+
+        std::memcpy(guess, last, size);
+        int count;
+        const Axis* a = axes(count);
+        for (int i = 0; i < count && spacing > 0; ++i) {
+            const int current = read_axis(last, a[i]);
+            const double slope = static_cast<double>(current - read_axis(before, a[i])) / spacing;
+            write_axis(guess, a[i], current + slope * ahead);
+        }
+        if (size == DS4_REPORT_SIZE) {
+            // DS4 clock ticks (5.33 us) moved on with the frames, so motion is integrated over them
+            uint16_t ticks;
+            std::memcpy(&ticks, last + DS4_TIMESTAMP_OFFSET, sizeof(ticks));
+            ticks = static_cast<uint16_t>(ticks + ahead * 3 / 16);
+            std::memcpy(guess + DS4_TIMESTAMP_OFFSET, &ticks, sizeof(ticks));
+        }
+
+        ++run;
+        ++predicted;
+        std::memcpy(out, guess, size);
+        return size;
+    }
+};
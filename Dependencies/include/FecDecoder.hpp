@@ -0,0 +1,114 @@
+/*
+Copyright (c) 2025 Dave Quinn <qcent@yahoo.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include "NetJoyProtocol.h"
+
+// Keeps the recent frame datagrams of a FEC protected stream and rebuilds the one
+// missing from a parity group when its FRAME_PARITY arrives
+class FecDecoder {
+public:
+    static constexpr int SLOTS = 2 * MAX_FEC_GROUP;     // power of 2, indexed by seq
+
+    // Counters for output / debugging
+    uint32_t recovered = 0;     // datagrams rebuilt from parity
+    uint32_t lost = 0;          // datagrams missing from groups parity could not repair
+
+private:
+    struct Slot {
+        bool used = false;
+        uint16_t seq = 0;
+        int size = 0;
+        char data[MAX_FRAME_PACKET_SIZE];
+    };
+    Slot slots[SLOTS];
+
+public:
+    void reset() {
+        for (Slot& s : slots) s.used = false;
+        recovered = lost = 0;
+    }
+
+    // Remembers a received frame datagram for the parity of its group
+    void store(const char* packet, int size) {
+        if (size < FRAME_HEADER_SIZE || size > MAX_FRAME_PACKET_SIZE) return;
+        FrameHeader hdr;
+        std::memcpy(&hdr, packet, FRAME_HEADER_SIZE);
+        Slot& slot = slots[hdr.seq & (SLOTS - 1)];
+        slot.used = true;
+        slot.seq = hdr.seq;
+        slot.size = size;
+        std::memcpy(slot.data, packet, size);
+    }
+
+    // Rebuilds the lost datagram of the parity's group into out (at least MAX_FRAME_PACKET_SIZE bytes),
+    // returns its size or 0 when nothing was lost or more than one datagram was
+    int recover(const char* parity, int size, char* out) {
+        if (size < FRAME_HEADER_SIZE + PARITY_HEADER_SIZE) return 0;
+        FrameHeader hdr;
+        ParityHeader ph;
+        std::memcpy(&hdr, parity, FRAME_HEADER_SIZE);
+        std::memcpy(&ph, parity + FRAME_HEADER_SIZE, PARITY_HEADER_SIZE);
+        const char* xorData = parity + FRAME_HEADER_SIZE + PARITY_HEADER_SIZE;
+        int xorSize = size - FRAME_HEADER_SIZE - PARITY_HEADER_SIZE;
+
+        int group = hdr.flags;
+        if (group < MIN_FEC_GROUP || group > MAX_FEC_GROUP) return 0;
+
+        int missing = 0;
+        uint16_t missingSeq = 0;
+        for (int i = 0; i < group; ++i) {
+            uint16_t seq = static_cast<uint16_t>(hdr.seq + i);
+            const Slot& slot = slots[seq & (SLOTS - 1)];
+            if (!slot.used || slot.seq != seq) {
+                ++missing;
+                missingSeq = seq;
+            }
+        }
+        if (missing == 0) return 0;
+        if (missing > 1) {
+            lost += missing;
+            return 0;
+        }
+
+        uint16_t lostSize = ph.sizeXor;
+        std::memset(out, 0, MAX_FRAME_PACKET_SIZE);
+        std::memcpy(out, xorData, xorSize < MAX_FRAME_PACKET_SIZE ? xorSize : MAX_FRAME_PACKET_SIZE);
+        for (int i = 0; i < group; ++i) {
+            uint16_t seq = static_cast<uint16_t>(hdr.seq + i);
+            if (seq == missingSeq) continue;
+            const Slot& slot = slots[seq & (SLOTS - 1)];
+            lostSize ^= static_cast<uint16_t>(slot.size);
+            for (int b = 0; b < slot.size; ++b) out[b] ^= slot.data[b];
+        }
+        if (lostSize < FRAME_HEADER_SIZE || lostSize > MAX_FRAME_PACKET_SIZE || lostSize > xorSize) {
+            ++lost;
+            return 0;
+        }
+        ++recovered;
+        store(out, lostSize);
+        return lostSize;
+    }
+};
@@ -0,0 +1,76 @@
+/*
+Copyright (c) 2025 Dave Quinn <qcent@yahoo.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include "NetJoyProtocol.h"
+
+static_assert(FEEDBACK_DATA_SIZE <= 5, "FeedbackState packs the feedback bytes into 40 bits");
+
+// Rumble + lightbar bytes of a virtual pad, written by its ViGEm feedback thread / callback and
+// read by the receive loop without a lock. The bytes and a 24 bit generation share one 64 bit
+// atomic: a reader gets a consistent snapshot in a single load and sees new state as a new
+// generation. Writes that change nothing keep the generation
+class FeedbackState {
+public:
+    static constexpr int GENERATION_SHIFT = 40;
+    static constexpr uint64_t DATA_MASK = (1ULL << GENERATION_SHIFT) - 1;
+
+private:
+    std::atomic<uint64_t> packed{ 0 };
+
+public:
+    // Writers: replaces count bytes from offset, the others are kept
+    void store(const char* data, int offset = 0, int count = FEEDBACK_DATA_SIZE) {
+        uint64_t old = packed.load(std::memory_order_relaxed);
+        uint64_t next;
+        do {
+            next = old & DATA_MASK;
+            for (int i = 0; i < count && offset + i < FEEDBACK_DATA_SIZE; ++i) {
+                const int shift = (offset + i) * 8;
+                next = (next & ~(0xFFULL << shift)) | (static_cast<uint64_t>(static_cast<uint8_t>(data[i])) << shift);
+            }
+            if (next == (old & DATA_MASK)) return;
+            next |= ((old >> GENERATION_SHIFT) + 1) << GENERATION_SHIFT;
+        } while (!packed.compare_exchange_weak(old, next, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    void clear() {
+        const char zero[FEEDBACK_DATA_SIZE] = { 0 };
+        store(zero);
+    }
+
+    // Readers: one snapshot, taken apart with generation() and copy()
+    uint64_t load() const { return packed.load(std::memory_order_acquire); }
+
+    static uint32_t generation(uint64_t snapshot) {
+        return static_cast<uint32_t>(snapshot >> GENERATION_SHIFT);
+    }
+
+    // Copies the FEEDBACK_DATA_SIZE bytes of snapshot into out
+    static void copy(uint64_t snapshot, char* out) {
+        for (int i = 0; i < FEEDBACK_DATA_SIZE; ++i)
+            out[i] = static_cast<char>((snapshot >> (i * 8)) & 0xFF);
+    }
+};
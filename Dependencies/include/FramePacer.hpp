@@ -0,0 +1,173 @@
+/*
+Copyright (c) 2025 Dave Quinn <qcent@yahoo.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <cstdio>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include "LatencyHistogram.hpp"
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+// Paces a loop to a fixed rate from absolute deadlines: deadline n is start + n periods, so
+// oversleeping one frame is taken back from the next instead of the rate drifting. Each wait
+// sleeps until shortly before the deadline (a high resolution waitable timer where Windows
+// has one) and spins the rest. The spin margin follows how far the sleeps overshoot.
+// Falling a whole period behind re-anchors the schedule rather than bursting to catch up
+class FramePacer {
+public:
+    using clock = std::chrono::steady_clock;
+    static constexpr int64_t MIN_SPIN_US = 100;
+    static constexpr int64_t MAX_SPIN_US = 2000;
+    static constexpr int64_t MISS_THRESHOLD_US = 500;   // later than this past a deadline counts as a miss
+
+private:
+    clock::time_point start;
+    clock::time_point deadline;
+    clock::duration period{ 0 };
+    double rate = 0.0;
+    int64_t overshoot = 1000;   // us, how late sleeps wake, rises fast and decays slowly
+#ifdef _WIN32
+    HANDLE timer = NULL;
+#endif
+
+    static int64_t to_us(clock::duration d) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+    }
+
+    void sleep_us(int64_t us) {
+#ifdef _WIN32
+        if (timer != NULL) {
+            LARGE_INTEGER due;
+            due.QuadPart = -us * 10; // relative, 100 ns units
+            if (SetWaitableTimer(timer, &due, 0, NULL, NULL, FALSE)) {
+                WaitForSingleObject(timer, INFINITE);
+                return;
+            }
+        }
+        Sleep(static_cast<DWORD>(us / 1000));
+#else
+        std::this_thread::sleep_for(std::chrono::microseconds(us));
+#endif
+    }
+
+    static void relax() {
+#ifdef _WIN32
+        YieldProcessor();
+#else
+        std::this_thread::yield();
+#endif
+    }
+
+public:
+    uint64_t frames = 0;
+    uint64_t missed = 0;        // woke more than MISS_THRESHOLD_US late
+    uint64_t skipped = 0;       // whole periods given up after falling behind
+    LatencyHistogram lateness;  // us past each deadline
+
+    FramePacer() {
+#ifdef _WIN32
+        timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+#endif
+    }
+
+    ~FramePacer() {
+#ifdef _WIN32
+        if (timer != NULL) CloseHandle(timer);
+#endif
+    }
+
+    FramePacer(const FramePacer&) = delete;
+    FramePacer& operator=(const FramePacer&) = delete;
+
+    // Starts a new schedule at rateHz, the first deadline one period from now
+    void reset(double rateHz) {
+        frames = missed = skipped = 0;
+        lateness.reset();
+        rate = 0.0;
+        set_rate(rateHz);
+        start = clock::now();
+        deadline = start + period;
+    }
+
+    // Changes the rate from the next deadline on
+    void set_rate(double rateHz) {
+        if (rateHz <= 0.0 || rateHz == rate) return;
+        clock::duration next = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / rateHz));
+        if (rate > 0.0) deadline += next - period;
+        period = next;
+        rate = rateHz;
+    }
+
+    // Blocks until the next deadline
+    void wait() {
+        const int64_t spin = (overshoot + MIN_SPIN_US < MAX_SPIN_US) ? overshoot + MIN_SPIN_US : MAX_SPIN_US;
+        const int64_t remaining = to_us(deadline - clock::now());
+        if (remaining > spin) {
+            const clock::time_point target = deadline - std::chrono::microseconds(spin);
+            sleep_us(remaining - spin);
+            const int64_t over = to_us(clock::now() - target);
+            if (over > overshoot) overshoot = (overshoot + over) / 2;
+            else overshoot -= (overshoot - (over > 0 ? over : 0)) / 16;
+        }
+        clock::time_point now = clock::now();
+        while (now < deadline) {
+            relax();
+            now = clock::now();
+        }
+
+        const int64_t late = to_us(now - deadline);
+        lateness.record(late);
+        if (late > MISS_THRESHOLD_US) ++missed;
+        ++frames;
+
+        deadline += period;
+        if (now >= deadline) {
+            skipped += static_cast<uint64_t>((now - deadline) / period) + 1;
+            deadline = now + period;
+        }
+    }
+
+    double target_rate() const { return rate; }
+
+    // Waits per second since reset()
+    double achieved_rate() const {
+        double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+        return elapsed > 0.0 ? frames / elapsed : 0.0;
+    }
+
+    // "80.0 / 80 Hz, 2 missed, 0 skipped, late p50 / p99 / max ..."
+    std::string summary() const {
+        char text[64];
+        snprintf(text, sizeof(text), "%.1f / %.0f Hz, %llu missed, %llu skipped", achieved_rate(), rate,
+            static_cast<unsigned long long>(missed), static_cast<unsigned long long>(skipped));
+        return std::string(text) + ", late p50/p90/p99/p99.9/max " + lateness.summary();
+    }
+};
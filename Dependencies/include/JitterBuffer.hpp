@@ -0,0 +1,218 @@
+/*
+Copyright (c) 2025 Dave Quinn <qcent@yahoo.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include "NetJoyProtocol.h"
+
+// Holds sequenced input frames and releases them on the sender's timeline.
+// Each frame is played out at: sender timestamp + fastest observed transit + depth
+// where depth follows the measured inter-arrival jitter (RFC 3550 estimator)
+class JitterBuffer {
+public:
+    static constexpr int SLOTS = 32;                    // power of 2, indexed by seq
+    static constexpr int64_t TRANSIT_WINDOW_US = 2000000; // rolling window for the fastest transit
+    static constexpr int JITTER_MULTIPLIER = 3;         // depth = JITTER_MULTIPLIER * jitter
+
+    // Counters for output / debugging
+    uint32_t received = 0;
+    uint32_t played = 0;
+    uint32_t droppedLate = 0;       // arrived after a newer frame was already played
+    uint32_t droppedDuplicate = 0;
+    uint32_t recovered = 0;         // lost frames filled in from redundant copies
+
+private:
+    struct Slot {
+        bool used = false;
+        uint16_t seq = 0;
+        int64_t sendTime = 0;       // unwrapped sender timestamp
+        int size = 0;
+        char data[MAX_FRAME_PAYLOAD_SIZE];
+    };
+    Slot slots[SLOTS];
+    int count = 0;
+
+    int64_t maxDepth = 0;           // us, 0 plays frames as soon as they are in order
+    int64_t depth = 0;              // us, current target depth
+
+    // sender clock unwrapping
+    bool haveSendTime = false;
+    uint32_t lastSendStamp = 0;
+    int64_t lastSendTime = 0;
+
+    // transit (arrival - send) tracking
+    bool haveTransit = false;
+    int64_t lastTransit = 0;
+    int64_t windowMin = std::numeric_limits<int64_t>::max();
+    int64_t prevWindowMin = std::numeric_limits<int64_t>::max();
+    int64_t windowStart = 0;
+    double jitter = 0.0;            // us
+
+    bool havePlayed = false;
+    uint16_t lastPlayedSeq = 0;
+    int64_t lastPlayedSendTime = 0;
+
+    int64_t base_transit() const {
+        return windowMin < prevWindowMin ? windowMin : prevWindowMin;
+    }
+
+    int64_t unwrap_send_time(uint32_t stamp) {
+        if (!haveSendTime) {
+            haveSendTime = true;
+            lastSendStamp = stamp;
+            lastSendTime = stamp;
+            return lastSendTime;
+        }
+        int64_t t = lastSendTime + static_cast<int32_t>(stamp - lastSendStamp);
+        if (t > lastSendTime) {
+            lastSendStamp = stamp;
+            lastSendTime = t;
+        }
+        return t;
+    }
+
+    void update_transit(int64_t transit, int64_t arrival) {
+        if (arrival - windowStart > TRANSIT_WINDOW_US) {
+            prevWindowMin = windowMin;
+            windowMin = std::numeric_limits<int64_t>::max();
+            windowStart = arrival;
+        }
+        if (transit < windowMin) windowMin = transit;
+
+        if (haveTransit) {
+            int64_t d = transit - lastTransit;
+            if (d < 0) d = -d;
+            jitter += (static_cast<double>(d) - jitter) / 16.0;
+        }
+        haveTransit = true;
+        lastTransit = transit;
+
+        depth = static_cast<int64_t>(jitter * JITTER_MULTIPLIER);
+        if (depth > maxDepth) depth = maxDepth;
+    }
+
+    // oldest buffered frame, or nullptr when empty
+    const Slot* next_slot() const {
+        const Slot* best = nullptr;
+        for (const Slot& s : slots) {
+            if (s.used && (best == nullptr || seq_newer(best->seq, s.seq)))
+                best = &s;
+        }
+        return best;
+    }
+
+public:
+    JitterBuffer(int maxDepthMillisec = 0) {
+        set_max_depth(maxDepthMillisec);
+    }
+
+    void set_max_depth(int maxDepthMillisec) {
+        maxDepth = static_cast<int64_t>(maxDepthMillisec < 0 ? 0 : maxDepthMillisec) * 1000;
+        if (depth > maxDepth) depth = maxDepth;
+    }
+
+    void reset() {
+        for (Slot& s : slots) s.used = false;
+        count = 0;
+        depth = 0;
+        haveSendTime = false;
+        haveTransit = false;
+        windowMin = prevWindowMin = std::numeric_limits<int64_t>::max();
+        windowStart = 0;
+        jitter = 0.0;
+        havePlayed = false;
+        received = played = droppedLate = droppedDuplicate = recovered = 0;
+    }
+
+    // Queues a frame, returns false if it was dropped as late or duplicate.
+    // Redundant copies of earlier frames only fill gaps: they are not counted
+    // when already seen and are kept out of the transit / jitter estimate
+    bool push(const FrameHeader& hdr, const char* payload, int size, int64_t arrival, bool redundant = false) {
+        if (!redundant) ++received;
+        if (havePlayed && !seq_newer(hdr.seq, lastPlayedSeq)) {
+            if (redundant) return false;
+            if (hdr.seq == lastPlayedSeq) ++droppedDuplicate;
+            else ++droppedLate;
+            return false;
+        }
+        Slot& slot = slots[hdr.seq & (SLOTS - 1)];
+        if (slot.used) {
+            if (slot.seq == hdr.seq) {
+                if (!redundant) ++droppedDuplicate;
+                return false;
+            }
+            if (seq_newer(slot.seq, hdr.seq)) {
+                if (!redundant) ++droppedLate;
+                return false;
+            }
+            --count; // a full lap behind, the stale frame gets replaced
+        }
+
+        int64_t sendTime = unwrap_send_time(hdr.timestamp);
+        if (redundant) ++recovered;
+        else update_transit(arrival - sendTime, arrival);
+
+        if (size > MAX_FRAME_PAYLOAD_SIZE) size = MAX_FRAME_PAYLOAD_SIZE;
+        slot.used = true;
+        slot.seq = hdr.seq;
+        slot.sendTime = sendTime;
+        slot.size = size;
+        std::memcpy(slot.data, payload, size);
+        ++count;
+        return true;
+    }
+
+    // Copies the oldest frame into out if it is due, returns its size or 0
+    int pop(char* out, int64_t now) {
+        const Slot* s = next_slot();
+        if (s == nullptr) return 0;
+        if (count < SLOTS / 2 && s->sendTime + base_transit() + depth > now) return 0;
+
+        Slot& slot = slots[s->seq & (SLOTS - 1)];
+        std::memcpy(out, slot.data, slot.size);
+        slot.used = false;
+        --count;
+
+        havePlayed = true;
+        lastPlayedSeq = slot.seq;
+        lastPlayedSendTime = slot.sendTime;
+        ++played;
+        return slot.size;
+    }
+
+    // Microseconds until the oldest frame is due, -1 when empty
+    int64_t time_until_next(int64_t now) const {
+        const Slot* s = next_slot();
+        if (s == nullptr) return -1;
+        int64_t wait = s->sendTime + base_transit() + depth - now;
+        return wait > 0 ? wait : 0;
+    }
+
+    int size() const { return count; }
+    double depth_ms() const { return depth / 1000.0; }
+    double jitter_ms() const { return jitter / 1000.0; }
+    // sender timestamp of the last frame pop() handed out
+    uint32_t last_played_stamp() const { return static_cast<uint32_t>(lastPlayedSendTime); }
+};
@@ -0,0 +1,143 @@
+/*
+Copyright (c) 2025 Dave Quinn <qcent@yahoo.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <cstdio>
+
+// Fixed memory log-linear histogram of microsecond values (HdrHistogram style). Values below
+// SUB_BUCKETS are counted exactly, above that each power of two is split into SUB_BUCKETS / 2
+// linear steps, so a reported value is within 1 / (SUB_BUCKETS / 2) (~3%) of the recorded one.
+// record() is a handful of integer ops and never allocates, cheap enough to leave on
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BUCKET_BITS = 6;
+    static constexpr int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static constexpr int HALF_BUCKETS = SUB_BUCKETS / 2;
+    static constexpr int VALUE_BITS = 32;               // values clamp at ~71 minutes
+    static constexpr int BUCKETS = SUB_BUCKETS + (VALUE_BITS - SUB_BUCKET_BITS) * HALF_BUCKETS;
+
+private:
+    uint32_t counts[BUCKETS];
+    uint64_t total = 0;
+    uint64_t sum = 0;
+    uint32_t minValue = 0;
+    uint32_t maxValue = 0;
+
+    static int index_of(uint32_t v) {
+        if (v < SUB_BUCKETS) return static_cast<int>(v);
+        int shift = 1;
+        while ((v >> shift) >= SUB_BUCKETS) ++shift;
+        return SUB_BUCKETS + (shift - 1) * HALF_BUCKETS + static_cast<int>((v >> shift) - HALF_BUCKETS);
+    }
+
+    // Highest value that lands in bucket i
+    static uint64_t value_of(int i) {
+        if (i < SUB_BUCKETS) return static_cast<uint64_t>(i);
+        int j = i - SUB_BUCKETS;
+        int shift = j / HALF_BUCKETS + 1;
+        uint64_t sub = static_cast<uint64_t>(j % HALF_BUCKETS + HALF_BUCKETS);
+        return ((sub + 1) << shift) - 1;
+    }
+
+public:
+    LatencyHistogram() { reset(); }
+
+    void reset() {
+        std::memset(counts, 0, sizeof(counts));
+        total = sum = 0;
+        minValue = maxValue = 0;
+    }
+
+    void record(int64_t microseconds) {
+        uint32_t v = (microseconds <= 0) ? 0 : (microseconds >= UINT32_MAX) ? UINT32_MAX : static_cast<uint32_t>(microseconds);
+        ++counts[index_of(v)];
+        if (total == 0 || v < minValue) minValue = v;
+        if (v > maxValue) maxValue = v;
+        ++total;
+        sum += v;
+    }
+
+    uint64_t count() const { return total; }
+    double mean_ms() const { return total ? sum / 1000.0 / total : 0.0; }
+    double max_ms() const { return maxValue / 1000.0; }
+    double min_ms() const { return minValue / 1000.0; }
+
+    // Smallest value (ms) that percent of the recorded values are at or below
+    double percentile_ms(double percent) const {
+        if (total == 0) return 0.0;
+        uint64_t target = static_cast<uint64_t>(percent / 100.0 * total + 0.5);
+        if (target < 1) target = 1;
+        uint64_t seen = 0;
+        for (int i = 0; i < BUCKETS; ++i) {
+            seen += counts[i];
+            if (seen >= target) {
+                uint64_t v = value_of(i);
+                return (v < maxValue ? v : maxValue) / 1000.0;
+            }
+        }
+        return max_ms();
+    }
+
+    // "p50 / p90 / p99 / p99.9 / max" in ms
+    std::string summary() const {
+        char text[96];
+        snprintf(text, sizeof(text), "%.2f / %.2f / %.2f / %.2f / %.2f ms", percentile_ms(50), percentile_ms(90),
+            percentile_ms(99), percentile_ms(99.9), max_ms());
+        return text;
+    }
+
+    // Percentiles followed by every non empty bucket as "upper bound (us), count"
+    void write(std::ostream& out, const char* name) const {
+        out << name << " : " << total << " samples, mean " << mean_ms() << " ms, min " << min_ms() << " ms\n";
+        out << "  p50 / p90 / p99 / p99.9 / max : " << summary() << "\n";
+        for (int i = 0; i < BUCKETS; ++i) {
+            if (counts[i]) out << "  " << value_of(i) << ", " << counts[i] << "\n";
+        }
+    }
+};
+
+// Histograms kept for each connection
+struct LatencyStats {
+    LatencyHistogram inputToApply;  // sender stamp to the report being handed to the pad (needs clock sync)
+    LatencyHistogram arrivalJitter; // |change in transit time| between consecutive datagrams
+    LatencyHistogram feedbackRtt;   // feedback -> echoing frame round trip
+    LatencyHistogram predictionHorizon; // last real report to each one made up for a gap (--predict)
+
+    void reset() {
+        inputToApply.reset();
+        arrivalJitter.reset();
+        feedbackRtt.reset();
+        predictionHorizon.reset();
+    }
+
+    void write(std::ostream& out) const {
+        inputToApply.write(out, "Input to apply");
+        arrivalJitter.write(out, "Arrival jitter");
+        feedbackRtt.write(out, "Feedback RTT");
+        if (predictionHorizon.count()) predictionHorizon.write(out, "Prediction horizon");
+    }
+};
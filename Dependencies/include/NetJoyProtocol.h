@@ -0,0 +1,996 @@
+/*
+Copyright (c) 2025 Dave Quinn <qcent@yahoo.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#pragma once
+
+#ifndef NETJOY_PROTOCOL_H
+#define NETJOY_PROTOCOL_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+
+// Bumped whenever the input frame format changes
+// 0 : raw XUSB_REPORT / DS4 slice per datagram (pre framing)
+// 1 : every input datagram starts with a FrameHeader
+// 2 : reports may be sent as deltas against an acknowledged keyframe
+// 3 : frames may be bundled with redundant copies of the frames before them
+// 4 : groups of frames may be followed by an XOR parity datagram
+// 5 : feedback carries a receiver timestamp that frames echo back (clock offset estimation)
+// 6 : feedback carries link statistics, the sender adapts its rate and announces it
+// 7 : DS4 reports may be sent as motion deltas against the frame before them
+constexpr uint8_t NETJOY_PROTOCOL_VERSION = 7;
+constexpr uint8_t NETJOY_PROTOCOL_DELTA = 2;
+constexpr uint8_t NETJOY_PROTOCOL_BUNDLE = 3;
+constexpr uint8_t NETJOY_PROTOCOL_FEC = 4;
+constexpr uint8_t NETJOY_PROTOCOL_CLOCK = 5;
+constexpr uint8_t NETJOY_PROTOCOL_RATE = 6;
+constexpr uint8_t NETJOY_PROTOCOL_IMU = 7;
+
+// JoyReceiver's reply to the opening "fps:mode" text of older clients, a framing capable
+// host appends the protocol version it agreed to as one extra byte, followed
+// by the parity group size it agreed to when the client asked for FEC
+constexpr char GO_FOR_JOY_MSG[] = "Go for Joy!";
+constexpr int GO_FOR_JOY_SIZE = sizeof(GO_FOR_JOY_MSG);
+
+// Opening exchange: the client sends a HelloMessage, the host answers with a WelcomeMessage
+// holding what it agreed to. Hosts still answer the old text message, which starts with a digit
+constexpr uint32_t NETJOY_HELLO_MAGIC = 0x49484A4E;     // "NJHI"
+constexpr uint32_t NETJOY_WELCOME_MAGIC = 0x45574A4E;   // "NJWE"
+// Sent by an adaptive client whenever its report rate changes, until the host's LinkReport shows it
+constexpr uint32_t NETJOY_RATE_MAGIC = 0x54524A4E;      // "NJRT"
+
+// Features offered in a hello, the welcome carries the ones both sides will use
+enum NetJoyCapability : uint32_t {
+    NETJOY_CAP_BINARY_HELLO = 0x01, // speaks HelloMessage / WelcomeMessage
+    NETJOY_CAP_TIMESTAMPS = 0x02,   // sequenced, timestamped input frames (UDP)
+    NETJOY_CAP_DELTA = 0x04,        // reports sent as deltas against a keyframe
+    NETJOY_CAP_BATCHING = 0x08,     // frames bundled with redundant copies
+    NETJOY_CAP_FEC = 0x10,          // XOR parity datagrams
+    NETJOY_CAP_MULTI_PAD = 0x20,    // host serves several senders on one port
+    NETJOY_CAP_CLOCK = 0x40,        // timestamp round trips for clock offset estimation
+    NETJOY_CAP_RATE = 0x80,         // link statistics in feedback, client adapts its rate
+    NETJOY_CAP_STREAM = 0x100,      // length-prefixed, typed messages after the welcome (TCP)
+    NETJOY_CAP_ACKED_SIGNALS = 0x200, // control signals are acknowledged and resent (UDP)
+    NETJOY_CAP_RESUME = 0x400,      // the host keeps the pad of a dropped session for its sender to resume
+    NETJOY_CAP_IMU_DELTA = 0x800,   // DS4 reports sent as motion deltas against the previous report
+};
+
+// WelcomeMessage::flags
+enum WelcomeFlags : uint8_t {
+    WELCOME_FLAG_RESUMED = 0x01,    // the sender got back the pad of the session it resumed
+};
+
+// Report format of the emulated pad, same values as the sender's --mode
+enum NetJoyReportFormat : uint8_t {
+    REPORT_FORMAT_XUSB = 1,
+    REPORT_FORMAT_DS4 = 2,
+};
+
+// Input frame packet types, kept clear of UDPConnection::PacketType values
+// so a datagram can be identified by its first byte
+enum FrameType : uint8_t {
+    FRAME_REPORT = 0x10,    // Sender-> Receiver: full input report
+    FRAME_DELTA = 0x11,     // Sender-> Receiver: changed words against a keyframe
+    FRAME_BUNDLE = 0x12,    // Sender-> Receiver: newest frame + redundant copies of the ones before it
+    FRAME_PARITY = 0x13,    // Sender-> Receiver: XOR of the previous group of frame datagrams
+    FRAME_IMU_DELTA = 0x14, // Sender-> Receiver: DS4 report as motion deltas against the frame before it
+};
+
+enum FrameFlags : uint8_t {
+    FRAME_FLAG_KEYFRAME = 0x01, // full report the receiver should store and acknowledge
+    FRAME_FLAG_CLOCK = 0x02,    // datagram ends with a ClockEcho (not on FRAME_PARITY, whose flags hold the group size)
+};
+
+// Messages of a streamed TCP connection (NETJOY_CAP_STREAM), each is a StreamHeader followed
+// by length bytes, so reports, signals and feedback are told apart by type rather than size
+enum StreamMessageType : uint8_t {
+    STREAM_INPUT = 0x20,    // Sender-> Receiver: bare input report
+    STREAM_SIGNAL = 0x21,   // Either way: UDPConnection::SIGPacket
+    STREAM_FEEDBACK = 0x22, // Receiver-> Sender: feedback reply
+    STREAM_IMU_DELTA = 0x23, // Sender-> Receiver: DS4 report as motion deltas against the previous input
+};
+
+// ImuDeltaHeader::flags, which optional blocks follow
+enum ImuDeltaFlags : uint8_t {
+    IMU_FLAG_CONTROLS = 0x01,   // sticks, buttons and triggers changed
+    IMU_FLAG_BATTERY = 0x02,    // battery level changed
+    IMU_FLAG_TAIL = 0x04,       // touchpad / status bytes after the motion words changed
+};
+
+#pragma pack(push, 1)
+struct FrameHeader {
+    uint8_t  type;          // Of FrameType
+    uint8_t  flags;         // Reserved
+    uint16_t seq;           // Incremented for every frame, wraps
+    uint32_t timestamp;     // Sender clock in microseconds, wraps
+};
+
+// Follows the FrameHeader of a FRAME_DELTA, then one 16 bit word of the report
+// for each set bit of mask (the last word of an odd sized report is a single byte)
+struct DeltaHeader {
+    uint16_t baseSeq;       // Sequence number of the keyframe the words patch
+    uint32_t mask;          // Bit n set: word n of the report changed
+};
+
+// Follows the FrameHeader of a FRAME_BUNDLE (whose seq/timestamp are the newest frame's),
+// then the newest frame's payload, then count BundleEntry + copy pairs, newest first.
+// Copy n has seq (newest seq - n) and is a delta (DeltaHeader + words) against copy n - 1
+struct BundleHeader {
+    uint8_t frameType;      // FRAME_REPORT or FRAME_DELTA, encoding of the newest frame
+    uint8_t frameSize;      // Payload bytes of the newest frame
+    uint8_t count;          // Redundant copies that follow
+};
+
+struct BundleEntry {
+    uint32_t timestamp;     // Sender clock of the copy
+    uint8_t size;           // Bytes of the delta that follows
+};
+
+// Payload of a FRAME_IMU_DELTA / STREAM_IMU_DELTA, patches the DS4 report sent just before it.
+// Followed by bSpecial (the report counter + PS / touchpad click), the sticks, buttons and triggers
+// when IMU_FLAG_CONTROLS is set, the wTimestamp step as a zig-zag varint, the battery level when
+// IMU_FLAG_BATTERY is set, the six gyro / accel steps as zig-zag varints and, when IMU_FLAG_TAIL is
+// set, a uint32 word mask + the changed words of the rest of the report (as in a FRAME_DELTA)
+struct ImuDeltaHeader {
+    uint16_t baseSeq;       // Sequence number of the frame patched (0 on a stream)
+    uint8_t flags;          // Of ImuDeltaFlags
+};
+
+// A FRAME_PARITY's FrameHeader carries the group size in flags and the seq of the
+// group's first datagram in seq. Its payload is ParityHeader followed by the XOR of
+// the group's datagrams (FrameHeader included), each zero padded to the longest
+struct ParityHeader {
+    uint16_t sizeXor;       // XOR of the datagram sizes
+};
+
+// Trailer of a frame datagram flagged FRAME_FLAG_CLOCK, answers the newest receiver
+// timestamp the sender got in feedback. Sender receive time = FrameHeader::timestamp - heldFor
+struct ClockEcho {
+    uint32_t receiverStamp; // Receiver clock in microseconds, as sent in the feedback
+    uint32_t heldFor;       // Microseconds between the feedback arriving and this frame being stamped
+};
+
+struct HelloMessage {
+    uint32_t magic;         // NETJOY_HELLO_MAGIC
+    uint8_t  version;       // Highest frame protocol version the client speaks
+    uint8_t  format;        // Of NetJoyReportFormat
+    uint16_t rate;          // Reports per second the client will send
+    uint32_t capabilities;  // NetJoyCapability bits offered
+    uint16_t sessionId;     // UDP handshake session id, else the resume token of an earlier welcome or 0 (TCP)
+    uint8_t  fecGroup;      // Requested parity group size, 0 for none
+    uint8_t  reserved;
+};
+
+struct WelcomeMessage {
+    uint32_t magic;         // NETJOY_WELCOME_MAGIC
+    uint8_t  version;       // Frame protocol version to use, 0 sends bare reports
+    uint8_t  fecGroup;      // Agreed parity group size, 0 for none
+    uint16_t sessionId;     // Echo of the hello's session id, with NETJOY_CAP_RESUME the token to resume with
+    uint32_t capabilities;  // NetJoyCapability bits both sides will use
+    uint8_t  pad;           // Player number on a multi-pad host, 0 otherwise
+    uint8_t  flags;         // Of WelcomeFlags
+    uint8_t  reserved[2];
+};
+
+struct StreamHeader {
+    uint8_t  type;          // Of StreamMessageType
+    uint16_t length;        // Bytes that follow
+};
+
+struct RateMessage {
+    uint32_t magic;         // NETJOY_RATE_MAGIC
+    uint16_t rate;          // Reports per second the client sends from now on
+    uint16_t reserved;
+};
+
+// Follows the clock stamp in the feedback of a rate capable host (protocol 6), covers the
+// frames received since the previous feedback
+struct LinkReport {
+    uint16_t rate;          // Client rate the host is running with, the last one announced
+    uint8_t  loss;          // Fraction of frames lost, in 256ths
+    uint8_t  jitter;        // Inter arrival jitter in 100 us units, saturates
+    uint16_t roundTrip;     // Newest feedback -> frame round trip in 100 us units, 0 while unknown
+};
+#pragma pack(pop)
+
+constexpr int HELLO_SIZE = sizeof(HelloMessage);
+constexpr int WELCOME_SIZE = sizeof(WelcomeMessage);
+// Room for either reply to the opening message
+constexpr int MAX_WELCOME_REPLY_SIZE = (WELCOME_SIZE > GO_FOR_JOY_SIZE + 2) ? WELCOME_SIZE : GO_FOR_JOY_SIZE + 2;
+constexpr int RATE_MESSAGE_SIZE = sizeof(RateMessage);
+constexpr int STREAM_HEADER_SIZE = sizeof(StreamHeader);
+constexpr int MAX_STREAM_PAYLOAD = 256;     // longer messages mean the stream is corrupt
+constexpr int STREAM_BUFFER_SIZE = 2048;
+constexpr int LINK_REPORT_SIZE = sizeof(LinkReport);
+
+inline bool is_hello_message(const char* data, int size) {
+    uint32_t magic;
+    if (size != HELLO_SIZE) return false;
+    std::memcpy(&magic, data, sizeof(magic));
+    return magic == NETJOY_HELLO_MAGIC;
+}
+
+inline bool is_welcome_message(const char* data, int size) {
+    uint32_t magic;
+    if (size != WELCOME_SIZE) return false;
+    std::memcpy(&magic, data, sizeof(magic));
+    return magic == NETJOY_WELCOME_MAGIC;
+}
+
+inline bool is_rate_message(const char* data, int size) {
+    uint32_t magic;
+    if (size != RATE_MESSAGE_SIZE) return false;
+    std::memcpy(&magic, data, sizeof(magic));
+    return magic == NETJOY_RATE_MAGIC;
+}
+
+constexpr int FRAME_HEADER_SIZE = sizeof(FrameHeader);
+constexpr int DELTA_HEADER_SIZE = sizeof(DeltaHeader);
+constexpr int MAX_FRAME_PAYLOAD_SIZE = 64;
+constexpr int DELTA_WORD_SIZE = 2;
+constexpr int BUNDLE_HEADER_SIZE = sizeof(BundleHeader);
+constexpr int BUNDLE_ENTRY_SIZE = sizeof(BundleEntry);
+constexpr int MAX_BUNDLE_REDUNDANCY = 4;
+constexpr int CLOCK_ECHO_SIZE = sizeof(ClockEcho);
+// Largest datagram a FrameWriter produces (a bundle at MAX_BUNDLE_REDUNDANCY, nothing compressible)
+constexpr int MAX_FRAME_PACKET_SIZE = FRAME_HEADER_SIZE + BUNDLE_HEADER_SIZE + DELTA_HEADER_SIZE + MAX_FRAME_PAYLOAD_SIZE + CLOCK_ECHO_SIZE
+                                    + MAX_BUNDLE_REDUNDANCY * (BUNDLE_ENTRY_SIZE + DELTA_HEADER_SIZE + MAX_FRAME_PAYLOAD_SIZE);
+constexpr int PARITY_HEADER_SIZE = sizeof(ParityHeader);
+constexpr int MIN_FEC_GROUP = 2;
+constexpr int MAX_FEC_GROUP = 16;
+// Largest datagram on the input stream, receive buffers need to hold this much
+constexpr int MAX_DATAGRAM_SIZE = FRAME_HEADER_SIZE + PARITY_HEADER_SIZE + MAX_FRAME_PACKET_SIZE;
+static_assert(MAX_FRAME_PAYLOAD_SIZE / DELTA_WORD_SIZE <= 32, "DeltaHeader::mask is too small");
+
+// DS4_REPORT_EX layout the motion delta codec works on
+constexpr int IMU_DELTA_HEADER_SIZE = sizeof(ImuDeltaHeader);
+constexpr int DS4_SPECIAL_OFFSET = 6;       // bSpecial: counter << 2 | touchpad click | PS
+constexpr int DS4_TIMESTAMP_OFFSET = 9;     // wTimestamp
+constexpr int DS4_BATTERY_OFFSET = 11;      // bBatteryLvl
+constexpr int DS4_MOTION_OFFSET = 12;       // wGyroX..wAccelZ
+constexpr int DS4_MOTION_WORDS = 6;
+constexpr int DS4_TAIL_OFFSET = DS4_MOTION_OFFSET + DS4_MOTION_WORDS * 2;
+constexpr int DS4_TOUCH_FINGERS_OFFSET = 34;    // sCurrentTouch past its bPacketCounter: two fingers
+constexpr int DS4_TOUCH_FINGERS_SIZE = 8;       // of bIsUpTrackingNum + 3 bytes of X / Y
+// Longest encode_imu_delta output: every block present, 3 byte varints and the tail word mask
+constexpr int MAX_IMU_DELTA_SIZE = IMU_DELTA_HEADER_SIZE + MAX_FRAME_PAYLOAD_SIZE + 3 * (1 + DS4_MOTION_WORDS) + sizeof(uint32_t);
+// Motion deltas are only sent this many frames in a row before a frame that stands on its own,
+// so a lost frame (which breaks the chain) costs at most this many reports
+constexpr int IMU_ANCHOR_INTERVAL = 8;
+// Recent reports the receiver keeps as motion delta bases, covers a FEC group recovered late plus a chain of deltas
+constexpr int IMU_BASE_HISTORY = MAX_FEC_GROUP + IMU_ANCHOR_INTERVAL;
+// Motion deltas held back until the frame they patch turns up
+constexpr int IMU_PENDING_DELTAS = MAX_FEC_GROUP;
+
+// Rumble + lightbar reply from JoyReceiver, delta capable hosts append the
+// sequence number of the newest keyframe they hold (uint16_t)
+constexpr int FEEDBACK_DATA_SIZE = 5;
+constexpr int FEEDBACK_ACK_SIZE = FEEDBACK_DATA_SIZE + sizeof(uint16_t);
+// Clock capable hosts (protocol 5) follow the ack with their clock when the reply was built (uint32_t us)
+constexpr int FEEDBACK_CLOCK_SIZE = FEEDBACK_ACK_SIZE + sizeof(uint32_t);
+// Rate capable hosts (protocol 6) follow the stamp with a LinkReport
+constexpr int FEEDBACK_RATE_SIZE = FEEDBACK_CLOCK_SIZE + LINK_REPORT_SIZE;
+
+// Keyframes are re-sent this often (in frames) so a lost delta base cannot stall the stream
+constexpr int KEYFRAME_INTERVAL = 64;
+// While no keyframe has been acknowledged, how often a full report is marked as a keyframe
+constexpr int KEYFRAME_RETRY_INTERVAL = 8;
+// Keyframes remembered by each side, must cover one round trip of KEYFRAME_RETRY_INTERVALs
+constexpr int KEYFRAME_HISTORY = 8;
+
+// Monotonic microsecond clock shared by frame timestamps and the jitter buffer
+inline int64_t netjoy_clock_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// true when sequence number a comes after b, accounting for wrap around
+inline bool seq_newer(uint16_t a, uint16_t b) {
+    return static_cast<int16_t>(a - b) > 0;
+}
+
+// Writes a StreamHeader + payload to out (STREAM_HEADER_SIZE + size bytes), returns the message size
+inline int write_stream_message(char* out, uint8_t type, const char* payload, int size) {
+    StreamHeader header{};
+    header.type = type;
+    header.length = static_cast<uint16_t>(size);
+    std::memcpy(out, &header, STREAM_HEADER_SIZE);
+    std::memcpy(out + STREAM_HEADER_SIZE, payload, size);
+    return STREAM_HEADER_SIZE + size;
+}
+
+inline bool is_frame_packet(const char* data, int size) {
+    if (size < FRAME_HEADER_SIZE) return false;
+    uint8_t type = static_cast<uint8_t>(data[0]);
+    return type >= FRAME_REPORT && type <= FRAME_IMU_DELTA;
+}
+
+// Bytes covered by word n of a report of the given size
+inline int delta_word_size(int word, int reportSize) {
+    int remaining = reportSize - word * DELTA_WORD_SIZE;
+    return remaining < DELTA_WORD_SIZE ? remaining : DELTA_WORD_SIZE;
+}
+
+// Writes the DeltaHeader + changed words of report against base, returns bytes written
+inline int encode_delta(char* out, uint16_t baseSeq, const char* base, const char* report, int size) {
+    DeltaHeader dh{};
+    dh.baseSeq = baseSeq;
+    int pos = DELTA_HEADER_SIZE;
+    for (int w = 0; w * DELTA_WORD_SIZE < size; ++w) {
+        int offset = w * DELTA_WORD_SIZE;
+        int n = delta_word_size(w, size);
+        if (std::memcmp(base + offset, report + offset, n) != 0) {
+            dh.mask |= 1u << w;
+            std::memcpy(out + pos, report + offset, n);
+            pos += n;
+        }
+    }
+    std::memcpy(out, &dh, DELTA_HEADER_SIZE);
+    return pos;
+}
+
+// Rebuilds a report of baseSize bytes from base + delta payload, returns the size or 0 if malformed
+inline int decode_delta(char* out, const char* base, int baseSize, const char* delta, int deltaSize) {
+    if (deltaSize < DELTA_HEADER_SIZE) return 0;
+    DeltaHeader dh;
+    std::memcpy(&dh, delta, DELTA_HEADER_SIZE);
+
+    std::memcpy(out, base, baseSize);
+    int pos = DELTA_HEADER_SIZE;
+    for (int w = 0; w * DELTA_WORD_SIZE < baseSize; ++w) {
+        if (!(dh.mask & (1u << w))) continue;
+        int n = delta_word_size(w, baseSize);
+        if (pos + n > deltaSize) return 0;
+        std::memcpy(out + w * DELTA_WORD_SIZE, delta + pos, n);
+        pos += n;
+    }
+    return baseSize;
+}
+
+// Zig-zag varint of a 16 bit step, small steps either way take one byte. Returns bytes written
+inline int put_zigzag16(char* out, int16_t step) {
+    uint32_t v = (static_cast<uint32_t>(step) << 1) ^ static_cast<uint32_t>(step >> 15);
+    v &= 0xFFFF;
+    int n = 0;
+    while (v >= 0x80) {
+        out[n++] = static_cast<char>((v & 0x7F) | 0x80);
+        v >>= 7;
+    }
+    out[n++] = static_cast<char>(v);
+    return n;
+}
+
+// Reads a put_zigzag16 step at in[pos], advancing pos. false when it runs past size or is over long
+inline bool get_zigzag16(const char* in, int size, int& pos, int16_t& step) {
+    uint32_t v = 0;
+    for (int shift = 0; shift < 21; shift += 7) {
+        if (pos >= size) return false;
+        uint8_t b = static_cast<uint8_t>(in[pos++]);
+        v |= static_cast<uint32_t>(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            if (v > 0xFFFF) return false;
+            step = static_cast<int16_t>((v >> 1) ^ (0u - (v & 1)));
+            return true;
+        }
+    }
+    return false;
+}
+
+inline uint16_t read_word(const char* p) {
+    uint16_t w;
+    std::memcpy(&w, p, sizeof(w));
+    return w;
+}
+
+// true when the sticks, buttons and triggers of two DS4 reports match, the report counter in bSpecial aside
+inline bool ds4_same_controls(const char* a, const char* b) {
+    return std::memcmp(a, b, DS4_SPECIAL_OFFSET) == 0
+        && ((a[DS4_SPECIAL_OFFSET] ^ b[DS4_SPECIAL_OFFSET]) & 0x03) == 0
+        && std::memcmp(a + DS4_SPECIAL_OFFSET + 1, b + DS4_SPECIAL_OFFSET + 1, DS4_TIMESTAMP_OFFSET - DS4_SPECIAL_OFFSET - 1) == 0;
+}
+
+// Writes the ImuDeltaHeader + blocks of a DS4 report against the one before it (both size bytes),
+// returns bytes written or 0 when the report is too short to be a DS4 report
+inline int encode_imu_delta(char* out, uint16_t baseSeq, const char* base, const char* report, int size) {
+    if (size < DS4_TAIL_OFFSET || size > MAX_FRAME_PAYLOAD_SIZE) return 0;
+    ImuDeltaHeader ih{};
+    ih.baseSeq = baseSeq;
+    int pos = IMU_DELTA_HEADER_SIZE;
+
+    out[pos++] = report[DS4_SPECIAL_OFFSET];
+    if (!ds4_same_controls(base, report)) {
+        ih.flags |= IMU_FLAG_CONTROLS;
+        std::memcpy(out + pos, report, DS4_SPECIAL_OFFSET);
+        pos += DS4_SPECIAL_OFFSET;
+        std::memcpy(out + pos, report + DS4_SPECIAL_OFFSET + 1, DS4_TIMESTAMP_OFFSET - DS4_SPECIAL_OFFSET - 1);
+        pos += DS4_TIMESTAMP_OFFSET - DS4_SPECIAL_OFFSET - 1;
+    }
+    pos += put_zigzag16(out + pos, static_cast<int16_t>(read_word(report + DS4_TIMESTAMP_OFFSET) - read_word(base + DS4_TIMESTAMP_OFFSET)));
+    if (report[DS4_BATTERY_OFFSET] != base[DS4_BATTERY_OFFSET]) {
+        ih.flags |= IMU_FLAG_BATTERY;
+        out[pos++] = report[DS4_BATTERY_OFFSET];
+    }
+    for (int i = 0; i < DS4_MOTION_WORDS; ++i) {
+        const int offset = DS4_MOTION_OFFSET + i * 2;
+        pos += put_zigzag16(out + pos, static_cast<int16_t>(read_word(report + offset) - read_word(base + offset)));
+    }
+
+    const int tailSize = size - DS4_TAIL_OFFSET;
+    if (std::memcmp(base + DS4_TAIL_OFFSET, report + DS4_TAIL_OFFSET, tailSize) != 0) {
+        ih.flags |= IMU_FLAG_TAIL;
+        uint32_t mask = 0;
+        int maskPos = pos;
+        pos += sizeof(mask);
+        for (int w = 0; w * DELTA_WORD_SIZE < tailSize; ++w) {
+            int offset = DS4_TAIL_OFFSET + w * DELTA_WORD_SIZE;
+            int n = delta_word_size(w, tailSize);
+            if (std::memcmp(base + offset, report + offset, n) != 0) {
+                mask |= 1u << w;
+                std::memcpy(out + pos, report + offset, n);
+                pos += n;
+            }
+        }
+        std::memcpy(out + maskPos, &mask, sizeof(mask));
+    }
+    std::memcpy(out, &ih, IMU_DELTA_HEADER_SIZE);
+    return pos;
+}
+
+// Rebuilds a DS4 report of baseSize bytes from the report before it + an encode_imu_delta payload,
+// returns the size or 0 if malformed
+inline int decode_imu_delta(char* out, const char* base, int baseSize, const char* delta, int deltaSize) {
+    if (deltaSize < IMU_DELTA_HEADER_SIZE + 1 || baseSize < DS4_TAIL_OFFSET || baseSize > MAX_FRAME_PAYLOAD_SIZE) return 0;
+    ImuDeltaHeader ih;
+    std::memcpy(&ih, delta, IMU_DELTA_HEADER_SIZE);
+    int pos = IMU_DELTA_HEADER_SIZE;
+
+    std::memcpy(out, base, baseSize);
+    out[DS4_SPECIAL_OFFSET] = delta[pos++];
+    if (ih.flags & IMU_FLAG_CONTROLS) {
+        const int controls = DS4_TIMESTAMP_OFFSET - 1;
+        if (pos + controls > deltaSize) return 0;
+        std::memcpy(out, delta + pos, DS4_SPECIAL_OFFSET);
+        std::memcpy(out + DS4_SPECIAL_OFFSET + 1, delta + pos + DS4_SPECIAL_OFFSET, controls - DS4_SPECIAL_OFFSET);
+        pos += controls;
+    }
+    int16_t step;
+    if (!get_zigzag16(delta, deltaSize, pos, step)) return 0;
+    uint16_t word = static_cast<uint16_t>(read_word(base + DS4_TIMESTAMP_OFFSET) + step);
+    std::memcpy(out + DS4_TIMESTAMP_OFFSET, &word, sizeof(word));
+    if (ih.flags & IMU_FLAG_BATTERY) {
+        if (pos >= deltaSize) return 0;
+        out[DS4_BATTERY_OFFSET] = delta[pos++];
+    }
+    for (int i = 0; i < DS4_MOTION_WORDS; ++i) {
+        const int offset = DS4_MOTION_OFFSET + i * 2;
+        if (!get_zigzag16(delta, deltaSize, pos, step)) return 0;
+        word = static_cast<uint16_t>(read_word(base + offset) + step);
+        std::memcpy(out + offset, &word, sizeof(word));
+    }
+
+    if (ih.flags & IMU_FLAG_TAIL) {
+        uint32_t mask;
+        if (pos + static_cast<int>(sizeof(mask)) > deltaSize) return 0;
+        std::memcpy(&mask, delta + pos, sizeof(mask));
+        pos += sizeof(mask);
+        const int tailSize = baseSize - DS4_TAIL_OFFSET;
+        for (int w = 0; w * DELTA_WORD_SIZE < tailSize; ++w) {
+            if (!(mask & (1u << w))) continue;
+            int n = delta_word_size(w, tailSize);
+            if (pos + n > deltaSize) return 0;
+            std::memcpy(out + DS4_TAIL_OFFSET + w * DELTA_WORD_SIZE, delta + pos, n);
+            pos += n;
+        }
+    }
+    return baseSize;
+}
+
+// Full reports kept by seq so deltas can be built or rebuilt against them
+template <int History>
+class ReportStore {
+private:
+    struct Keyframe {
+        bool used = false;
+        uint16_t seq = 0;
+        int size = 0;
+        char data[MAX_FRAME_PAYLOAD_SIZE];
+    };
+    Keyframe frames[History];
+    int next = 0;
+
+public:
+    void reset() {
+        for (Keyframe& k : frames) k.used = false;
+        next = 0;
+    }
+
+    // Overwrites the report already stored under seq, else the oldest
+    void store(uint16_t seq, const char* data, int size) {
+        Keyframe* slot = &frames[next];
+        for (Keyframe& k : frames) {
+            if (k.used && k.seq == seq) slot = &k;
+        }
+        if (slot == &frames[next]) next = (next + 1) % History;
+        Keyframe& k = *slot;
+        k.used = true;
+        k.seq = seq;
+        k.size = size;
+        std::memcpy(k.data, data, size);
+    }
+
+    // Report stored under seq, nullptr if it was never stored or has been overwritten
+    const char* find(uint16_t seq, int& size) const {
+        for (const Keyframe& k : frames) {
+            if (k.used && k.seq == seq) {
+                size = k.size;
+                return k.data;
+            }
+        }
+        return nullptr;
+    }
+};
+
+using KeyframeStore = ReportStore<KEYFRAME_HISTORY>;
+
+// Rebuilds FRAME_IMU_DELTA reports against the frame they patch. Recent reports are kept by seq so a
+// delta still decodes when frames arrive out of order, and one whose base is missing is held until
+// the base is recovered (from parity or a redundant copy) instead of being dropped
+class ImuDeltaDecoder {
+private:
+    struct Pending {
+        bool used = false;
+        FrameHeader hdr{};
+        int size = 0;
+        char data[MAX_IMU_DELTA_SIZE];
+    };
+    ReportStore<IMU_BASE_HISTORY> reports;
+    Pending pending[IMU_PENDING_DELTAS];
+
+    static uint16_t base_of(const Pending& p) {
+        ImuDeltaHeader ih;
+        std::memcpy(&ih, p.data, IMU_DELTA_HEADER_SIZE);
+        return ih.baseSeq;
+    }
+
+    // the oldest held delta makes room when all are taken, its base is the least likely to turn up
+    void hold(const FrameHeader& hdr, const char* payload, int payloadSize) {
+        Pending* slot = nullptr;
+        for (Pending& p : pending) {
+            if (p.used && p.hdr.seq == hdr.seq) return;
+            if (!p.used) slot = &p;
+        }
+        if (slot == nullptr) {
+            slot = &pending[0];
+            for (Pending& p : pending) {
+                if (seq_newer(slot->hdr.seq, p.hdr.seq)) slot = &p;
+            }
+            ++expired;
+        }
+        slot->used = true;
+        slot->hdr = hdr;
+        slot->size = payloadSize;
+        std::memcpy(slot->data, payload, payloadSize);
+    }
+
+public:
+    uint32_t expired = 0;   // motion deltas dropped, their base never turned up (or they were malformed)
+
+    void reset() {
+        reports.reset();
+        for (Pending& p : pending) p.used = false;
+        expired = 0;
+    }
+
+    // Keeps a full report as the possible base of a motion delta
+    void keep(uint16_t seq, const char* data, int size) {
+        if (size > 0 && size <= MAX_FRAME_PAYLOAD_SIZE) reports.store(seq, data, size);
+    }
+
+    // Rebuilds the report of a FRAME_IMU_DELTA payload into out, returns its size or 0.
+    // A delta whose base is missing is held for next_ready()
+    int decode(const FrameHeader& hdr, const char* payload, int payloadSize, char* out) {
+        if (payloadSize < IMU_DELTA_HEADER_SIZE || payloadSize > MAX_IMU_DELTA_SIZE) {
+            ++expired;
+            return 0;
+        }
+        ImuDeltaHeader ih;
+        std::memcpy(&ih, payload, IMU_DELTA_HEADER_SIZE);
+        int baseSize = 0;
+        const char* base = reports.find(ih.baseSeq, baseSize);
+        if (base == nullptr) {
+            hold(hdr, payload, payloadSize);
+            return 0;
+        }
+        int size = decode_imu_delta(out, base, baseSize, payload, payloadSize);
+        if (size == 0) ++expired;
+        else keep(hdr.seq, out, size);
+        return size;
+    }
+
+    // Rebuilds a held delta whose base has been kept since into out, returns its size or 0 when none can be.
+    // Call until it returns 0, every report rebuilt may be the base of another
+    int next_ready(FrameHeader& hdr, char* out) {
+        for (Pending& p : pending) {
+            if (!p.used) continue;
+            int baseSize = 0;
+            const char* base = reports.find(base_of(p), baseSize);
+            if (base == nullptr) continue;
+            p.used = false;
+            int size = decode_imu_delta(out, base, baseSize, p.data, p.size);
+            if (size == 0) {
+                ++expired;
+                continue;
+            }
+            hdr = p.hdr;
+            keep(hdr.seq, out, size);
+            return size;
+        }
+        return 0;
+    }
+
+    // Motion deltas waiting for their base
+    int held() const {
+        int count = 0;
+        for (const Pending& p : pending) count += p.used ? 1 : 0;
+        return count;
+    }
+};
+
+// XORs every groupSize frame datagrams into a FRAME_PARITY, so the receiver can
+// rebuild any single datagram of the group that was lost
+class ParityEncoder {
+private:
+    int groupSize = 0;
+    int count = 0;
+    uint16_t firstSeq = 0;
+    uint16_t sizeXor = 0;
+    int longest = 0;
+    char parity[MAX_FRAME_PACKET_SIZE];
+
+public:
+    void reset(int group = 0) {
+        groupSize = group;
+        count = 0;
+    }
+
+    bool enabled() const { return groupSize > 0; }
+
+    // Adds a frame datagram to the group, once the group is complete writes the
+    // parity datagram into out (at least MAX_DATAGRAM_SIZE bytes) and returns its size
+    int add(const char* packet, int size, char* out) {
+        if (!enabled()) return 0;
+        if (count == 0) {
+            FrameHeader first;
+            std::memcpy(&first, packet, FRAME_HEADER_SIZE);
+            firstSeq = first.seq;
+            sizeXor = 0;
+            longest = 0;
+            std::memset(parity, 0, sizeof(parity));
+        }
+        sizeXor ^= static_cast<uint16_t>(size);
+        if (size > longest) longest = size;
+        for (int i = 0; i < size; ++i) parity[i] ^= packet[i];
+
+        if (++count < groupSize) return 0;
+        count = 0;
+
+        FrameHeader hdr{};
+        hdr.type = FRAME_PARITY;
+        hdr.flags = static_cast<uint8_t>(groupSize);
+        hdr.seq = firstSeq;
+        ParityHeader ph{ sizeXor };
+        std::memcpy(out, &hdr, FRAME_HEADER_SIZE);
+        std::memcpy(out + FRAME_HEADER_SIZE, &ph, PARITY_HEADER_SIZE);
+        std::memcpy(out + FRAME_HEADER_SIZE + PARITY_HEADER_SIZE, parity, longest);
+        return FRAME_HEADER_SIZE + PARITY_HEADER_SIZE + longest;
+    }
+};
+
+// Wraps outgoing input reports in a FrameHeader, delta encoding them once the host
+// has acknowledged a keyframe (protocol 2), bundling the previous reports (protocol 3),
+// following each group of frames with a parity datagram (protocol 4) and sending DS4
+// reports as motion steps from the frame before them (protocol 7)
+class FrameWriter {
+private:
+    struct SentReport {
+        uint16_t seq = 0;
+        uint32_t timestamp = 0;
+        int size = 0;
+        char data[MAX_FRAME_PAYLOAD_SIZE];
+    };
+
+    uint16_t seq = 0;
+    int sinceKeyframe = 0;
+    int sinceAnchor = 0;    // motion deltas sent in a row
+    KeyframeStore keyframes;
+    SentReport history[MAX_BUNDLE_REDUNDANCY]; // ring of the last reports sent
+    int historyCount = 0;
+    int historyNext = 0;
+    ParityEncoder parity;
+    char parityPacket[MAX_DATAGRAM_SIZE];
+    int paritySize = 0;
+    // newest keyframe the host holds, -1 for none. Written by the feedback thread
+    std::atomic<int32_t> ackedKeyframe{ -1 };
+    // receiver stamp (high 32 bits) + our clock when it arrived (low 32 bits) waiting to be echoed, 0 for none
+    std::atomic<uint64_t> clockEcho{ 0 };
+
+public:
+    bool enabled = false;   // set once the host has agreed to framing
+    bool delta = false;     // set once the host has agreed to delta reports
+    bool clock = false;     // set once the host has agreed to clock round trips
+    bool stream = false;    // set once the host has agreed to length-prefixed TCP messages
+    bool imu = false;       // set once the host has agreed to DS4 motion deltas
+    int redundancy = 0;     // previous reports repeated in each datagram
+
+    void reset(int protocol = 0, int redundantFrames = 0, int fecGroup = 0) {
+        seq = 0;
+        sinceKeyframe = KEYFRAME_INTERVAL;
+        sinceAnchor = 0;
+        keyframes.reset();
+        ackedKeyframe = -1;
+        historyCount = 0;
+        historyNext = 0;
+        enabled = protocol > 0;
+        delta = protocol >= NETJOY_PROTOCOL_DELTA;
+        clock = protocol >= NETJOY_PROTOCOL_CLOCK;
+        stream = false;
+        imu = false;
+        clockEcho = 0;
+        redundancy = 0;
+        if (protocol >= NETJOY_PROTOCOL_BUNDLE && redundantFrames > 0)
+            redundancy = redundantFrames < MAX_BUNDLE_REDUNDANCY ? redundantFrames : MAX_BUNDLE_REDUNDANCY;
+        parity.reset((protocol >= NETJOY_PROTOCOL_FEC && fecGroup >= MIN_FEC_GROUP && fecGroup <= MAX_FEC_GROUP) ? fecGroup : 0);
+        paritySize = 0;
+    }
+
+    // Parity datagram completed by the last write(), to be sent right after it
+    const char* parity_packet() const { return parityPacket; }
+    int parity_size() const { return paritySize; }
+
+    // Called with the keyframe seq found in the host's feedback
+    void acknowledge(uint16_t keyframeSeq) {
+        ackedKeyframe = keyframeSeq;
+    }
+
+    // Called with the receiver timestamp found in the host's feedback, echoed by the next frame
+    void clock_stamp(uint32_t receiverStamp, int64_t arrival) {
+        clockEcho = (static_cast<uint64_t>(receiverStamp) << 32) | static_cast<uint32_t>(arrival);
+    }
+
+    // Writes header + report into out (at least MAX_FRAME_PACKET_SIZE bytes), returns the datagram size
+    int write(char* out, const char* report, int size) {
+        if (size > MAX_FRAME_PAYLOAD_SIZE) size = MAX_FRAME_PAYLOAD_SIZE;
+
+        FrameHeader hdr{};
+        hdr.type = FRAME_REPORT;
+        hdr.seq = seq++;
+        hdr.timestamp = static_cast<uint32_t>(netjoy_clock_us());
+
+        int payloadSize = size;
+        if (delta) {
+            const char* base = nullptr;
+            int baseSize = 0;
+            int32_t acked = ackedKeyframe;
+            if (acked >= 0) base = keyframes.find(static_cast<uint16_t>(acked), baseSize);
+            if (base != nullptr && baseSize != size) base = nullptr;
+
+            if (++sinceKeyframe >= (base ? KEYFRAME_INTERVAL : KEYFRAME_RETRY_INTERVAL)) {
+                sinceKeyframe = 0;
+                hdr.flags |= FRAME_FLAG_KEYFRAME;
+                keyframes.store(hdr.seq, report, size);
+            }
+            else if (base != nullptr) {
+                char encoded[DELTA_HEADER_SIZE + MAX_FRAME_PAYLOAD_SIZE];
+                int encodedSize = encode_delta(encoded, static_cast<uint16_t>(acked), base, report, size);
+                // nothing to gain when most of the report changed
+                if (encodedSize < size) {
+                    hdr.type = FRAME_DELTA;
+                    payloadSize = encodedSize;
+                    std::memcpy(out + FRAME_HEADER_SIZE, encoded, encodedSize);
+                }
+            }
+        }
+
+        // Sticks, buttons and triggers as they were: the motion steps from the frame before. Not in a bundle,
+        // its copies hang off the newest frame, and a frame that stands on its own every IMU_ANCHOR_INTERVAL
+        if (imu && redundancy == 0 && !(hdr.flags & FRAME_FLAG_KEYFRAME) && sinceAnchor + 1 < IMU_ANCHOR_INTERVAL) {
+            const SentReport* previous = sent(1, hdr.seq);
+            if (previous != nullptr && previous->size == size && ds4_same_controls(previous->data, report)) {
+                char encoded[MAX_IMU_DELTA_SIZE];
+                int encodedSize = encode_imu_delta(encoded, previous->seq, previous->data, report, size);
+                if (encodedSize > 0 && encodedSize < payloadSize) {
+                    hdr.type = FRAME_IMU_DELTA;
+                    payloadSize = encodedSize;
+                    std::memcpy(out + FRAME_HEADER_SIZE, encoded, encodedSize);
+                }
+            }
+        }
+        sinceAnchor = (hdr.type == FRAME_IMU_DELTA) ? sinceAnchor + 1 : 0;
+
+        if (hdr.type == FRAME_REPORT) std::memcpy(out + FRAME_HEADER_SIZE, report, size);
+
+        uint64_t echo = clock ? clockEcho.exchange(0) : 0;
+        if (echo) hdr.flags |= FRAME_FLAG_CLOCK;
+
+        int packetSize = FRAME_HEADER_SIZE + payloadSize;
+        if (redundancy > 0) packetSize = bundle(out, hdr, report, size, payloadSize);
+        else std::memcpy(out, &hdr, FRAME_HEADER_SIZE);
+
+        if (echo) {
+            ClockEcho ce{};
+            ce.receiverStamp = static_cast<uint32_t>(echo >> 32);
+            ce.heldFor = hdr.timestamp - static_cast<uint32_t>(echo);
+            std::memcpy(out + packetSize, &ce, CLOCK_ECHO_SIZE);
+            packetSize += CLOCK_ECHO_SIZE;
+        }
+
+        remember(hdr, report, size);
+        paritySize = parity.add(out, packetSize, parityPacket);
+        return packetSize;
+    }
+
+    // Writes report as a stream message into out (at least STREAM_HEADER_SIZE + MAX_FRAME_PAYLOAD_SIZE bytes),
+    // as motion steps from the report before it once the host agreed to them. Returns the message size
+    int write_stream(char* out, const char* report, int size) {
+        if (size > MAX_FRAME_PAYLOAD_SIZE) size = MAX_FRAME_PAYLOAD_SIZE;
+        FrameHeader hdr{};
+        hdr.seq = seq++;
+
+        int messageSize = 0;
+        const SentReport* previous = imu ? sent(1, hdr.seq) : nullptr;
+        if (previous != nullptr && previous->size == size) {
+            // a stream loses nothing, every report can build on the one before
+            char encoded[MAX_IMU_DELTA_SIZE];
+            int encodedSize = encode_imu_delta(encoded, 0, previous->data, report, size);
+            if (encodedSize > 0 && encodedSize < size)
+                messageSize = write_stream_message(out, STREAM_IMU_DELTA, encoded, encodedSize);
+        }
+        if (messageSize == 0) messageSize = write_stream_message(out, STREAM_INPUT, report, size);
+        remember(hdr, report, size);
+        return messageSize;
+    }
+
+private:
+    void remember(const FrameHeader& hdr, const char* report, int size) {
+        SentReport& r = history[historyNext];
+        historyNext = (historyNext + 1) % MAX_BUNDLE_REDUNDANCY;
+        if (historyCount < MAX_BUNDLE_REDUNDANCY) ++historyCount;
+        r.seq = hdr.seq;
+        r.timestamp = hdr.timestamp;
+        r.size = size;
+        std::memcpy(r.data, report, size);
+    }
+
+    // Report sent n frames ago (1 = the previous one), nullptr if it is not in the history
+    const SentReport* sent(int n, uint16_t currentSeq) const {
+        if (n > historyCount) return nullptr;
+        const SentReport& r = history[(historyNext - n + MAX_BUNDLE_REDUNDANCY) % MAX_BUNDLE_REDUNDANCY];
+        return (r.seq == static_cast<uint16_t>(currentSeq - n)) ? &r : nullptr;
+    }
+
+    // Rewrites the frame already in out (header + payload) as a FRAME_BUNDLE, returns the datagram size
+    int bundle(char* out, FrameHeader hdr, const char* report, int size, int payloadSize) {
+        BundleHeader bh{};
+        bh.frameType = hdr.type;
+        bh.frameSize = static_cast<uint8_t>(payloadSize);
+        std::memmove(out + FRAME_HEADER_SIZE + BUNDLE_HEADER_SIZE, out + FRAME_HEADER_SIZE, payloadSize);
+        int pos = FRAME_HEADER_SIZE + BUNDLE_HEADER_SIZE + payloadSize;
+
+        const char* newer = report;
+        uint16_t newerSeq = hdr.seq;
+        for (int n = 1; n <= redundancy; ++n) {
+            const SentReport* r = sent(n, hdr.seq);
+            if (r == nullptr || r->size != size) break;
+
+            BundleEntry entry{};
+            entry.timestamp = r->timestamp;
+            int deltaSize = encode_delta(out + pos + BUNDLE_ENTRY_SIZE, newerSeq, newer, r->data, size);
+            entry.size = static_cast<uint8_t>(deltaSize);
+            std::memcpy(out + pos, &entry, BUNDLE_ENTRY_SIZE);
+            pos += BUNDLE_ENTRY_SIZE + deltaSize;
+
+            newer = r->data;
+            newerSeq = r->seq;
+            ++bh.count;
+        }
+
+        hdr.type = FRAME_BUNDLE;
+        std::memcpy(out, &hdr, FRAME_HEADER_SIZE);
+        std::memcpy(out + FRAME_HEADER_SIZE, &bh, BUNDLE_HEADER_SIZE);
+        return pos;
+    }
+};
+
+// Receive side of a streamed TCP connection. Reads land in one buffer and messages are parsed
+// in place, next() hands out a pointer into it, so several messages that arrived in one read
+// cost one receive call. Only the unparsed tail of a message split across reads is moved, to the
+// front of the buffer, when the buffer runs out of room
+class StreamReader {
+private:
+    char buffer[STREAM_BUFFER_SIZE];
+    int start = 0;      // first unparsed byte
+    int end = 0;        // one past the last received byte
+    bool broken = false;
+
+    void compact() {
+        if (start == 0) return;
+        std::memmove(buffer, buffer + start, end - start);
+        end -= start;
+        start = 0;
+    }
+
+public:
+    struct Message {
+        uint8_t type;       // Of StreamMessageType
+        const char* data;   // valid until the next fill() or append()
+        int size;
+    };
+
+    void reset() {
+        start = end = 0;
+        broken = false;
+    }
+
+    // true once a header announced more than MAX_STREAM_PAYLOAD bytes, the connection is unusable
+    bool corrupt() const { return broken; }
+
+    // Takes the next whole message off the buffer, false when more has to be received first
+    bool next(Message& msg) {
+        if (broken || end - start < STREAM_HEADER_SIZE) return false;
+        StreamHeader header;
+        std::memcpy(&header, buffer + start, STREAM_HEADER_SIZE);
+        if (header.length > MAX_STREAM_PAYLOAD) {
+            broken = true;
+            return false;
+        }
+        if (end - start < STREAM_HEADER_SIZE + header.length) return false;
+
+        msg.type = header.type;
+        msg.data = buffer + start + STREAM_HEADER_SIZE;
+        msg.size = header.length;
+        start += STREAM_HEADER_SIZE + header.length;
+        if (start == end) start = end = 0;
+        return true;
+    }
+
+    // One receive from connection into the free end of the buffer, returns like its receive_data
+    template <class Connection>
+    int fill(Connection& connection) {
+        if (STREAM_BUFFER_SIZE - end < STREAM_HEADER_SIZE + MAX_STREAM_PAYLOAD) compact();
+        int bytes = connection.receive_data(buffer + end, STREAM_BUFFER_SIZE - end);
+        if (bytes > 0) end += bytes;
+        return bytes;
+    }
+
+    // Adds bytes that were received outside of fill(), false when they do not fit
+    bool append(const char* data, int size) {
+        if (STREAM_BUFFER_SIZE - end < size) compact();
+        if (STREAM_BUFFER_SIZE - end < size) return false;
+        std::memcpy(buffer + end, data, size);
+        end += size;
+        return true;
+    }
+};
+
+#endif // NETJOY_PROTOCOL_H
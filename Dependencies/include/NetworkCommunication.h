@@ -32,6 +32,8 @@ THE SOFTWARE.
 
 #include "TCP_Connection_Class.h"
 #include "UDP_Connection_Class.h"
+#include "NetJoyProtocol.h"
+#include "SocketWaiter.hpp"
 
 #define DS4_REPORT_NETWORK_DATA_SIZE 61
 #define XBOX_REPORT_NETWORK_DATA_SIZE 12
@@ -60,6 +62,8 @@ class NetworkConnection {
         virtual int establish_connection(const std::string&, int) = 0;
         virtual int send_data(const char*, int) = 0;
         virtual int receive_data(char*, int) = 0;
+        virtual int wait_for_data(int) = 0;
+        virtual SOCKET listening_socket() = 0;
         virtual int get_available_data_size() = 0;
         virtual int receive_null_data(int) = 0;
         virtual bool is_server() = 0;
@@ -89,6 +93,8 @@ class NetworkConnection {
         int establish_connection(const std::string& a, int p) override { return impl.establish_connection(a, p); }
         int send_data(const char* d, int s) override { return impl.send_data(d, s); }
         int receive_data(char* b, int s) override { return impl.receive_data(b, s); }
+        int wait_for_data(int t) override { return impl.wait_for_data(t); }
+        SOCKET listening_socket() override { return impl.listening_socket(); }
         int get_available_data_size() override { return impl.get_available_data_size(); }
         int receive_null_data(int c) override { return impl.receive_null_data(c); }
         bool is_server() override { return impl.is_server(); }
@@ -107,6 +113,8 @@ class NetworkConnection {
         int establish_connection(const std::string&, int) override { return -1; }
         int send_data(const char*, int) override { return -1; }
         int receive_data(char*, int) override { return -1; }
+        int wait_for_data(int) override { return -1; }
+        SOCKET listening_socket() override { return INVALID_SOCKET; }
         int get_available_data_size() override { return -1; }
         int receive_null_data(int) override { return -1; }
         bool is_server() override { return false; }
@@ -152,6 +160,12 @@ public:
     }
     int send_data(const char* data, int size) { return self->send_data(data, size); }
     int receive_data(char* buffer, int size) { return self->receive_data(buffer, size); }
+    int wait_for_data(int timeoutMillisec) { return self->wait_for_data(timeoutMillisec); }
+    // Sleeps until a client knocks on the server socket (then call await_connection), 0 on timeout
+    // or -WSAECANCELLED when the waiter is cancelled
+    int wait_for_connection(SocketWaiter& waiter, int timeoutMillisec) {
+        return waiter.wait_readable(self->listening_socket(), timeoutMillisec);
+    }
     int get_available_data_size() { return self->get_available_data_size(); }
     int receive_null_data(int c) { return self->receive_null_data(c); }
     bool is_server() { return self->is_server(); }
@@ -229,40 +243,56 @@ public:
     bool confirm_connection() {
         if (!UDP_COMMUNICATION) return true;
 
+        // the handshakes retransmit with backoff on their own, no need to retry here
         auto conn = this->get_raw_interface<UDPConnection>();
-        for (int retries = 0; retries < 3; retries++) {
-            bool cx = this->is_server() ?
-                conn->udp_handshake_server() :
-                conn->udp_handshake_client();
-
-            if (cx) return true;
-            else{
-                int err = WSAGetLastError();
-                if (err == WSAEWOULDBLOCK || err == WSAETIMEDOUT) {
-                    Sleep(10);
-                    continue;
-                }
+        bool cx = this->is_server() ?
+            conn->udp_handshake_server() :
+            conn->udp_handshake_client();
+        if (!cx) {
+            int err = WSAGetLastError();
+            if (err != WSAEWOULDBLOCK && err != WSAETIMEDOUT)
                 std::cerr << " << Confirmation Failed (ERROR " << err << ")";
-                return false;
-            }
         }
-        return false;
+        return cx;
+    }
+
+    // Session id agreed in the UDP handshake, 0 for TCP
+    uint16_t session_id() {
+        auto conn = this->get_raw_interface<UDPConnection>();
+        return conn ? conn->get_session_id() : 0;
     }
 
     void keep_alive() {
-        UDPConnection::SIGPacket keepAlive = UDPConnection::make_packet(UDPConnection::PACKET_ALIVE, 666);
+        UDPConnection::SIGPacket keepAlive = UDPConnection::make_packet(UDPConnection::PACKET_ALIVE, session_id());
         send_data((const char*)&keepAlive, sizeof(UDPConnection::SIGPacket));
     }
 
+    // Session id the next UDP handshake offers, the resume token of an earlier welcome (0 for a new one)
+    void resume_session(uint16_t id) {
+        auto conn = this->get_raw_interface<UDPConnection>();
+        if (conn) conn->resume_session(id);
+    }
+
+    // Control signals are acked and resent once the welcome holds NETJOY_CAP_ACKED_SIGNALS (UDP)
+    void use_acked_signals(bool on) {
+        auto conn = this->get_raw_interface<UDPConnection>();
+        if (conn) conn->set_acked_signals(on);
+    }
+
+    // Passes a received SIGPacket through the UDP control channel (acks it, takes in acks),
+    // false when it should not be acted on
+    bool accept_signal(const char* data) {
+        auto conn = this->get_raw_interface<UDPConnection>();
+        return conn ? conn->accept_signal(data) : true;
+    }
+
     void hang_up() {
-        UDPConnection::SIGPacket disconnect = UDPConnection::make_packet(UDPConnection::PACKET_HANGUP);
         if (UDP_COMMUNICATION) {
-            for (int delivery_insurance = 0; delivery_insurance < 1; delivery_insurance++) {
-                send_data((const char*)&disconnect, sizeof(UDPConnection::SIGPacket));
-                Sleep(5);
-            }
+            // resent until the peer acknowledges it, when it can
+            this->get_raw_interface<UDPConnection>()->hang_up();
         }
         else { // TCP
+            UDPConnection::SIGPacket disconnect = UDPConnection::make_packet(UDPConnection::PACKET_HANGUP, session_id());
             send_data((const char*)&disconnect, sizeof(UDPConnection::SIGPacket));
         }
     }
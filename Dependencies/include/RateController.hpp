@@ -0,0 +1,118 @@
+/*
+Copyright (c) 2025 Dave Quinn <qcent@yahoo.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include "NetJoyProtocol.h"
+
+// Moves the client's report rate between a floor and a ceiling from the LinkReports a rate
+// capable host (protocol 6) puts in its feedback. Loss or a round trip grown well past its
+// baseline (a queue building somewhere) cuts the rate by a fraction, a clean link probes it
+// back up a step at a time. Reports are handed in by the feedback thread, the send loop reads
+// rate() and announces every change to the host until its feedback shows the new rate
+class RateController {
+public:
+    static constexpr int64_t DECREASE_HOLD_US = 500000;     // a cut gets this long to take effect before the next
+    static constexpr int64_t INCREASE_HOLD_US = 2000000;    // clean time after a cut before probing up again
+    static constexpr int64_t INCREASE_STEP_US = 1000000;    // one step up per this while clean
+    static constexpr int64_t ANNOUNCE_RETRY_US = 100000;    // repeat an unacknowledged announcement this often
+    static constexpr int64_t QUEUE_DELAY_US = 8000;         // round trip growth that counts as queueing
+    static constexpr double LOSS_THRESHOLD = 0.05;          // smoothed loss fraction that counts as congestion
+    static constexpr double DECREASE_FACTOR = 0.85;
+    static constexpr int INCREASE_DIVISOR = 20;             // steps up by 1/20th (5%), at least 1
+
+private:
+    std::atomic<int> current{ 0 };
+    std::atomic<int> hostRate{ 0 };
+    int minRate = 0;
+    int maxRate = 0;
+    bool adaptive = false;
+
+    // feedback thread only
+    double loss = 0.0;              // smoothed fraction
+    int64_t baseRoundTrip = 0;      // us, lowest seen, creeps up so a new route is picked up
+    int64_t lastDecrease = 0;
+    int64_t lastIncrease = 0;
+
+    // send loop only
+    int64_t lastAnnounce = 0;
+
+public:
+    // rate to start at, bounds to adapt within (a floor of 0 keeps the rate fixed)
+    // and whether the host agreed to send LinkReports
+    void reset(int rate, int floorRate = 0, int ceilingRate = 0, bool hostReports = false) {
+        minRate = (floorRate > 0 && floorRate < rate) ? floorRate : rate;
+        maxRate = (ceilingRate > rate) ? ceilingRate : rate;
+        adaptive = hostReports && minRate < maxRate;
+        current = rate;
+        hostRate = rate;
+        loss = 0.0;
+        baseRoundTrip = 0;
+        lastDecrease = lastIncrease = lastAnnounce = netjoy_clock_us();
+    }
+
+    bool is_adaptive() const { return adaptive; }
+    int rate() const { return current; }
+
+    // Called by the feedback thread with the LinkReport that followed the clock stamp
+    void on_report(const LinkReport& report, int64_t now) {
+        hostRate = report.rate;
+        if (!adaptive) return;
+
+        loss += (report.loss / 256.0 - loss) / 4.0;
+        const int64_t roundTrip = report.roundTrip * 100LL;
+        if (roundTrip > 0) {
+            if (baseRoundTrip == 0 || roundTrip < baseRoundTrip) baseRoundTrip = roundTrip;
+            else baseRoundTrip += (roundTrip - baseRoundTrip) / 256;
+        }
+
+        const int rate = current;
+        const int64_t interval = 1000000 / rate;
+        const int64_t queueLimit = (QUEUE_DELAY_US > 2 * interval) ? QUEUE_DELAY_US : 2 * interval;
+        const bool congested = loss > LOSS_THRESHOLD || (roundTrip > 0 && roundTrip > baseRoundTrip + queueLimit);
+
+        if (congested) {
+            if (now - lastDecrease < DECREASE_HOLD_US) return;
+            int next = static_cast<int>(rate * DECREASE_FACTOR);
+            if (next >= rate) next = rate - 1;
+            current = (next > minRate) ? next : minRate;
+            lastDecrease = now;
+            return;
+        }
+        // frames closer together than the jitter only sit in the host's jitter buffer
+        if (report.jitter * 100LL >= interval) return;
+        if (now - lastDecrease < INCREASE_HOLD_US || now - lastIncrease < INCREASE_STEP_US) return;
+        int step = rate / INCREASE_DIVISOR;
+        int next = rate + (step > 0 ? step : 1);
+        current = (next < maxRate) ? next : maxRate;
+        lastIncrease = now;
+    }
+
+    // true when the send loop should (re)send a RateMessage for rate()
+    bool announce_due(int64_t now) {
+        if (!adaptive || hostRate == current || now - lastAnnounce < ANNOUNCE_RETRY_US) return false;
+        lastAnnounce = now;
+        return true;
+    }
+};
@@ -0,0 +1,100 @@
+/*
+Copyright (c) 2025 Dave Quinn <qcent@yahoo.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#pragma once
+
+#include <winsock2.h>
+
+// Readiness wait (WSAPoll) on one socket that another thread or the SIGINT handler can cut short.
+// The cancellation handle is a loopback UDP socket polled alongside, cancel() sends it a byte
+class SocketWaiter {
+private:
+    SOCKET wake = INVALID_SOCKET;
+    sockaddr_in wakeAddress{};
+    volatile bool cancelRequested = false;
+
+    // needs WSAStartup, which the connection classes have already done by the first wait
+    bool open() {
+        wake = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (wake == INVALID_SOCKET) return false;
+
+        wakeAddress.sin_family = AF_INET;
+        wakeAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        wakeAddress.sin_port = 0;
+        int len = sizeof(wakeAddress);
+        u_long nonBlocking = 1;
+        if (bind(wake, (sockaddr*)&wakeAddress, len) == SOCKET_ERROR ||
+            getsockname(wake, (sockaddr*)&wakeAddress, &len) == SOCKET_ERROR ||
+            ioctlsocket(wake, FIONBIO, &nonBlocking) == SOCKET_ERROR) {
+            closesocket(wake);
+            wake = INVALID_SOCKET;
+            return false;
+        }
+        return true;
+    }
+
+public:
+    SocketWaiter() = default;
+    SocketWaiter(const SocketWaiter&) = delete;
+    SocketWaiter& operator=(const SocketWaiter&) = delete;
+
+    ~SocketWaiter() {
+        if (wake != INVALID_SOCKET) closesocket(wake);
+    }
+
+    // Wakes the waiting thread, every later wait returns -WSAECANCELLED until rearm()
+    void cancel() {
+        cancelRequested = true;
+        if (wake != INVALID_SOCKET)
+            sendto(wake, "!", 1, 0, (const sockaddr*)&wakeAddress, sizeof(wakeAddress));
+    }
+
+    void rearm() {
+        char drain[16];
+        if (wake != INVALID_SOCKET) {
+            while (recv(wake, drain, sizeof(drain), 0) > 0) {}
+        }
+        cancelRequested = false;
+    }
+
+    bool cancelled() const { return cancelRequested; }
+
+    // > 0 when sock is readable (or a listening socket has a pending accept), 0 on timeout,
+    // -WSAECANCELLED after cancel() and -error otherwise. A negative timeout waits indefinitely
+    int wait_readable(SOCKET sock, int timeoutMillisec) {
+        if (wake == INVALID_SOCKET) open();
+        if (cancelRequested) return -WSAECANCELLED;
+
+        WSAPOLLFD fds[2] = {};
+        fds[0].fd = sock;
+        fds[0].events = POLLRDNORM;
+        fds[1].fd = wake;
+        fds[1].events = POLLRDNORM;
+        ULONG count = (wake != INVALID_SOCKET) ? 2 : 1;
+
+        int ready = WSAPoll(fds, count, timeoutMillisec < 0 ? -1 : timeoutMillisec);
+        if (ready == SOCKET_ERROR) return -WSAGetLastError();
+        if (cancelRequested || (count == 2 && fds[1].revents != 0)) return -WSAECANCELLED;
+        if (fds[0].revents & POLLNVAL) return -WSAENOTSOCK;
+        return (fds[0].revents != 0) ? 1 : 0;
+    }
+};
@@ -0,0 +1,158 @@
+/*
+Copyright (c) 2025 Dave Quinn <qcent@yahoo.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+// Lock-free single producer / single consumer ring of fixed-size slots. One thread push()es,
+// one thread pop()s; the two indices sit on their own cache lines and each side keeps a copy of
+// the other's so the shared line is only read when the ring looks full or empty. A consumer with
+// nothing to do can wait(): it spins briefly, then sleeps on an event the producer only signals
+// while the consumer is asleep
+template <int SLOTS, int SLOT_SIZE>
+class SpscRing {
+    static_assert(SLOTS > 1 && (SLOTS & (SLOTS - 1)) == 0, "SLOTS must be a power of two");
+
+public:
+    static constexpr int SPIN_ITERATIONS = 2000;   // before the consumer sleeps
+
+private:
+    struct Slot {
+        int size;
+        char data[SLOT_SIZE];
+    };
+
+    alignas(64) std::atomic<uint32_t> head{ 0 };  // next slot to write, advanced by the producer
+    uint32_t cachedTail = 0;                       // producer's copy of tail
+    alignas(64) std::atomic<uint32_t> tail{ 0 };  // next slot to read, advanced by the consumer
+    uint32_t cachedHead = 0;                       // consumer's copy of head
+    alignas(64) std::atomic<bool> sleeping{ false };
+    Slot slots[SLOTS];
+#ifdef _WIN32
+    HANDLE wakeEvent = NULL;
+#endif
+
+    static void relax() {
+#ifdef _WIN32
+        YieldProcessor();
+#else
+        std::this_thread::yield();
+#endif
+    }
+
+public:
+    SpscRing() {
+#ifdef _WIN32
+        wakeEvent = CreateEventW(NULL, FALSE, FALSE, NULL);
+#endif
+    }
+
+    ~SpscRing() {
+#ifdef _WIN32
+        if (wakeEvent != NULL) CloseHandle(wakeEvent);
+#endif
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // Producer: copies data into the next slot, false when the ring is full or data does not fit
+    bool push(const char* data, int size) {
+        if (size < 0 || size > SLOT_SIZE) return false;
+        const uint32_t h = head.load(std::memory_order_relaxed);
+        if (h - cachedTail == SLOTS) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (h - cachedTail == SLOTS) return false;
+        }
+        Slot& slot = slots[h & (SLOTS - 1)];
+        std::memcpy(slot.data, data, size);
+        slot.size = size;
+        head.store(h + 1, std::memory_order_seq_cst);
+        if (sleeping.load(std::memory_order_seq_cst)) wake();
+        return true;
+    }
+
+    // Consumer: copies the oldest slot into out, returns its size or -1 when the ring is empty
+    int pop(char* out) {
+        const uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t == cachedHead) {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (t == cachedHead) return -1;
+        }
+        const Slot& slot = slots[t & (SLOTS - 1)];
+        int size = slot.size;
+        std::memcpy(out, slot.data, size);
+        tail.store(t + 1, std::memory_order_release);
+        return size;
+    }
+
+    // Consumer: true when a slot is waiting
+    bool ready() {
+        if (tail.load(std::memory_order_relaxed) != cachedHead) return true;
+        cachedHead = head.load(std::memory_order_acquire);
+        return tail.load(std::memory_order_relaxed) != cachedHead;
+    }
+
+    // Consumer: blocks until a slot is waiting, wake() is called or timeoutMillisec passes
+    void wait(int timeoutMillisec) {
+        for (int i = 0; i < SPIN_ITERATIONS; ++i) {
+            if (ready()) return;
+            relax();
+        }
+        sleeping.store(true, std::memory_order_seq_cst);
+        // orders the store above before the check of head below, against push()'s store of head
+        // then load of sleeping: one of the two sides is bound to see the other
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!ready()) {
+#ifdef _WIN32
+            WaitForSingleObject(wakeEvent, static_cast<DWORD>(timeoutMillisec));
+#else
+            const auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMillisec);
+            while (!ready() && sleeping.load(std::memory_order_seq_cst) && std::chrono::steady_clock::now() < until)
+                std::this_thread::yield();
+#endif
+        }
+        sleeping.store(false, std::memory_order_relaxed);
+    }
+
+    // Either side: cuts a wait() short, for shutting the consumer down
+    void wake() {
+        sleeping.store(false, std::memory_order_relaxed);
+#ifdef _WIN32
+        SetEvent(wakeEvent);
+#endif
+    }
+
+    void clear() {
+        head.store(0);
+        tail.store(0);
+        cachedHead = cachedTail = 0;
+    }
+};
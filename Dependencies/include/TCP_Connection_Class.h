@@ -78,6 +78,8 @@ public:
     // Data communication methods...
     int send_data(const char* data, int size);
     int receive_data(char* buffer, int bufferSize);
+    int wait_for_data(int timeoutMillisec); // > 0 when data is ready to be received, 0 on timeout
+    SOCKET listening_socket() const { return serverSocket; } // readable when a connection can be accepted
 
     // Data communication methods with header...
     int send_data(const char* data, int size, const std::unordered_map<std::string, std::string>& header);
@@ -253,6 +255,21 @@ int TCPConnection::receive_data(char* buffer, int bufferSize) {
     return bytesReceived;
 }
 
+int TCPConnection::wait_for_data(int timeoutMillisec) {
+    fd_set readSet;
+    FD_ZERO(&readSet);
+    FD_SET(clientSocket, &readSet);
+    timeval tv{ timeoutMillisec / 1000, (timeoutMillisec % 1000) * 1000 };
+
+    int ready = select(0, &readSet, nullptr, nullptr, &tv);
+    if (ready == SOCKET_ERROR) {
+        int err = WSAGetLastError();
+        if (!silent) std::cerr << "Failed to wait for data : " << err << std::endl;
+        return -err;
+    }
+    return ready;
+}
+
 std::vector<char> TCPConnection::pack_header(const std::unordered_map<std::string, std::string>& header) {
     std::vector<char> headerData;
     for (const auto& pair : header) {
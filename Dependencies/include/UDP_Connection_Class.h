@@ -29,13 +29,20 @@ THE SOFTWARE.
 
 #include <iostream>
 #include <cstring>
+#include <random>
 #include <string>
 #include <vector>
 #include <winsock2.h>
 #include <ws2tcpip.h>
 #include "identme.h" // query your IP address using http://ident.me
+#include "ControlChannel.hpp"
+#include "DatagramBatch.hpp"
+#include "NetJoyProtocol.h"
 
 constexpr size_t DEFAULT_UDP_BUFFER_SIZE = 128;
+constexpr int UDP_HANDSHAKE_TIMEOUT_MILLISECONDS = 1000;
+constexpr int UDP_HANDSHAKE_RTO_MILLISECONDS = 50;      // first retransmit, doubles each time
+constexpr int UDP_HANDSHAKE_MAX_RTO_MILLISECONDS = 400;
 
 class UDPConnection {
 private:
@@ -49,6 +56,11 @@ private:
     struct sockaddr_in* other = nullptr; // simplifies 1 server/1 client communication
     bool silent = false;
     bool server = false;
+    bool blocking = true;
+    uint16_t sessionId = 0;
+    bool ackedSignals = false;      // the peer acknowledges control signals
+    uint16_t resumeSessionId = 0;   // offered in the next SYN instead of a random id
+    ControlChannel control;
     char* defaultBuffer = nullptr;
     size_t defaultBufferSize = 0;
     bool alloc_buff = false;
@@ -66,14 +78,15 @@ public:
         PACKET_ACK = 3,     // Client-> Server: confirm handshake complete
         PACKET_ALIVE = 4,   // Client-> Server: i am still here
         PACKET_HANGUP = 5,  // ? -> ? : Goodbye!
+        PACKET_SIG_ACK = 6, // ? -> ? : got the signal whose seq_number is in ack_number
     };
     // Simple packet structure
 #pragma pack(push, 1)
     struct SIGPacket { // Keep total size below max of 24b to fit in joysender feedback buffer (joyreceiver:64b)
         uint8_t  type;         // Of PacketType
         uint16_t session_id;   // Randomly generated handshake/session ID
-        uint16_t seq_number;   // Optional (for data sequencing)
-        uint16_t ack_number;   // Optional (for ACK responses)
+        uint16_t seq_number;   // Optional, an acked control signal: answer with a PACKET_SIG_ACK
+        uint16_t ack_number;   // Optional, PACKET_SIG_ACK: the seq_number acknowledged
         uint8_t  payload_size; // Optional data length
         char     payload[12];  // Optional small payload
     };
@@ -91,99 +104,211 @@ public:
         return p;
     }
 
+    // true when a datagram is a SIGPacket rather than input/feedback data
+    inline static bool is_sig_packet(const char* data, int size) {
+        return size == sizeof(SIGPacket) &&
+            static_cast<uint8_t>(data[0]) >= PACKET_SYN && static_cast<uint8_t>(data[0]) <= PACKET_SIG_ACK;
+    }
+
+    // Random id a client offers in its SYN, lets a multi-client host tell senders apart
+    inline static uint16_t new_session_id() {
+        static std::mt19937 rng{ std::random_device{}() };
+        return static_cast<uint16_t>(std::uniform_int_distribution<int>(1, 0xFFFF)(rng));
+    }
+
+    // Waits up to timeoutMillisec for the next SIGPacket, skipping other datagrams.
+    // Returns its size, 0 on timeout or -error
+    int receive_sig_packet(SIGPacket& pkt, sockaddr_in& from, int timeoutMillisec) {
+        return receive_sig_packet_until(pkt, from, netjoy_clock_us() + timeoutMillisec * 1000LL);
+    }
+
+    // receive_sig_packet up to deadline, a netjoy_clock_us() time
+    int receive_sig_packet_until(SIGPacket& pkt, sockaddr_in& from, int64_t deadline) {
+        char data[DEFAULT_UDP_BUFFER_SIZE];
+        for (int64_t now = netjoy_clock_us(); now < deadline; now = netjoy_clock_us()) {
+            int ready = wait_for_data(static_cast<int>((deadline - now + 999) / 1000));
+            if (ready <= 0) return ready;
+
+            int fromLen = sizeof(from);
+            int len = recvfrom(udpSocket, data, sizeof(data), 0, (sockaddr*)&from, &fromLen);
+            if (len == SOCKET_ERROR) {
+                int err = WSAGetLastError();
+                if (err == WSAEWOULDBLOCK || err == WSAECONNRESET || err == WSAEMSGSIZE) continue;
+                return -err;
+            }
+            if (is_sig_packet(data, len)) {
+                std::memcpy(&pkt, data, sizeof(pkt));
+                return len;
+            }
+        }
+        return 0;
+    }
+
+    static bool same_peer(const sockaddr_in& a, const sockaddr_in& b) {
+        return a.sin_addr.s_addr == b.sin_addr.s_addr && a.sin_port == b.sin_port;
+    }
+
+    // Handshakes are driven by the packets that arrive: the SYN (client) or SYN_ACK (server) is
+    // retransmitted on a doubling timer until answered or UDP_HANDSHAKE_TIMEOUT_MILLISECONDS pass.
+    // The timer runs on netjoy_clock_us(), GetTickCount64 steps in ~15.6 ms ticks
     const bool udp_handshake_client() {
-        SIGPacket syn{ PACKET_SYN, 69420 };
-        sendto(udpSocket, (const char*)&syn, sizeof(syn), 0, (sockaddr*)&servaddr, addrlen);
+        sessionId = resumeSessionId ? resumeSessionId : new_session_id();
+        SIGPacket syn = make_packet(PACKET_SYN, sessionId);
 
-        timeval tv{ 1, 0 }; // 1 sec timeout
+        timeval tv{ 1, 0 }; // 1 sec timeout for the receives that follow
         setsockopt(udpSocket, SOL_SOCKET, SO_RCVTIMEO, (const char*)&tv, sizeof(tv));
 
-        sockaddr_in fromAddr{};
-        int fromLen = sizeof(fromAddr);
-        SIGPacket recvPkt{};
-        Sleep(10);
-        int recvLen = recvfrom(udpSocket, (char*)&recvPkt, sizeof(recvPkt), 0,
-            (sockaddr*)&fromAddr, &fromLen);
+        const int64_t deadline = netjoy_clock_us() + UDP_HANDSHAKE_TIMEOUT_MILLISECONDS * 1000LL;
+        int64_t resendAt = 0;
+        int64_t rto = UDP_HANDSHAKE_RTO_MILLISECONDS * 1000LL;  // us
+        for (int64_t now = netjoy_clock_us(); now < deadline; now = netjoy_clock_us()) {
+            if (now >= resendAt) {
+                sendto(udpSocket, (const char*)&syn, sizeof(syn), 0, (sockaddr*)&servaddr, addrlen);
+                resendAt = now + rto;
+                if (rto < UDP_HANDSHAKE_MAX_RTO_MILLISECONDS * 1000LL) rto *= 2;
+            }
+            int64_t until = (resendAt < deadline) ? resendAt : deadline;
 
-        for (int retries = 0; retries < 3; ++retries) {
+            SIGPacket recvPkt{};
+            sockaddr_in fromAddr{};
+            int recvLen = receive_sig_packet_until(recvPkt, fromAddr, until);
             if (recvLen < 0) {
-                int err = WSAGetLastError();
-                if (err == WSAETIMEDOUT || err == WSAEWOULDBLOCK) {
-                    Sleep(30);
-                    recvLen = recvfrom(udpSocket, (char*)&recvPkt, sizeof(recvPkt), 0,
-                        (sockaddr*)&fromAddr, &fromLen);
-                    continue;
-                }
-                else {
-                    //std::cerr << "Recv error: " << err << "\n";
-                    return false;
-                }
+                WSASetLastError(-recvLen);
+                return false;
             }
-
-            if (recvPkt.type == PACKET_SYN_ACK && recvPkt.session_id == syn.session_id) {
-                SIGPacket ack{ PACKET_ACK, syn.session_id };
+            if (recvLen > 0 && recvPkt.type == PACKET_SYN_ACK && recvPkt.session_id == syn.session_id) {
+                SIGPacket ack = make_packet(PACKET_ACK, syn.session_id);
                 sendto(udpSocket, (const char*)&ack, sizeof(ack), 0,
                     (sockaddr*)&servaddr, addrlen);
                 return true;
             }
         }
-        //std::cerr << "Handshake failed\n";
+        WSASetLastError(WSAETIMEDOUT);
         return false;
     }
 
-    const bool udp_handshake_server() {
-        sockaddr_in clientAddr{};
-        int clientLen = sizeof(clientAddr);
-        SIGPacket recvPkt{};
-
-        Sleep(10);
-        int recvLen = recvfrom(udpSocket, (char*)&recvPkt, sizeof(recvPkt), 0,
-            (sockaddr*)&clientAddr, &clientLen);
-        if (recvLen <= 0 || recvPkt.type != PACKET_SYN) return false;
-
-        char addrStr[INET_ADDRSTRLEN];
-        inet_ntop(AF_INET, &clientAddr.sin_addr, addrStr, INET_ADDRSTRLEN);
-
-        SIGPacket synAck{ PACKET_SYN_ACK, recvPkt.session_id };
-        sendto(udpSocket, (char*)&synAck, sizeof(synAck), 0,
-            (sockaddr*)&clientAddr, clientLen);
-
-        Sleep(10);
-        // final ACK
-        SIGPacket ackPkt{};
-        recvLen = recvfrom(udpSocket, (char*)&ackPkt, sizeof(ackPkt), 0,
-            (sockaddr*)&clientAddr, &clientLen);
+    // firstSyn is the SYN await_connection already took off the socket, if any (sent from *other)
+    const bool udp_handshake_server(const SIGPacket* firstSyn = nullptr) {
+        sockaddr_in clientAddr = *other;
+        bool haveSyn = (firstSyn != nullptr);
+        if (haveSyn) sessionId = firstSyn->session_id;
+
+        const int64_t deadline = netjoy_clock_us() + UDP_HANDSHAKE_TIMEOUT_MILLISECONDS * 1000LL;
+        int64_t resendAt = 0;
+        int64_t rto = UDP_HANDSHAKE_RTO_MILLISECONDS * 1000LL;  // us
+        for (int64_t now = netjoy_clock_us(); now < deadline; now = netjoy_clock_us()) {
+            if (haveSyn && now >= resendAt) {
+                SIGPacket synAck = make_packet(PACKET_SYN_ACK, sessionId);
+                sendto(udpSocket, (const char*)&synAck, sizeof(synAck), 0,
+                    (sockaddr*)&clientAddr, sizeof(clientAddr));
+                resendAt = now + rto;
+                if (rto < UDP_HANDSHAKE_MAX_RTO_MILLISECONDS * 1000LL) rto *= 2;
+            }
+            int64_t until = (haveSyn && resendAt < deadline) ? resendAt : deadline;
 
-        for (int retries = 0; retries < 3; ++retries) {
+            SIGPacket recvPkt{};
+            sockaddr_in fromAddr{};
+            int recvLen = receive_sig_packet_until(recvPkt, fromAddr, until);
             if (recvLen < 0) {
-                int err = WSAGetLastError();
-                if (err == WSAEWOULDBLOCK || err == WSAETIMEDOUT) {
-                    Sleep(30);
-                    recvLen = recvfrom(udpSocket, (char*)&ackPkt, sizeof(ackPkt), 0,
-                        (sockaddr*)&clientAddr, &clientLen);
-                    continue;
-                }
-                else {
-                    std::cerr << "Recv error: " << err << "\n";
-                    return false;
+                WSASetLastError(-recvLen);
+                return false;
+            }
+            if (recvLen == 0) continue;
+
+            if (recvPkt.type == PACKET_SYN) {
+                // a repeated SYN means our SYN_ACK was lost, answer it straight away
+                if (!haveSyn || recvPkt.session_id != sessionId || !same_peer(fromAddr, clientAddr)) {
+                    sessionId = recvPkt.session_id;
+                    clientAddr = fromAddr;
+                    haveSyn = true;
+                    rto = UDP_HANDSHAKE_RTO_MILLISECONDS * 1000LL;
                 }
+                resendAt = 0;
             }
-            else if (recvLen > 0 && ackPkt.type == PACKET_ACK &&
-                ackPkt.session_id == recvPkt.session_id) {
-                //std::cerr << "Handshake success!\n";
+            else if (haveSyn && recvPkt.type == PACKET_ACK &&
+                recvPkt.session_id == sessionId && same_peer(fromAddr, clientAddr)) {
+                *other = clientAddr;
                 return true;
             }
-            else {
-                int err = WSAGetLastError();
-                //std::cerr << "Wrong packet? Error: " << err << std::endl;
-            }
         }
-        //std::cerr << "Handshake incomplete.\n";
+        WSASetLastError(WSAETIMEDOUT);
         return false;
     }
 
     /***********^^ HAND-SHAKING ^^****************/
 
+    //--vv Acked signals vv--//
+    // Once both sides agree (NETJOY_CAP_ACKED_SIGNALS) a control signal goes out with a seq_number,
+    // the peer answers it with a PACKET_SIG_ACK and it is resent on a doubling timer until it does.
+    // Older peers never see a seq_number or a PACKET_SIG_ACK
+    void set_acked_signals(bool on) {
+        ackedSignals = on;
+        control.reset();
+    }
+
+    // Sends a signal to to, tracked for resending when acked is set. Returns its seq, 0 when untracked
+    uint16_t send_signal(PacketType type, uint16_t session, const sockaddr_in& to, bool acked) {
+        SIGPacket pkt = make_packet(type, session);
+        if (acked) pkt.seq_number = control.track(type, session, to, netjoy_clock_us());
+        send_to((const char*)&pkt, sizeof(pkt), to);
+        return pkt.seq_number;
+    }
+
+    // Resends every tracked signal whose timer ran out
+    void resend_signals() {
+        ControlSignal due;
+        while (control.next_due(netjoy_clock_us(), due)) {
+            SIGPacket pkt = make_packet(static_cast<PacketType>(due.type), due.sessionId);
+            pkt.seq_number = due.seq;
+            send_to((const char*)&pkt, sizeof(pkt), due.to);
+        }
+    }
+
+    // Answers a signal from that wants an ack and takes in the acks for ours. Returns false when
+    // there is nothing more to do with it: an ack, or a resend of a signal already acted on
+    bool accept_signal(const SIGPacket& pkt, const sockaddr_in& from) {
+        if (pkt.type == PACKET_SIG_ACK) {
+            control.acknowledge(pkt.ack_number, from);
+            return false;
+        }
+        if (pkt.seq_number == 0) return true;
+
+        SIGPacket ack = make_packet(PACKET_SIG_ACK, pkt.session_id);
+        ack.ack_number = pkt.seq_number;
+        send_to((const char*)&ack, sizeof(ack), from);
+        return control.first_delivery(from, pkt.session_id, pkt.seq_number);
+    }
+
+    // accept_signal for the one peer of a 1 server/1 client connection
+    bool accept_signal(const char* data) {
+        if (other == nullptr) return true;
+        SIGPacket pkt;
+        std::memcpy(&pkt, data, sizeof(pkt));
+        return accept_signal(pkt, *other);
+    }
+
+    // Says goodbye to the one peer. With acked signals the HANGUP is resent until acknowledged or
+    // CONTROL_TIMEOUT_MILLISECONDS pass, the socket is read meanwhile for the ack (a feedback thread
+    // reading along hands it over through the ControlChannel). Returns true once acknowledged
+    bool hang_up() {
+        if (other == nullptr) return false;
+        const uint16_t seq = send_signal(PACKET_HANGUP, sessionId, *other, ackedSignals);
+        if (seq == 0) return false;
+
+        const sockaddr_in peer = *other;
+        const int64_t deadline = netjoy_clock_us() + CONTROL_TIMEOUT_MILLISECONDS * 1000LL;
+        for (int64_t now = netjoy_clock_us(); now < deadline && control.is_pending(seq); now = netjoy_clock_us()) {
+            const int64_t until = now + CONTROL_RTO_MILLISECONDS * 1000LL;
+            SIGPacket pkt{};
+            sockaddr_in from{};
+            int len = receive_sig_packet_until(pkt, from, until < deadline ? until : deadline);
+            if (len < 0) break;
+            if (len > 0 && same_peer(from, peer)) accept_signal(pkt, from);
+            resend_signals();
+        }
+        return !control.is_pending(seq);
+    }
+
 public:
     UDPConnection();
     UDPConnection(const std::string& hostAddress = "127.0.0.1", int port = 5000, const std::string& listenAddress = "0.0.0.0");
@@ -210,6 +335,21 @@ public:
     // Data communication methods..
     int send_data(const char* data, int size);
     int receive_data(char* buffer, int bufferSize);
+    int wait_for_data(int timeoutMillisec); // > 0 when a datagram is ready to be received, 0 on timeout
+    SOCKET listening_socket() const { return udpSocket; } // readable when a client pokes the server
+
+    // Multi-client server: address each datagram instead of using the single 'other'
+    int receive_from(char* buffer, int bufferSize, sockaddr_in& from);
+    int send_to(const char* data, int size, const sockaddr_in& to);
+
+    // Waits up to timeoutMillisec for a datagram then drains everything queued on the socket (up to
+    // UDPBatch::MAX_PACKETS) without waiting again. Returns the number received, 0 on timeout or -error
+    int receive_batch(UDPBatch& batch, int timeoutMillisec);
+    // Sends every datagram in the batch, returns how many went out or -error if none did
+    int send_batch(const UDPBatch& batch);
+    uint16_t get_session_id() const { return sessionId; }
+    // A client that resumes a session offers its old id again in the handshake, 0 rolls a new one
+    void resume_session(uint16_t id) { resumeSessionId = id; }
 
     // new methods
     int get_available_data_size();  // dummy function, not relevant for UDP connections
@@ -255,6 +395,10 @@ public:
             this->other = other.other;
             silent = other.silent;
             server = other.server;
+            blocking = other.blocking;
+            sessionId = other.sessionId;
+            resumeSessionId = other.resumeSessionId;
+            ackedSignals = other.ackedSignals;
 
             // reset source
             other.defaultBuffer = nullptr;
@@ -383,10 +527,12 @@ void UDPConnection::set_silence(bool setting = true) {
 
 int UDPConnection::set_server_blocking(bool block) {
     u_long mode = !block;
+    blocking = block;
     return ioctlsocket(udpSocket, FIONBIO, &mode);
 }
 int UDPConnection::set_client_blocking(bool block) {
     u_long mode = !block;
+    blocking = block;
     return ioctlsocket(udpSocket, FIONBIO, &mode);
 }
 
@@ -417,6 +563,74 @@ int UDPConnection::receive_data(char* buffer, int bufferSize) {
     return bytesReceived;
 }
 
+int UDPConnection::receive_from(char* buffer, int bufferSize, sockaddr_in& from) {
+    int fromLen = sizeof(from);
+    int bytesReceived = recvfrom(udpSocket, buffer, bufferSize, 0, (sockaddr*)&from, &fromLen);
+    if (bytesReceived == SOCKET_ERROR) {
+        int err = WSAGetLastError();
+        if (err != WSAEWOULDBLOCK) {
+            if (!silent) std::cerr << "Failed to receive data : " << err << std::endl;
+        }
+        return -err;
+    }
+    return bytesReceived;
+}
+
+int UDPConnection::send_to(const char* data, int size, const sockaddr_in& to) {
+    int bytesSent = sendto(udpSocket, data, size, 0, (const sockaddr*)&to, sizeof(to));
+    if (bytesSent == SOCKET_ERROR) {
+        int err = WSAGetLastError();
+        if (err != WSAEWOULDBLOCK) {
+            if (!silent) std::cerr << "Failed to send data :" << err << std::endl;
+        }
+        return -err;
+    }
+    return bytesSent;
+}
+
+// A batch is one select followed by a drain of everything queued (DatagramBatch.hpp), so a burst from
+// many senders costs a single wait rather than one per datagram. Winsock has no recvmmsg, its drain is
+// a recvfrom per datagram on a socket made non-blocking for the drain and put back as it was after
+int UDPConnection::receive_batch(UDPBatch& batch, int timeoutMillisec) {
+    batch.clear();
+    int ready = wait_for_data(timeoutMillisec);
+    if (ready <= 0) return ready;
+
+    const bool wasBlocking = blocking;
+    if (wasBlocking) set_server_blocking(false);
+    int err = 0;
+    int count = receive_datagrams(udpSocket, batch, err);
+    if (wasBlocking) set_server_blocking(true);
+
+    if (err && !silent) std::cerr << "Failed to receive data : " << err << std::endl;
+    return (count == 0 && err) ? -err : count;
+}
+
+int UDPConnection::send_batch(const UDPBatch& batch) {
+    int lastErr = 0;
+    int sent = send_datagrams(udpSocket, batch, lastErr);
+    if (sent == 0 && lastErr) {
+        if (!silent && lastErr != WSAEWOULDBLOCK) std::cerr << "Failed to send data :" << lastErr << std::endl;
+        return -lastErr;
+    }
+    return sent;
+}
+
+int UDPConnection::wait_for_data(int timeoutMillisec) {
+    fd_set readSet;
+    FD_ZERO(&readSet);
+    FD_SET(udpSocket, &readSet);
+    timeval tv{ timeoutMillisec / 1000, (timeoutMillisec % 1000) * 1000 };
+
+    int ready = select(0, &readSet, nullptr, nullptr, &tv);
+    if (ready == SOCKET_ERROR) {
+        int err = WSAGetLastError();
+        if (!silent) std::cerr << "Failed to wait for data : " << err << std::endl;
+        return -err;
+    }
+    return ready;
+}
+
 void UDPConnection::allocate_default_buffer() {
     alloc_buff = true;
     defaultBuffer = new char[DEFAULT_UDP_BUFFER_SIZE];
@@ -428,12 +642,16 @@ std::pair<SOCKET, sockaddr_in> UDPConnection::await_connection() {
     sockaddr_in clientAddress{};
 
     int bytesReceived = recvfrom(udpSocket, defaultBuffer, defaultBufferSize, 0, (sockaddr*)other, &addrlen);
+    const SIGPacket* syn = nullptr;
     if (bytesReceived == sizeof(UDPConnection::SIGPacket)) {
-        // FOR NOW SIGPackets are not associated with establishing connections
-        // and should be ignored as hangup notices, to not crash out on handshaking
+        // a SYN that beat (or lost) the client's poke starts the handshake itself, other SIGPackets
+        // are stale hangup notices and ignored, to not crash out on handshaking
         // use WSASetLastError and the caller will be none the wiser **if from same thread**
-        WSASetLastError(WSAEWOULDBLOCK); 
-        return { INVALID_SOCKET, {} };
+        syn = reinterpret_cast<const SIGPacket*>(defaultBuffer);
+        if (syn->type != PACKET_SYN) {
+            WSASetLastError(WSAEWOULDBLOCK);
+            return { INVALID_SOCKET, {} };
+        }
     }
     if (bytesReceived == SOCKET_ERROR)
     {
@@ -451,7 +669,8 @@ std::pair<SOCKET, sockaddr_in> UDPConnection::await_connection() {
         return { INVALID_SOCKET, {} };
     }
 
-    bool connected = udp_handshake_server();
+    bool connected = udp_handshake_server(syn);
+    clientAddress = *other;
     if (!connected) {
         if (!silent) std::cerr << "Failed to perform upd handshake with " << clientIP << std::endl;
         WSASetLastError(WSAEWOULDBLOCK);
@@ -0,0 +1,124 @@
+/*
+
+Copyright (c) 2025 Dave Quinn <qcent@yahoo.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "cxxopts.hpp"
+
+struct Arguments {
+    std::string host = "127.0.0.1";
+    int port = 5000;
+    bool udp = true;
+    bool tcp = false;
+    int pads = 4;
+    int mode = 1;               // 1: Xbox360, 2: DS4, 3: alternate per pad
+    std::vector<int> fps;       // handed out to the pads in turn
+    std::string input = "random";
+    uint32_t seed = 1;
+    int redundancy = 0;
+    int fec = 0;
+    int duration = 0;           // seconds, 0 runs until Ctrl+C
+    int ramp = 100;             // ms between pads connecting
+    bool aligned = false;
+};
+
+Arguments parse_arguments(int argc, char* argv[]) {
+    Arguments args;
+    cxxopts::Options options("JoyLoad", "JoyLoad : Load a JoyReceiver with simulated senders over tcp/udp");
+    options.allow_unrecognised_options();
+    options.add_options()
+        ("n,host", "IP address of host/server", cxxopts::value<std::string>()->default_value("127.0.0.1"))
+        ("p,port", "Port to run on", cxxopts::value<int>()->default_value("5000"))
+        ("c,pads", "Simulated controllers, each its own connection (1-256)", cxxopts::value<int>()->default_value("4"))
+        ("m,mode", "Operational Mode: 1: Xbox360 Emulation, 2: DS4 Emulation, 3: alternate", cxxopts::value<int>()->default_value("1"))
+        ("f,fps", "Reports per second of each pad, a comma separated list is handed out in turn", cxxopts::value<std::string>()->default_value("0"))
+        ("i,input", "random, idle, or a script file to play on every pad", cxxopts::value<std::string>()->default_value("random"))
+        ("seed", "Seed of the random input, pad n uses seed + n", cxxopts::value<uint32_t>()->default_value("1"))
+        ("t,tcp", "Use TCP protocol", cxxopts::value<bool>()->implicit_value("true"))
+        ("u,udp", "Use UDP protocol", cxxopts::value<bool>()->implicit_value("true"))
+        ("r,redundancy", "Previous frames repeated in each UDP datagram to hide packet loss (0-4)", cxxopts::value<int>()->default_value("0"))
+        ("e,fec", "Send an XOR parity datagram after every K UDP datagrams (2-16, 0 = off)", cxxopts::value<int>()->default_value("0"))
+        ("d,duration", "Seconds to run before hanging up and reporting, 0 runs until Ctrl+C", cxxopts::value<int>()->default_value("0"))
+        ("ramp", "Milliseconds between pads connecting", cxxopts::value<int>()->default_value("100"))
+        ("aligned", "Send every pad on the same tick instead of spreading them over the frame", cxxopts::value<bool>()->implicit_value("true"))
+        ("h,help", "Display this help message");
+
+    options.parse_positional("host");
+    cxxopts::ParseResult result;
+
+    try {
+        result = options.parse(argc, argv);
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        std::cout << options.help() << std::endl;
+        exit(0);
+    }
+
+    if (result.count("help")) {
+        std::cout << options.help() << std::endl;
+        exit(0);
+    }
+
+    if (result.unmatched().size()) {
+        std::cout << "Illegal argument" << std::endl;
+        std::cout << options.help() << std::endl;
+        exit(0);
+    }
+
+    args.host = result["host"].as<std::string>();
+    args.port = result["port"].as<int>();
+    args.pads = result["pads"].as<int>();
+    if (args.pads < 1) args.pads = 1;
+    if (args.pads > 256) args.pads = 256;
+    args.mode = result["mode"].as<int>();
+    if (args.mode < 1 || args.mode > 3) args.mode = 1;
+    args.input = result["input"].as<std::string>();
+    args.seed = result["seed"].as<uint32_t>();
+    args.udp = result["udp"].as<bool>();
+    args.tcp = result["tcp"].as<bool>();
+    args.redundancy = result["redundancy"].as<int>();
+    args.fec = result["fec"].as<int>();
+    args.duration = result["duration"].as<int>();
+    args.ramp = result["ramp"].as<int>();
+    if (args.ramp < 0) args.ramp = 0;
+    args.aligned = result["aligned"].as<bool>();
+
+    args.udp = args.tcp ? false : true;
+
+    std::string fps = result["fps"].as<std::string>();
+    size_t start = 0;
+    while (start <= fps.size()) {
+        size_t comma = fps.find(',', start);
+        if (comma == std::string::npos) comma = fps.size();
+        int rate = std::atoi(fps.substr(start, comma - start).c_str());
+        if (rate <= 0) rate = args.udp ? 80 : 60; // JoySender's defaults
+        if (rate > 1000) rate = 1000;
+        args.fps.push_back(rate);
+        start = comma + 1;
+    }
+
+    return args;
+}
@@ -0,0 +1,130 @@
+/*
+
+Copyright (c) 2025 Dave Quinn <qcent@yahoo.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+
+#include "JoyLoad.h"
+
+static void signalHandler(int signal) {
+    if (signal == SIGINT) {
+        APP_KILLED = 1;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Arguments args = parse_arguments(argc, argv);
+    UDP_COMMUNICATION = args.udp;
+
+    // Register the signal handler function
+    std::signal(SIGINT, signalHandler);
+    SetConsoleTitleW(args.udp ? L"JoyLoad UDP" : L"JoyLoad TCP");
+
+    std::vector<InputStep> script;
+    SyntheticInput::Kind kind = SyntheticInput::RANDOM;
+    if (args.input == "idle") {
+        kind = SyntheticInput::IDLE;
+    }
+    else if (args.input != "random") {
+        if (!JOYLOAD_LOAD_SCRIPT(args.input, script)) {
+            std::cout << " Unable to read an input script from " << args.input << " !! " << std::endl;
+            return -1;
+        }
+        kind = SyntheticInput::SCRIPT;
+    }
+
+    std::vector<std::unique_ptr<SimulatedPad>> pads;
+    for (int i = 0; i < args.pads; ++i) {
+        auto pad = std::make_unique<SimulatedPad>();
+        pad->index = i;
+        pad->mode = (args.mode == 3) ? (i % 2 ? REPORT_FORMAT_DS4 : REPORT_FORMAT_XUSB) : args.mode;
+        pad->rate = args.fps[i % args.fps.size()];
+        pad->period = 1000000 / pad->rate;
+        // scripted pads start just under a second apart in the script so they do not move in lockstep
+        pad->input.reset(kind, &script, args.seed + i, pad->mode == REPORT_FORMAT_DS4, i * 997000LL);
+        pads.push_back(std::move(pad));
+    }
+
+    std::cout << "JoyLoad: " << args.pads << " pads -> " << args.host << ":" << args.port << (args.udp ? " UDP" : " TCP")
+        << ", input " << args.input << std::endl;
+    if (!args.udp && args.pads > 1)
+        std::cout << "  (JoyReceiver serves one TCP sender at a time, use UDP and -c on the receiver for several)" << std::endl;
+
+    // the send loop starts with the first pad, pads join it as they connect
+    volatile bool stopSending = false;
+    const int64_t runStart = netjoy_clock_us();
+    std::thread sendThread(JOYLOAD_SEND_LOOP, std::ref(pads), std::cref(stopSending), args.aligned, runStart);
+
+    int connected = 0;
+    for (auto& pad : pads) {
+        if (APP_KILLED) break;
+        if (JOYLOAD_CONNECT(*pad, args)) {
+            ++connected;
+            pad->state = PAD_RUNNING;
+            pad->inConnection = true;
+            pad->feedbackThread = std::thread(JOYLOAD_FEEDBACK_THREAD, pad.get());
+            std::cout << "<< Pad " << pad->index + 1 << " connected in " << pad->connectTime / 1000.0 << " ms >>" << std::endl;
+        }
+        else {
+            pad->state = PAD_FAILED;
+            std::cout << "<< Pad " << pad->index + 1 << " failed to connect >>" << std::endl;
+        }
+        if (args.ramp) Sleep(args.ramp);
+    }
+
+    // one line a second until Ctrl+C, the duration or every pad has stopped
+    const int64_t loadStart = netjoy_clock_us();
+    uint64_t lastSent = 0, lastFeedback = 0;
+    int64_t lastTick = loadStart;
+    while (!APP_KILLED && connected) {
+        Sleep(1000);
+        const int64_t now = netjoy_clock_us();
+        uint64_t sent = 0, feedback = 0;
+        int running = 0;
+        for (auto& pad : pads) {
+            sent += pad->sent;
+            feedback += pad->feedback;
+            if (pad->inConnection) ++running;
+        }
+        const double seconds = (now - lastTick) / 1000000.0;
+        char line[128];
+        snprintf(line, sizeof(line), "\rPads %d/%d  Sent %.1f/s  Feedback %.1f/s   ", running, args.pads,
+            (sent - lastSent) / seconds, (feedback - lastFeedback) / seconds);
+        std::cout << line << std::flush;
+        lastSent = sent;
+        lastFeedback = feedback;
+        lastTick = now;
+        if (!running) break;
+        if (args.duration && now - loadStart >= args.duration * 1000000LL) break;
+    }
+    std::cout << std::endl;
+
+    // stop sending before saying goodbye, each feedback thread hangs up its own pad
+    stopSending = true;
+    sendThread.join();
+    for (auto& pad : pads) pad->inConnection = false;
+    for (auto& pad : pads) {
+        if (pad->feedbackThread.joinable()) pad->feedbackThread.join();
+    }
+
+    JOYLOAD_PRINT_REPORT(pads);
+    return 0;
+}
@@ -0,0 +1,550 @@
+/*
+Copyright (c) 2025 Dave Quinn <qcent@yahoo.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#pragma once
+#define NOMINMAX
+
+#include <iostream>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <csignal>
+#include <random>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "NetworkCommunication.h"
+#include "ArgumentParser.hpp"
+#include "LatencyHistogram.hpp"
+
+// GLOBAL VARIABLES
+volatile sig_atomic_t APP_KILLED = 0;
+
+// A pad paused by its script sends a PACKET_ALIVE this often instead of reports (UDP), as JoySender does while mapping
+constexpr int64_t JOYLOAD_KEEPALIVE_US = 100000;
+// Feedback receives that time out in a row (NETWORK_TIMEOUT_MILLISECONDS each) before a pad's connection counts as lost
+constexpr int JOYLOAD_MAX_TIMEOUTS = 3;
+// The last stretch of a wait for the next send is spun instead of slept
+constexpr int64_t JOYLOAD_SPIN_US = 200;
+constexpr uint64_t JOYLOAD_STAMP_MASK = 0xFFFFFFFFFFFFULL;
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+// Input report layouts, as JoySender sends them: an XUSB_REPORT, or a DS4_REPORT_EX from bThumbLX
+constexpr int XUSB_TRIGGERS_OFFSET = 2;
+constexpr int XUSB_THUMBS_OFFSET = 4;
+constexpr int DS4_BUTTONS_OFFSET = 4;
+constexpr int DS4_TRIGGERS_OFFSET = 7;
+constexpr int DS4_TOUCH_OFFSET = 34;    // sCurrentTouch.bIsUpTrackingNum1
+constexpr uint16_t DS4_DPAD_NONE = 0x8;
+
+// One line of an input script: hold this state for ms, or (pause) send keep-alives only
+struct InputStep {
+    int ms = 0;
+    bool pause = false;
+    uint16_t buttons = 0;       // XUSB wButtons bits, moved to their DS4 places on a DS4 pad
+    uint8_t triggers[2] = {};   // left, right
+    int16_t thumbs[4] = {};     // LX, LY, RX, RY
+};
+
+// Script lines are "ms buttons lt rt lx ly rx ry" or "pause ms", # starts a comment. Every pad plays
+// the script in a loop, each starting at a different point. Returns false when nothing could be read
+bool JOYLOAD_LOAD_SCRIPT(const std::string& path, std::vector<InputStep>& steps) {
+    std::ifstream file(path);
+    if (!file) return false;
+    std::string line;
+    while (std::getline(file, line)) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream in(line);
+        std::string first;
+        if (!(in >> first)) continue;
+
+        InputStep step;
+        if (first == "pause") {
+            step.pause = true;
+            in >> step.ms;
+        }
+        else {
+            std::string buttons;
+            int lt = 0, rt = 0, thumbs[4] = {};
+            step.ms = std::atoi(first.c_str());
+            in >> buttons >> lt >> rt >> thumbs[0] >> thumbs[1] >> thumbs[2] >> thumbs[3];
+            step.buttons = static_cast<uint16_t>(std::strtol(buttons.c_str(), nullptr, 0));
+            step.triggers[0] = static_cast<uint8_t>(std::clamp(lt, 0, 255));
+            step.triggers[1] = static_cast<uint8_t>(std::clamp(rt, 0, 255));
+            for (int i = 0; i < 4; ++i) step.thumbs[i] = static_cast<int16_t>(std::clamp(thumbs[i], -32768, 32767));
+        }
+        if (step.ms > 0) steps.push_back(step);
+    }
+    return !steps.empty();
+}
+
+// XUSB buttons in DS4 wButtons / bSpecial bits
+void JOYLOAD_DS4_BUTTONS(uint16_t xusb, uint16_t& buttons, uint8_t& special) {
+    static const uint8_t dpad[16] = { 8, 0, 4, 8, 6, 7, 5, 6, 2, 1, 3, 2, 8, 0, 4, 8 }; // by up, down, left, right bits
+    buttons = dpad[xusb & 0xF];
+    if (xusb & 0x4000) buttons |= 1 << 4;   // X: square
+    if (xusb & 0x1000) buttons |= 1 << 5;   // A: cross
+    if (xusb & 0x2000) buttons |= 1 << 6;   // B: circle
+    if (xusb & 0x8000) buttons |= 1 << 7;   // Y: triangle
+    if (xusb & 0x0100) buttons |= 1 << 8;   // LB: L1
+    if (xusb & 0x0200) buttons |= 1 << 9;   // RB: R1
+    if (xusb & 0x0020) buttons |= 1 << 12;  // back: share
+    if (xusb & 0x0010) buttons |= 1 << 13;  // start: options
+    if (xusb & 0x0040) buttons |= 1 << 14;  // L3
+    if (xusb & 0x0080) buttons |= 1 << 15;  // R3
+    special = (xusb & 0x0400) ? 1 : 0;      // guide: PS
+}
+
+// Makes up a pad's reports: a seeded random walk of sticks, triggers, buttons (and DS4 motion),
+// a neutral pad, or a script. DS4 reports count and timestamp every frame as a real pad does
+class SyntheticInput {
+public:
+    enum Kind { RANDOM, IDLE, SCRIPT };
+
+private:
+    Kind kind = IDLE;
+    const std::vector<InputStep>* script = nullptr;
+    int64_t scriptLength = 0;   // us
+    int64_t offset = 0;         // us into the script at the start
+    std::mt19937 rng;
+    InputStep state;
+    bool ds4 = false;
+    bool moving = false;        // sticks and triggers move in spells, held still in between
+    uint8_t counter = 0;
+    uint16_t ds4Clock = 0;      // 5.33 us units
+    int16_t motion[6] = {};
+
+    const InputStep* step_at(int64_t elapsed) const {
+        int64_t at = (elapsed + offset) % scriptLength;
+        for (const InputStep& step : *script) {
+            at -= step.ms * 1000LL;
+            if (at < 0) return &step;
+        }
+        return &script->back();
+    }
+
+    int16_t walk(int16_t value, double spread, int low, int high) {
+        std::normal_distribution<double> step(0.0, spread);
+        return static_cast<int16_t>(std::clamp(static_cast<int>(value + step(rng)), low, high));
+    }
+
+    void random_step() {
+        std::uniform_real_distribution<double> chance(0.0, 1.0);
+        if (chance(rng) < 0.02) moving = !moving;
+        if (moving) {
+            for (int16_t& thumb : state.thumbs) {
+                thumb = (chance(rng) < 0.01) ? 0 : walk(thumb, 2000.0, -32768, 32767);
+            }
+            for (uint8_t& trigger : state.triggers) trigger = static_cast<uint8_t>(walk(trigger, 12.0, 0, 255));
+        }
+        if (chance(rng) < 0.03) state.buttons ^= static_cast<uint16_t>(1u << std::uniform_int_distribution<int>(0, 15)(rng)) & 0xF3FF;
+        if (ds4) {
+            for (int i = 0; i < 3; ++i) motion[i] = walk(motion[i], 30.0, -2000, 2000);         // gyro
+            for (int i = 3; i < 6; ++i) motion[i] = walk(motion[i], 20.0, -9000, 9000);        // accel
+        }
+    }
+
+public:
+    void reset(Kind inputKind, const std::vector<InputStep>* steps, uint32_t seed, bool ds4Report, int64_t startOffset) {
+        kind = (inputKind == SCRIPT && (steps == nullptr || steps->empty())) ? IDLE : inputKind;
+        script = steps;
+        scriptLength = 0;
+        if (kind == SCRIPT) {
+            for (const InputStep& step : *script) scriptLength += step.ms * 1000LL;
+        }
+        offset = startOffset;
+        rng.seed(seed);
+        state = InputStep();
+        ds4 = ds4Report;
+        moving = false;
+        counter = 0;
+        ds4Clock = 0;
+        std::memset(motion, 0, sizeof(motion));
+        motion[4] = 8192;   // resting on a table: 1 g down
+    }
+
+    // true while the script has the pad paused
+    bool paused(int64_t elapsed) const {
+        return kind == SCRIPT && step_at(elapsed)->pause;
+    }
+
+    // Writes the pad's report elapsed us into the run into report, period us after the last one. Returns its size
+    int fill(char* report, int64_t elapsed, int64_t period) {
+        if (kind == RANDOM) random_step();
+        else if (kind == SCRIPT) {
+            const InputStep* step = step_at(elapsed);
+            if (!step->pause) state = *step;
+        }
+
+        if (!ds4) {
+            std::memset(report, 0, XBOX_REPORT_NETWORK_DATA_SIZE);
+            std::memcpy(report, &state.buttons, sizeof(state.buttons));
+            std::memcpy(report + XUSB_TRIGGERS_OFFSET, state.triggers, 2);
+            std::memcpy(report + XUSB_THUMBS_OFFSET, state.thumbs, sizeof(state.thumbs));
+            return XBOX_REPORT_NETWORK_DATA_SIZE;
+        }
+
+        std::memset(report, 0, DS4_REPORT_NETWORK_DATA_SIZE);
+        for (int i = 0; i < 4; ++i) {
+            // DS4 sticks are 0-255 with up at 0
+            int axis = (state.thumbs[i] >> 8) + 128;
+            report[i] = static_cast<char>((i % 2) ? 255 - axis : axis);
+        }
+        uint16_t buttons;
+        uint8_t special;
+        JOYLOAD_DS4_BUTTONS(state.buttons, buttons, special);
+        std::memcpy(report + DS4_BUTTONS_OFFSET, &buttons, sizeof(buttons));
+        report[DS4_SPECIAL_OFFSET] = static_cast<char>((counter++ << 2) | special);
+        std::memcpy(report + DS4_TRIGGERS_OFFSET, state.triggers, 2);
+        ds4Clock = static_cast<uint16_t>(ds4Clock + period * 3 / 16);
+        std::memcpy(report + DS4_TIMESTAMP_OFFSET, &ds4Clock, sizeof(ds4Clock));
+        report[DS4_BATTERY_OFFSET] = static_cast<char>(0xF8);
+        std::memcpy(report + DS4_MOTION_OFFSET, motion, sizeof(motion));
+        report[DS4_TOUCH_OFFSET] = static_cast<char>(0x80);     // no finger down
+        report[DS4_TOUCH_OFFSET + 4] = static_cast<char>(0x80);
+        return DS4_REPORT_NETWORK_DATA_SIZE;
+    }
+};
+
+// How a simulated pad's connection went, the first ending reason sticks
+enum PadState : int {
+    PAD_WAITING,
+    PAD_FAILED,         // never connected
+    PAD_RUNNING,
+    PAD_LOST,           // feedback stopped
+    PAD_HUNG_UP,        // the host said goodbye
+    PAD_SEND_FAILED,
+    PAD_DONE,           // we hung up
+};
+
+const char* JOYLOAD_STATE_NAME(int state) {
+    switch (state) {
+    case PAD_FAILED: return "Failed";
+    case PAD_RUNNING: return "Running";
+    case PAD_LOST: return "Lost";
+    case PAD_HUNG_UP: return "Host hung up";
+    case PAD_SEND_FAILED: return "Send failed";
+    case PAD_DONE: return "Done";
+    default: return "Waiting";
+    }
+}
+
+// One simulated JoySender: its connection, frame writer and input, sent for by the send loop with
+// every other pad, and a feedback thread of its own reading the host's replies
+struct SimulatedPad {
+    int index = 0;
+    int mode = 1;
+    int rate = 80;
+    int64_t period = 0;         // us
+    NetworkConnection client;
+    FrameWriter frames;
+    SyntheticInput input;
+    std::thread feedbackThread;
+    std::atomic<int> state{ PAD_WAITING };
+    std::atomic<bool> inConnection{ false };
+    std::atomic<bool> paused{ false };
+    int64_t connectTime = 0;    // us from connecting to the welcome
+
+    // send loop only
+    int64_t nextDue = 0;
+    int64_t firstSend = 0;
+    int64_t lastSend = 0;
+    int64_t lastAlive = 0;
+    uint64_t keepAlives = 0;
+    LatencyHistogram lateness;  // us past each send's due time, the generator falling behind
+    std::atomic<uint64_t> sent{ 0 };
+    // keyframe waiting for the host's ack: seq << 48 | low 48 bits of when it went out, 0 for none
+    std::atomic<uint64_t> pendingKeyframe{ 0 };
+
+    // feedback thread only
+    LatencyHistogram ackRtt;    // keyframe sent to its ack arriving
+    std::atomic<uint64_t> feedback{ 0 };
+    std::atomic<uint32_t> hostRoundTrip{ 0 };   // us, the host's own measure from the LinkReport
+    std::atomic<uint32_t> hostLoss{ 0 };        // 256ths
+
+    // Records why the pad stopped, unless it already had
+    void end(PadState reason) {
+        int running = PAD_RUNNING;
+        state.compare_exchange_strong(running, reason);
+        inConnection = false;
+    }
+};
+
+// Opening message to the host, what JoySender offers on the transport. A fixed rate pad still
+// offers NETJOY_CAP_RATE for the LinkReports, it just never announces a change
+HelloMessage JOYLOAD_HELLO_MESSAGE(const Arguments& args, const SimulatedPad& pad, uint16_t sessionId) {
+    HelloMessage hello{};
+    hello.magic = NETJOY_HELLO_MAGIC;
+    hello.version = args.udp ? NETJOY_PROTOCOL_VERSION : 0;
+    hello.format = static_cast<uint8_t>(pad.mode);
+    hello.rate = static_cast<uint16_t>(pad.rate);
+    hello.capabilities = NETJOY_CAP_BINARY_HELLO | NETJOY_CAP_MULTI_PAD;
+    if (args.udp) hello.capabilities |= NETJOY_CAP_TIMESTAMPS | NETJOY_CAP_DELTA | NETJOY_CAP_BATCHING | NETJOY_CAP_CLOCK | NETJOY_CAP_RATE | NETJOY_CAP_ACKED_SIGNALS;
+    if (args.udp && args.fec) hello.capabilities |= NETJOY_CAP_FEC;
+    if (!args.udp) hello.capabilities |= NETJOY_CAP_STREAM;
+    if (pad.mode == REPORT_FORMAT_DS4) hello.capabilities |= NETJOY_CAP_IMU_DELTA;
+    hello.sessionId = sessionId;
+    hello.fecGroup = static_cast<uint8_t>(args.fec);
+    return hello;
+}
+
+// Sets up the pad's connection and frame writer with what the host agreed to, as JoySender does
+void JOYLOAD_APPLY_HOST_REPLY(SimulatedPad& pad, const char* buffer, int bytesReceived, const Arguments& args) {
+    pad.client.use_acked_signals(false);
+    if (is_welcome_message(buffer, bytesReceived)) {
+        WelcomeMessage welcome;
+        std::memcpy(&welcome, buffer, WELCOME_SIZE);
+        pad.frames.reset((welcome.capabilities & NETJOY_CAP_TIMESTAMPS) ? welcome.version : 0,
+            (welcome.capabilities & NETJOY_CAP_BATCHING) ? args.redundancy : 0,
+            (welcome.capabilities & NETJOY_CAP_FEC) ? welcome.fecGroup : 0);
+        if (!(welcome.capabilities & NETJOY_CAP_DELTA)) pad.frames.delta = false;
+        if (!(welcome.capabilities & NETJOY_CAP_CLOCK)) pad.frames.clock = false;
+        pad.frames.stream = (welcome.capabilities & NETJOY_CAP_STREAM) != 0;
+        pad.frames.imu = (welcome.capabilities & NETJOY_CAP_IMU_DELTA) != 0;
+        pad.client.use_acked_signals((welcome.capabilities & NETJOY_CAP_ACKED_SIGNALS) != 0);
+        return;
+    }
+    int protocol = (bytesReceived > GO_FOR_JOY_SIZE) ? static_cast<uint8_t>(buffer[GO_FOR_JOY_SIZE]) : 0;
+    int fec = (bytesReceived > GO_FOR_JOY_SIZE + 1) ? static_cast<uint8_t>(buffer[GO_FOR_JOY_SIZE + 1]) : 0;
+    pad.frames.reset(protocol, args.redundancy, fec);
+}
+
+// Connects the pad and runs the hello exchange, false when the host could not be reached or did not answer
+bool JOYLOAD_CONNECT(SimulatedPad& pad, const Arguments& args) {
+    const int64_t start = netjoy_clock_us();
+    pad.client = NetworkConnection(args.udp, args.host, args.port);
+    pad.client.set_silence(true);
+    if (pad.client.establish_connection(args.host, args.port) < 1) return false;
+    pad.client.set_client_timeout(NETWORK_TIMEOUT_MILLISECONDS);
+
+    HelloMessage hello = JOYLOAD_HELLO_MESSAGE(args, pad, pad.client.session_id());
+    if (pad.client.send_data(reinterpret_cast<const char*>(&hello), HELLO_SIZE) < 1) return false;
+
+    char reply[MAX_WELCOME_REPLY_SIZE + 8];
+    int bytes = pad.client.receive_data(reply, sizeof(reply));
+    if (bytes < 1) return false;
+    JOYLOAD_APPLY_HOST_REPLY(pad, reply, bytes, args);
+    pad.connectTime = netjoy_clock_us() - start;
+    return true;
+}
+
+// Sends the pad's next report, or a keep-alive while its script has it paused. Returns like send_data (1 when nothing was due)
+int JOYLOAD_SEND_FRAME(SimulatedPad& pad, int64_t elapsed, int64_t now) {
+    const bool paused = pad.input.paused(elapsed);
+    pad.paused = paused;
+    if (paused && UDP_COMMUNICATION) {
+        if (now - pad.lastAlive < JOYLOAD_KEEPALIVE_US) return 1;
+        pad.lastAlive = now;
+        ++pad.keepAlives;
+        pad.client.keep_alive();
+        return 1;
+    }
+
+    char report[MAX_FRAME_PAYLOAD_SIZE];
+    int size = pad.input.fill(report, elapsed, pad.period);
+    int sent;
+    if (pad.frames.stream) {
+        char message[STREAM_HEADER_SIZE + MAX_FRAME_PAYLOAD_SIZE];
+        sent = pad.client.send_data(message, pad.frames.write_stream(message, report, size));
+    }
+    else if (!pad.frames.enabled) {
+        sent = pad.client.send_data(report, size);
+    }
+    else {
+        char packet[MAX_FRAME_PACKET_SIZE];
+        int packetSize = pad.frames.write(packet, report, size);
+        sent = pad.client.send_data(packet, packetSize);
+        if (sent > 0 && pad.frames.parity_size() > 0) pad.client.send_data(pad.frames.parity_packet(), pad.frames.parity_size());
+
+        FrameHeader hdr;
+        std::memcpy(&hdr, packet, FRAME_HEADER_SIZE);
+        if (sent > 0 && (hdr.flags & FRAME_FLAG_KEYFRAME))
+            pad.pendingKeyframe = (static_cast<uint64_t>(hdr.seq) << 48) | (static_cast<uint64_t>(netjoy_clock_us()) & JOYLOAD_STAMP_MASK);
+    }
+    if (sent > 0) {
+        if (pad.sent == 0) pad.firstSend = now;
+        pad.lastSend = now;
+        ++pad.sent;
+    }
+    return sent;
+}
+
+// Reads the keyframe ack, clock stamp and LinkReport out of a feedback reply. An ack of the keyframe
+// still waiting is one round trip sample: sent, received, acknowledged and back
+void JOYLOAD_READ_FEEDBACK(SimulatedPad& pad, const char* buffer, int bytesReceived) {
+    const int64_t now = netjoy_clock_us();
+    ++pad.feedback;
+    if (pad.frames.delta && bytesReceived >= FEEDBACK_ACK_SIZE) {
+        uint16_t keyframeSeq;
+        std::memcpy(&keyframeSeq, buffer + FEEDBACK_DATA_SIZE, sizeof(keyframeSeq));
+        pad.frames.acknowledge(keyframeSeq);
+
+        uint64_t pending = pad.pendingKeyframe;
+        if (pending && static_cast<uint16_t>(pending >> 48) == keyframeSeq && pad.pendingKeyframe.compare_exchange_strong(pending, 0))
+            pad.ackRtt.record((static_cast<uint64_t>(now) - pending) & JOYLOAD_STAMP_MASK);
+    }
+    if (pad.frames.clock && bytesReceived >= FEEDBACK_CLOCK_SIZE) {
+        uint32_t receiverStamp;
+        std::memcpy(&receiverStamp, buffer + FEEDBACK_ACK_SIZE, sizeof(receiverStamp));
+        pad.frames.clock_stamp(receiverStamp, now);
+    }
+    if (bytesReceived >= FEEDBACK_RATE_SIZE) {
+        LinkReport report;
+        std::memcpy(&report, buffer + FEEDBACK_CLOCK_SIZE, LINK_REPORT_SIZE);
+        pad.hostRoundTrip = report.roundTrip * 100u;
+        pad.hostLoss = report.loss;
+    }
+}
+
+// Receives the host's replies for one pad until it stops, then says goodbye if it was still running
+void JOYLOAD_FEEDBACK_THREAD(SimulatedPad* pad) {
+    char buffer[STREAM_BUFFER_SIZE];
+    StreamReader stream;
+    int timeouts = 0;
+    while (pad->inConnection && !APP_KILLED) {
+        bool signal = false;
+        int bytes;
+        if (!pad->frames.stream) {
+            bytes = pad->client.receive_data(buffer, sizeof(buffer));
+            signal = bytes == sizeof(UDPConnection::SIGPacket);
+        }
+        else {
+            StreamReader::Message msg;
+            bytes = 0;
+            while (stream.next(msg)) {
+                if (msg.type != STREAM_FEEDBACK && msg.type != STREAM_SIGNAL) continue;
+                bytes = msg.size < static_cast<int>(sizeof(buffer)) ? msg.size : static_cast<int>(sizeof(buffer));
+                std::memcpy(buffer, msg.data, bytes);
+                signal = msg.type == STREAM_SIGNAL;
+                break;
+            }
+            if (bytes == 0) {
+                if (stream.corrupt()) {
+                    pad->end(PAD_LOST);
+                    break;
+                }
+                if (stream.fill(pad->client) < 1) bytes = -WSAGetLastError();
+                else continue;
+            }
+        }
+
+        if (signal) {
+            if (!pad->client.accept_signal(buffer)) continue;
+            const UDPConnection::SIGPacket* pkt = reinterpret_cast<const UDPConnection::SIGPacket*>(buffer);
+            if (pkt->type == UDPConnection::PACKET_HANGUP) pad->end(PAD_HUNG_UP);
+            continue;
+        }
+        if (bytes < 1) {
+            if (!pad->inConnection) break;
+            // a paused pad sends nothing to answer, the host goes quiet too
+            if (WSAGetLastError() == WSAETIMEDOUT && (pad->paused || ++timeouts <= JOYLOAD_MAX_TIMEOUTS)) continue;
+            pad->end(PAD_LOST);
+            break;
+        }
+        timeouts = 0;
+        JOYLOAD_READ_FEEDBACK(*pad, buffer, bytes);
+    }
+
+    if (pad->state == PAD_RUNNING) {
+        pad->state = PAD_DONE;
+        if (UDP_COMMUNICATION) {
+            pad->client.hang_up();
+        }
+        else if (pad->frames.stream) {
+            UDPConnection::SIGPacket pkt = UDPConnection::make_packet(UDPConnection::PACKET_HANGUP);
+            char message[STREAM_HEADER_SIZE + sizeof(UDPConnection::SIGPacket)];
+            pad->client.send_data(message, write_stream_message(message, STREAM_SIGNAL, (const char*)&pkt, sizeof(pkt)));
+        }
+    }
+}
+
+// Sleeps until the netjoy clock reaches due: a high resolution waitable timer for most of it, then a spin
+void JOYLOAD_SLEEP_UNTIL(HANDLE timer, int64_t due) {
+    int64_t wait = due - netjoy_clock_us() - JOYLOAD_SPIN_US;
+    if (wait > 0) {
+        LARGE_INTEGER when;
+        when.QuadPart = -wait * 10; // relative, 100 ns units
+        if (timer != NULL && SetWaitableTimer(timer, &when, 0, NULL, NULL, FALSE))
+            WaitForSingleObject(timer, INFINITE);
+        else
+            Sleep(static_cast<DWORD>(wait / 1000));
+    }
+    while (netjoy_clock_us() < due) YieldProcessor();
+}
+
+// Sends for every running pad on its own schedule from one thread, so hundreds of pads cost one
+// sleeping thread rather than hundreds of spinning ones. Pads are spread over their frame period
+// unless aligned, a pad that falls a whole period behind picks up from now rather than bursting
+void JOYLOAD_SEND_LOOP(std::vector<std::unique_ptr<SimulatedPad>>& pads, const volatile bool& stop, bool aligned, int64_t runStart) {
+    HANDLE timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    while (!stop && !APP_KILLED) {
+        const int64_t now = netjoy_clock_us();
+        int64_t next = now + 5000;  // pads still connecting are looked for this often
+        for (auto& p : pads) {
+            SimulatedPad& pad = *p;
+            if (!pad.inConnection) continue;
+            if (pad.nextDue == 0) {
+                pad.nextDue = aligned ? now - (now - runStart) % pad.period + pad.period : now + pad.period * pad.index / static_cast<int64_t>(pads.size());
+            }
+            if (pad.nextDue <= now) {
+                pad.lateness.record(now - pad.nextDue);
+                if (JOYLOAD_SEND_FRAME(pad, now - runStart, now) < 1) pad.end(PAD_SEND_FAILED);
+                pad.nextDue += pad.period;
+                if (pad.nextDue <= now) pad.nextDue = now + pad.period;
+            }
+            if (pad.nextDue < next) next = pad.nextDue;
+        }
+        JOYLOAD_SLEEP_UNTIL(timer, next);
+    }
+    if (timer != NULL) CloseHandle(timer);
+}
+
+// Per pad results: the rate achieved against the one asked for, feedback, and the round trips
+void JOYLOAD_PRINT_REPORT(const std::vector<std::unique_ptr<SimulatedPad>>& pads) {
+    char line[256];
+    double totalRate = 0.0, targetRate = 0.0;
+    std::cout << std::endl << " Pad Mode  Target  Achieved      Sent  Alive  Feedback  Connect  Ack RTT p50 / p99 / max      Host RTT Loss  Send late p99  State" << std::endl;
+    for (const auto& p : pads) {
+        const SimulatedPad& pad = *p;
+        const double span = (pad.lastSend - pad.firstSend) / 1000000.0;
+        const double achieved = (pad.sent > 1 && span > 0.0) ? (pad.sent - 1) / span : 0.0;
+        if (pad.state != PAD_FAILED) {
+            totalRate += achieved;
+            targetRate += pad.rate;
+        }
+        char rtt[64] = "n/a";
+        if (pad.ackRtt.count())
+            snprintf(rtt, sizeof(rtt), "%.2f / %.2f / %.2f ms", pad.ackRtt.percentile_ms(50), pad.ackRtt.percentile_ms(99), pad.ackRtt.max_ms());
+        snprintf(line, sizeof(line), "%4d %-4s %7d %9.1f %9llu %6llu %9llu %6.1fms  %-28s %6.2fms %3.0f%%  %9.2f ms  %s",
+            pad.index + 1, pad.mode == REPORT_FORMAT_DS4 ? "DS4" : "XBOX", pad.rate, achieved,
+            static_cast<unsigned long long>(pad.sent), static_cast<unsigned long long>(pad.keepAlives),
+            static_cast<unsigned long long>(pad.feedback), pad.connectTime / 1000.0, rtt,
+            pad.hostRoundTrip / 1000.0, pad.hostLoss * 100.0 / 256.0, pad.lateness.percentile_ms(99), JOYLOAD_STATE_NAME(pad.state));
+        std::cout << line << std::endl;
+    }
+    snprintf(line, sizeof(line), "Total %.1f of %.1f reports per second", totalRate, targetRate);
+    std::cout << line << std::endl;
+}
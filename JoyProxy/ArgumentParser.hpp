@@ -0,0 +1,155 @@
+/*
+
+Copyright (c) 2025 Dave Quinn <qcent@yahoo.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+
+#include <iostream>
+#include <string>
+#include <cstdio>
+#include "cxxopts.hpp"
+#include "Impairment.hpp"
+
+struct Arguments {
+    int port = 5001;
+    std::string host = "127.0.0.1";
+    int targetPort = 5000;
+    bool tcp = false;
+    int direction = 3;          // 1 sender to receiver, 2 receiver to sender, 3 both
+    uint64_t seed = 1;
+    std::string log;
+    ImpairmentProfile profile;
+};
+
+// "p,r[,lossGood,lossBad]"
+static bool parse_gilbert(const std::string& text, ImpairmentProfile& profile) {
+    double v[4] = { 0.0, 0.0, profile.lossGood, profile.lossBad };
+    int n = sscanf(text.c_str(), "%lf,%lf,%lf,%lf", &v[0], &v[1], &v[2], &v[3]);
+    if (n < 2) return false;
+    profile.gilbert = true;
+    profile.goodToBad = v[0];
+    profile.badToGood = v[1];
+    profile.lossGood = v[2];
+    profile.lossBad = n < 4 ? 1.0 : v[3];
+    return true;
+}
+
+Arguments parse_arguments(int argc, char* argv[]) {
+    Arguments args;
+    cxxopts::Options options("JoyProxy", "Relay NetJoy traffic on loopback with seeded loss, delay, reordering and rate limits");
+    options.allow_unrecognised_options();
+    options.add_options()
+        ("p,port", "Port to listen on", cxxopts::value<int>()->default_value("5001"))
+        ("target", "Where to relay to, host:port of the receiver", cxxopts::value<std::string>()->default_value("127.0.0.1:5000"))
+        ("t,tcp", "Relay TCP instead of UDP (delay and rate only)", cxxopts::value<bool>()->implicit_value("true"))
+        ("profile", "Start from a preset: clean, lan, wifi, bad-wifi, hotspot", cxxopts::value<std::string>()->default_value("clean"))
+        ("loss", "Bernoulli loss in percent", cxxopts::value<double>())
+        ("ge", "Gilbert-Elliott loss: p,r[,lossGood,lossBad] as chances 0-1 per packet", cxxopts::value<std::string>())
+        ("delay", "One way delay in ms", cxxopts::value<double>())
+        ("jitter", "Delay spread in ms", cxxopts::value<double>())
+        ("dist", "Delay distribution: fixed, uniform, normal, pareto", cxxopts::value<std::string>())
+        ("reorder", "Percent of packets held back behind later ones", cxxopts::value<double>())
+        ("reorder-window", "Hold reordered packets behind up to this many later ones", cxxopts::value<int>())
+        ("dup", "Percent of packets delivered twice", cxxopts::value<double>())
+        ("rate", "Bottleneck rate in kbit/s, 0 for none", cxxopts::value<int>())
+        ("queue", "Bottleneck queue in bytes", cxxopts::value<int>())
+        ("d,direction", "Impair up (sender to receiver), down or both", cxxopts::value<std::string>()->default_value("both"))
+        ("seed", "Seed for every random decision, the same seed replays the same fates", cxxopts::value<uint64_t>()->default_value("1"))
+        ("log", "Write the fate of every packet to this CSV file", cxxopts::value<std::string>()->default_value(""))
+        ("h,help", "Display this help message");
+
+    options.parse_positional("port");
+
+    auto result = options.parse(argc, argv);
+
+    if (result.count("help")) {
+        std::cout << options.help() << std::endl;
+        exit(0);
+    }
+
+    if (result.unmatched().size()) {
+        std::cout << "Illegal argument" << std::endl;
+        std::cout << options.help() << std::endl;
+        exit(0);
+    }
+
+    args.port = result["port"].as<int>();
+    args.tcp = result["tcp"].as<bool>();
+    args.seed = result["seed"].as<uint64_t>();
+    args.log = result["log"].as<std::string>();
+
+    std::string target = result["target"].as<std::string>();
+    size_t colon = target.rfind(':');
+    if (colon == std::string::npos) {
+        args.targetPort = std::stoi(target);
+    }
+    else {
+        if (colon) args.host = target.substr(0, colon);
+        args.targetPort = std::stoi(target.substr(colon + 1));
+    }
+
+    std::string direction = result["direction"].as<std::string>();
+    if (direction == "up") args.direction = 1;
+    else if (direction == "down") args.direction = 2;
+    else if (direction == "both") args.direction = 3;
+    else {
+        std::cout << "Unknown direction: " << direction << std::endl;
+        exit(0);
+    }
+
+    ImpairmentProfile& p = args.profile;
+    if (!impairment_preset(result["profile"].as<std::string>(), p)) {
+        std::cout << "Unknown profile: " << result["profile"].as<std::string>() << std::endl;
+        exit(0);
+    }
+    if (result.count("loss")) {
+        p.gilbert = false;
+        p.loss = result["loss"].as<double>() / 100.0;
+    }
+    if (result.count("ge") && !parse_gilbert(result["ge"].as<std::string>(), p)) {
+        std::cout << "--ge takes p,r[,lossGood,lossBad]" << std::endl;
+        exit(0);
+    }
+    if (result.count("delay")) p.delayMs = result["delay"].as<double>();
+    if (result.count("jitter")) {
+        p.jitterMs = result["jitter"].as<double>();
+        if (p.distribution == ImpairmentProfile::FIXED) p.distribution = ImpairmentProfile::UNIFORM;
+    }
+    if (result.count("dist")) {
+        std::string dist = result["dist"].as<std::string>();
+        if (dist == "fixed") p.distribution = ImpairmentProfile::FIXED;
+        else if (dist == "uniform") p.distribution = ImpairmentProfile::UNIFORM;
+        else if (dist == "normal") p.distribution = ImpairmentProfile::NORMAL;
+        else if (dist == "pareto") p.distribution = ImpairmentProfile::PARETO;
+        else {
+            std::cout << "Unknown distribution: " << dist << std::endl;
+            exit(0);
+        }
+    }
+    if (result.count("reorder")) p.reorder = result["reorder"].as<double>() / 100.0;
+    if (result.count("reorder-window")) p.reorderWindow = result["reorder-window"].as<int>();
+    if (p.reorderWindow < 1) p.reorderWindow = 1;
+    if (result.count("dup")) p.duplicate = result["dup"].as<double>() / 100.0;
+    if (result.count("rate")) p.rateKbps = result["rate"].as<int>();
+    if (p.rateKbps < 0) p.rateKbps = 0;
+    if (result.count("queue")) p.queueBytes = result["queue"].as<int>();
+    return args;
+}
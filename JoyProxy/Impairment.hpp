@@ -0,0 +1,287 @@
+/*
+Copyright (c) 2025 Dave Quinn <qcent@yahoo.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+// What JoyProxy does to the packets going one way. Every decision comes from a seeded generator
+// and the order packets arrive in, so a run with the same seed and traffic meets the same fates
+struct ImpairmentProfile {
+    enum Distribution { FIXED, UNIFORM, NORMAL, PARETO };
+
+    double loss = 0.0;          // Bernoulli loss, chance per packet
+    bool gilbert = false;       // Gilbert-Elliott loss instead: bursts in a bad state
+    double goodToBad = 0.0;     // chance per packet of the good state turning bad
+    double badToGood = 1.0;     // chance per packet of the bad state clearing
+    double lossGood = 0.0;      // loss while good
+    double lossBad = 1.0;       // loss while bad
+    Distribution distribution = FIXED;
+    double delayMs = 0.0;       // one way delay
+    double jitterMs = 0.0;      // spread of the delay (uniform: +-, normal: sd, pareto: mean of the tail)
+    double reorder = 0.0;       // chance a packet is held back behind later ones
+    int reorderWindow = 3;      // held behind 1 to this many later packets
+    double duplicate = 0.0;     // chance a packet is delivered twice
+    int rateKbps = 0;           // bottleneck rate, 0 for none
+    int queueBytes = 65536;     // bottleneck queue, packets that do not fit are dropped
+};
+
+// Named starting points for --profile, options given with it override its values
+inline bool impairment_preset(const std::string& name, ImpairmentProfile& p) {
+    p = ImpairmentProfile();
+    if (name == "clean") return true;
+    if (name == "lan") {
+        p.distribution = ImpairmentProfile::NORMAL;
+        p.delayMs = 0.3;
+        p.jitterMs = 0.1;
+        return true;
+    }
+    if (name == "wifi") {
+        p.gilbert = true;
+        p.goodToBad = 0.01;
+        p.badToGood = 0.3;
+        p.lossBad = 0.5;
+        p.distribution = ImpairmentProfile::PARETO;
+        p.delayMs = 2.0;
+        p.jitterMs = 2.0;
+        p.reorder = 0.002;
+        p.duplicate = 0.001;
+        return true;
+    }
+    if (name == "bad-wifi") {
+        p.gilbert = true;
+        p.goodToBad = 0.03;
+        p.badToGood = 0.2;
+        p.lossBad = 0.7;
+        p.distribution = ImpairmentProfile::PARETO;
+        p.delayMs = 5.0;
+        p.jitterMs = 12.0;
+        p.reorder = 0.01;
+        p.reorderWindow = 4;
+        p.duplicate = 0.005;
+        return true;
+    }
+    if (name == "hotspot") {
+        p.gilbert = true;
+        p.goodToBad = 0.01;
+        p.badToGood = 0.25;
+        p.lossBad = 0.6;
+        p.distribution = ImpairmentProfile::NORMAL;
+        p.delayMs = 40.0;
+        p.jitterMs = 15.0;
+        p.rateKbps = 1000;
+        p.queueBytes = 32768;
+        return true;
+    }
+    return false;
+}
+
+// Fate of a packet, as logged
+enum PacketFate { FATE_SENT, FATE_LOST, FATE_QUEUE_DROP };
+
+inline const char* fate_name(PacketFate fate) {
+    switch (fate) {
+    case FATE_LOST: return "lost";
+    case FATE_QUEUE_DROP: return "queue_drop";
+    default: return "sent";
+    }
+}
+
+// One direction through the proxy: loss, then the bottleneck queue, then delay. Packets leave in
+// the order they came unless picked for reordering, a reordered packet is held until 1 to
+// reorderWindow later packets have left (or REORDER_TIMEOUT_US passed)
+class ImpairedLink {
+public:
+    static constexpr int64_t REORDER_TIMEOUT_US = 100000;
+
+    struct Packet {
+        int64_t due = 0;        // us, when it leaves
+        int64_t arrival = 0;    // us
+        uint64_t id = 0;        // arrival count on this link
+        uint64_t order = 0;     // tie break, keeps equal due times in arrival order
+        int flow = 0;
+        int holdBehind = 0;     // later packets still to leave first, reordered packets only
+        bool reordered = false;
+        bool duplicate = false;
+        std::vector<char> data;
+    };
+
+    // Counters for output
+    uint64_t arrived = 0;
+    uint64_t sent = 0;
+    uint64_t lost = 0;
+    uint64_t queueDrops = 0;
+    uint64_t duplicated = 0;
+    uint64_t reordered = 0;
+
+private:
+    ImpairmentProfile profile;
+    bool lossless = false;      // a TCP byte stream: delay and rate only, in order
+    uint64_t state;             // xorshift64* generator
+    bool bad = false;           // Gilbert-Elliott state
+    int64_t linkFree = 0;       // us, when the bottleneck has sent everything queued
+    int64_t lastDue = 0;        // us, keeps the order through random delays
+    uint64_t orders = 0;
+    std::vector<Packet> queue;  // min heap on due, order
+    std::vector<Packet> held;   // reordered packets
+
+    static bool later(const Packet& a, const Packet& b) {
+        return a.due != b.due ? a.due > b.due : a.order > b.order;
+    }
+
+    // Uniform in [0, 1), the same sequence on every platform for a seed
+    double uniform() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return ((state * 0x2545F4914F6CDD1DULL) >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    bool chance(double p) { return p > 0.0 && uniform() < p; }
+
+    bool drop() {
+        if (!profile.gilbert) return chance(profile.loss);
+        bad = bad ? !chance(profile.badToGood) : chance(profile.goodToBad);
+        return chance(bad ? profile.lossBad : profile.lossGood);
+    }
+
+    int64_t sample_delay_us() {
+        const double delay = profile.delayMs * 1000.0;
+        const double jitter = profile.jitterMs * 1000.0;
+        double d = delay;
+        switch (profile.distribution) {
+        case ImpairmentProfile::UNIFORM:
+            d = delay + (uniform() * 2.0 - 1.0) * jitter;
+            break;
+        case ImpairmentProfile::NORMAL: {
+            // Box-Muller
+            double u = 1.0 - uniform();
+            d = delay + jitter * std::sqrt(-2.0 * std::log(u)) * std::cos(6.283185307179586 * uniform());
+            break;
+        }
+        case ImpairmentProfile::PARETO: {
+            // heavy tail above delay with mean jitter (shape 3)
+            const double shape = 3.0;
+            double u = 1.0 - uniform();
+            d = delay + jitter * (shape - 1.0) / shape / std::pow(u, 1.0 / shape);
+            break;
+        }
+        default:
+            break;
+        }
+        return d > 0.0 ? static_cast<int64_t>(d) : 0;
+    }
+
+    void schedule(Packet&& p) {
+        if (p.reordered) {
+            held.push_back(std::move(p));
+            return;
+        }
+        queue.push_back(std::move(p));
+        std::push_heap(queue.begin(), queue.end(), later);
+    }
+
+public:
+    ImpairedLink(const ImpairmentProfile& impairment, uint64_t seed, bool stream = false)
+        : profile(impairment), lossless(stream), state(seed * 0x9E3779B97F4A7C15ULL + 1) {}
+
+    // Decides what happens to a packet that arrived at now, queueing what is delivered. Returns
+    // FATE_SENT when it will leave (see pop_due), or why it never will
+    PacketFate admit(int flow, const char* data, int size, int64_t now) {
+        const uint64_t id = arrived++;
+        if (!lossless && drop()) {
+            ++lost;
+            return FATE_LOST;
+        }
+
+        // the bottleneck: what is queued ahead has to leave first
+        int64_t leaves = now;
+        if (profile.rateKbps > 0) {
+            int64_t backlog = linkFree > now ? (linkFree - now) * profile.rateKbps / 8000 : 0;
+            if (!lossless && backlog + size > profile.queueBytes) {
+                ++queueDrops;
+                return FATE_QUEUE_DROP;
+            }
+            leaves = (linkFree > now ? linkFree : now) + static_cast<int64_t>(size) * 8000 / profile.rateKbps;
+            linkFree = leaves;
+        }
+
+        const int copies = (!lossless && chance(profile.duplicate)) ? 2 : 1;
+        for (int c = 0; c < copies; ++c) {
+            Packet p;
+            p.arrival = now;
+            p.id = id;
+            p.order = orders++;
+            p.flow = flow;
+            p.duplicate = c > 0;
+            p.data.assign(data, data + size);
+            p.due = leaves + sample_delay_us();
+            if (p.due < lastDue) p.due = lastDue;
+            lastDue = p.due;
+            if (!lossless && chance(profile.reorder)) {
+                p.reordered = true;
+                p.holdBehind = 1 + static_cast<int>(uniform() * profile.reorderWindow);
+                p.due += REORDER_TIMEOUT_US;
+                ++reordered;
+            }
+            if (p.duplicate) ++duplicated;
+            schedule(std::move(p));
+        }
+        return FATE_SENT;
+    }
+
+    // Microseconds until the next packet leaves, -1 when none are waiting
+    int64_t time_until_next(int64_t now) const {
+        int64_t next = -1;
+        if (!queue.empty()) next = queue.front().due;
+        for (const Packet& p : held) {
+            int64_t due = p.holdBehind <= 0 ? now : p.due;
+            if (next < 0 || due < next) next = due;
+        }
+        if (next < 0) return -1;
+        return next > now ? next - now : 0;
+    }
+
+    // Takes the next packet due by now, false when none is
+    bool pop_due(int64_t now, Packet& out) {
+        for (size_t i = 0; i < held.size(); ++i) {
+            if (held[i].holdBehind <= 0 || held[i].due <= now) {
+                out = std::move(held[i]);
+                held.erase(held.begin() + i);
+                ++sent;
+                return true;
+            }
+        }
+        if (queue.empty() || queue.front().due > now) return false;
+        std::pop_heap(queue.begin(), queue.end(), later);
+        out = std::move(queue.back());
+        queue.pop_back();
+        for (Packet& h : held) --h.holdBehind;
+        ++sent;
+        return true;
+    }
+};
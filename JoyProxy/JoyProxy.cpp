@@ -0,0 +1,316 @@
+/*
+
+Copyright (c) 2025 Dave Quinn <qcent@yahoo.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+
+// JoyProxy sits between JoySender and JoyReceiver on one machine and does to their packets what a
+// poor network would, the same way every run for a given --seed
+
+#include "ArgumentParser.hpp"
+#include <chrono>
+#include <csignal>
+#include <map>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+typedef int socklen_t;
+#else
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <unistd.h>
+typedef int SOCKET;
+#define INVALID_SOCKET (-1)
+#define SOCKET_ERROR (-1)
+#define closesocket close
+#endif
+
+#define JOYPROXY_UDP_IDLE_US 30000000LL  // forget a UDP sender after this long without a packet
+#define JOYPROXY_BUFFER_SIZE 65536
+
+struct ProxyFlow {
+    SOCKET client = INVALID_SOCKET;     // TCP only, UDP clients share the listen socket
+    SOCKET upstream = INVALID_SOCKET;   // connected to the target
+    sockaddr_in address{};              // the sender
+    int64_t lastSeen = 0;
+};
+
+static volatile std::sig_atomic_t stopRequested = 0;
+
+static void signalHandler(int) {
+    stopRequested = 1;
+}
+
+static int64_t now_us() {
+    static const auto start = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool resolve_target(const std::string& host, int port, sockaddr_in& out) {
+    addrinfo hints{};
+    hints.ai_family = AF_INET;
+    addrinfo* found = nullptr;
+    if (getaddrinfo(host.c_str(), nullptr, &hints, &found) != 0 || !found) return false;
+    out = *reinterpret_cast<sockaddr_in*>(found->ai_addr);
+    out.sin_port = htons(static_cast<unsigned short>(port));
+    freeaddrinfo(found);
+    return true;
+}
+
+static void log_fate(FILE* log, int64_t now, const char* dir, int flow, uint64_t id, size_t size,
+    PacketFate fate, int64_t delay, bool reordered, bool duplicate) {
+    if (!log) return;
+    fprintf(log, "%lld,%s,%d,%llu,%zu,%s,%lld,%d,%d\n", static_cast<long long>(now), dir, flow,
+        static_cast<unsigned long long>(id), size, fate_name(fate), static_cast<long long>(delay),
+        reordered ? 1 : 0, duplicate ? 1 : 0);
+}
+
+static void print_link(const char* dir, const ImpairedLink& link) {
+    double base = link.arrived ? 100.0 / link.arrived : 0.0;
+    printf("%-4s %llu in, %llu out, %llu lost (%.2f%%), %llu queue drops (%.2f%%), %llu reordered, %llu duplicated\n",
+        dir, static_cast<unsigned long long>(link.arrived), static_cast<unsigned long long>(link.sent),
+        static_cast<unsigned long long>(link.lost), link.lost * base,
+        static_cast<unsigned long long>(link.queueDrops), link.queueDrops * base,
+        static_cast<unsigned long long>(link.reordered), static_cast<unsigned long long>(link.duplicated));
+}
+
+static void close_flow(ProxyFlow& flow) {
+    if (flow.client != INVALID_SOCKET) closesocket(flow.client);
+    if (flow.upstream != INVALID_SOCKET) closesocket(flow.upstream);
+    flow.client = flow.upstream = INVALID_SOCKET;
+}
+
+static bool send_all(SOCKET s, const char* data, int size) {
+    while (size > 0) {
+        int sent = send(s, data, size, 0);
+        if (sent <= 0) return false;
+        data += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    Arguments args = parse_arguments(argc, argv);
+
+#ifdef _WIN32
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        std::cerr << "WSAStartup failed" << std::endl;
+        return 1;
+    }
+#endif
+
+    sockaddr_in target{};
+    if (!resolve_target(args.host, args.targetPort, target)) {
+        std::cerr << "Cannot resolve " << args.host << std::endl;
+        return 1;
+    }
+
+    SOCKET listener = socket(AF_INET, args.tcp ? SOCK_STREAM : SOCK_DGRAM, 0);
+    sockaddr_in local{};
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons(static_cast<unsigned short>(args.port));
+    int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+    if (listener == INVALID_SOCKET || bind(listener, reinterpret_cast<sockaddr*>(&local), sizeof(local)) == SOCKET_ERROR
+        || (args.tcp && listen(listener, 4) == SOCKET_ERROR)) {
+        std::cerr << "Cannot listen on port " << args.port << std::endl;
+        return 1;
+    }
+
+    // each direction draws from its own generator so traffic one way never shifts the fates the other way
+    const ImpairmentProfile clean;
+    ImpairedLink up((args.direction & 1) ? args.profile : clean, args.seed, args.tcp);
+    ImpairedLink down((args.direction & 2) ? args.profile : clean, args.seed ^ 0xD0D0D0D0ULL, args.tcp);
+
+    FILE* log = nullptr;
+    if (!args.log.empty()) {
+        log = fopen(args.log.c_str(), "w");
+        if (!log) {
+            std::cerr << "Cannot write " << args.log << std::endl;
+            return 1;
+        }
+        fprintf(log, "time_us,dir,flow,id,size,fate,delay_us,reordered,duplicate\n");
+    }
+
+    std::cout << "JoyProxy " << (args.tcp ? "TCP" : "UDP") << " :" << args.port << " -> " << args.host << ":" << args.targetPort
+        << "  seed " << args.seed << std::endl;
+    std::signal(SIGINT, signalHandler);
+
+    std::map<int, ProxyFlow> flows;
+    std::map<uint64_t, int> flowByAddress;   // UDP senders by ip:port
+    int nextFlow = 0;
+    char buffer[JOYPROXY_BUFFER_SIZE];
+    ImpairedLink::Packet packet;
+
+    while (!stopRequested) {
+        int64_t now = now_us();
+
+        // deliver whatever is due
+        while (up.pop_due(now, packet)) {
+            auto it = flows.find(packet.flow);
+            if (it != flows.end()) {
+                if (!send_all(it->second.upstream, packet.data.data(), static_cast<int>(packet.data.size())) && args.tcp)
+                    close_flow(it->second);
+            }
+            log_fate(log, now, "up", packet.flow, packet.id, packet.data.size(), FATE_SENT, now - packet.arrival, packet.reordered, packet.duplicate);
+        }
+        while (down.pop_due(now, packet)) {
+            auto it = flows.find(packet.flow);
+            if (it != flows.end()) {
+                if (args.tcp) {
+                    if (!send_all(it->second.client, packet.data.data(), static_cast<int>(packet.data.size())))
+                        close_flow(it->second);
+                }
+                else {
+                    sendto(listener, packet.data.data(), static_cast<int>(packet.data.size()), 0,
+                        reinterpret_cast<sockaddr*>(&it->second.address), sizeof(it->second.address));
+                }
+            }
+            log_fate(log, now, "down", packet.flow, packet.id, packet.data.size(), FATE_SENT, now - packet.arrival, packet.reordered, packet.duplicate);
+        }
+
+        // drop closed and idle flows
+        for (auto it = flows.begin(); it != flows.end();) {
+            ProxyFlow& f = it->second;
+            bool idle = !args.tcp && now - f.lastSeen > JOYPROXY_UDP_IDLE_US;
+            if (f.upstream == INVALID_SOCKET || idle) {
+                close_flow(f);
+                flowByAddress.erase((static_cast<uint64_t>(f.address.sin_addr.s_addr) << 16) | f.address.sin_port);
+                std::cout << "Flow " << it->first << " closed" << std::endl;
+                it = flows.erase(it);
+            }
+            else ++it;
+        }
+
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(listener, &readable);
+        SOCKET highest = listener;
+        for (auto& entry : flows) {
+            FD_SET(entry.second.upstream, &readable);
+            if (entry.second.upstream > highest) highest = entry.second.upstream;
+            if (entry.second.client != INVALID_SOCKET) {
+                FD_SET(entry.second.client, &readable);
+                if (entry.second.client > highest) highest = entry.second.client;
+            }
+        }
+
+        int64_t wait = 100000;
+        int64_t nextUp = up.time_until_next(now), nextDown = down.time_until_next(now);
+        if (nextUp >= 0 && nextUp < wait) wait = nextUp;
+        if (nextDown >= 0 && nextDown < wait) wait = nextDown;
+        timeval timeout{ static_cast<long>(wait / 1000000), static_cast<long>(wait % 1000000) };
+        if (select(static_cast<int>(highest + 1), &readable, nullptr, nullptr, &timeout) <= 0) continue;
+        now = now_us();
+
+        if (FD_ISSET(listener, &readable)) {
+            if (args.tcp) {
+                ProxyFlow f;
+                socklen_t len = sizeof(f.address);
+                f.client = accept(listener, reinterpret_cast<sockaddr*>(&f.address), &len);
+                if (f.client != INVALID_SOCKET) {
+                    f.upstream = socket(AF_INET, SOCK_STREAM, 0);
+                    if (connect(f.upstream, reinterpret_cast<sockaddr*>(&target), sizeof(target)) == SOCKET_ERROR) {
+                        std::cout << "Cannot reach " << args.host << ":" << args.targetPort << std::endl;
+                        close_flow(f);
+                    }
+                    else {
+                        int noDelay = 1;
+                        setsockopt(f.client, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+                        setsockopt(f.upstream, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+                        f.lastSeen = now;
+                        std::cout << "Flow " << nextFlow << " from " << inet_ntoa(f.address.sin_addr) << ":" << ntohs(f.address.sin_port) << std::endl;
+                        flows[nextFlow++] = f;
+                    }
+                }
+            }
+            else {
+                sockaddr_in from{};
+                socklen_t len = sizeof(from);
+                int size = recvfrom(listener, buffer, sizeof(buffer), 0, reinterpret_cast<sockaddr*>(&from), &len);
+                if (size > 0) {
+                    uint64_t key = (static_cast<uint64_t>(from.sin_addr.s_addr) << 16) | from.sin_port;
+                    auto known = flowByAddress.find(key);
+                    int id;
+                    if (known == flowByAddress.end()) {
+                        ProxyFlow f;
+                        f.address = from;
+                        f.upstream = socket(AF_INET, SOCK_DGRAM, 0);
+                        connect(f.upstream, reinterpret_cast<sockaddr*>(&target), sizeof(target));
+                        id = nextFlow++;
+                        flows[id] = f;
+                        flowByAddress[key] = id;
+                        std::cout << "Flow " << id << " from " << inet_ntoa(from.sin_addr) << ":" << ntohs(from.sin_port) << std::endl;
+                    }
+                    else id = known->second;
+                    flows[id].lastSeen = now;
+                    uint64_t packetId = up.arrived;
+                    PacketFate fate = up.admit(id, buffer, size, now);
+                    if (fate != FATE_SENT) log_fate(log, now, "up", id, packetId, size, fate, 0, false, false);
+                }
+            }
+        }
+
+        for (auto& entry : flows) {
+            ProxyFlow& f = entry.second;
+            if (f.upstream == INVALID_SOCKET) continue;
+            if (f.client != INVALID_SOCKET && FD_ISSET(f.client, &readable)) {
+                int size = recv(f.client, buffer, sizeof(buffer), 0);
+                if (size <= 0) {
+                    close_flow(f);
+                    continue;
+                }
+                up.admit(entry.first, buffer, size, now);
+            }
+            if (FD_ISSET(f.upstream, &readable)) {
+                int size = recv(f.upstream, buffer, sizeof(buffer), 0);
+                if (size <= 0) {
+                    // a UDP error is the receiver not listening yet, keep the flow
+                    if (args.tcp) close_flow(f);
+                    continue;
+                }
+                uint64_t packetId = down.arrived;
+                PacketFate fate = down.admit(entry.first, buffer, size, now);
+                if (fate != FATE_SENT) log_fate(log, now, "down", entry.first, packetId, size, fate, 0, false, false);
+            }
+        }
+    }
+
+    std::cout << std::endl;
+    print_link("up", up);
+    print_link("down", down);
+    for (auto& entry : flows) close_flow(entry.second);
+    closesocket(listener);
+    if (log) fclose(log);
+#ifdef _WIN32
+    WSACleanup();
+#endif
+    return 0;
+}
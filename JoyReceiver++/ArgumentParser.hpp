@@ -30,8 +30,17 @@ struct Arguments {
     int port = 5000;
     bool tcp = false;
     bool udp = false;
+    int jitter = 30;
+    std::string stats;
+    int grace = 5000;
+    int pool = 0;
+    int predict = 0;
 #ifndef NetJoyTUI
     bool latency = true;
+    int clients = 1;
+    bool applyThread = false;
+    int netCpu = -1;
+    int applyCpu = -1;
 #endif
 };
 
@@ -47,8 +56,17 @@ Arguments parse_arguments(int argc, char* argv[]) {
         ("p,port", "Port to run on", cxxopts::value<int>()->default_value("5000"))
         ("t,tcp", "Use TCP protocol", cxxopts::value<bool>()->implicit_value("true"))
         ("u,udp", "Use UDP protocol", cxxopts::value<bool>()->implicit_value("true"))
+        ("j,jitter", "Max jitter buffer depth in ms (UDP), 0 applies input on arrival", cxxopts::value<int>()->default_value("30"))
+        ("s,stats", "Append latency histograms of each connection to this file on disconnect", cxxopts::value<std::string>()->default_value(""))
+        ("g,grace", "Keep the virtual pad of a dropped connection plugged in this many ms for its sender to resume, 0 unplugs at once", cxxopts::value<int>()->default_value("5000"))
+        ("pool", "Keep this many XBOX and DS4 virtual pads plugged in, ready for connections", cxxopts::value<int>()->default_value("0"))
+        ("predict", "Extrapolate sticks, triggers and motion for up to this many ms while UDP frames are missing, 0 holds the last report", cxxopts::value<int>()->default_value("0"))
 #ifndef NetJoyTUI
         ("l,latency", "Show latency output", cxxopts::value<bool>()->implicit_value("true"))
+        ("c,clients", "Serve up to N senders on one port, each with its own virtual pad (UDP, 1-16)", cxxopts::value<int>()->default_value("1"))
+        ("a,apply-thread", "Update the virtual pad on its own thread, apart from the network thread", cxxopts::value<bool>()->implicit_value("true"))
+        ("net-cpu", "Pin the network thread to this CPU", cxxopts::value<int>()->default_value("-1"))
+        ("apply-cpu", "Pin the apply thread (-a) to this CPU", cxxopts::value<int>()->default_value("-1"))
 #endif
         ("h,help", "Display this help message");
 
@@ -71,8 +89,20 @@ Arguments parse_arguments(int argc, char* argv[]) {
     args.udp = result["udp"].as<bool>();
     args.tcp = result["tcp"].as<bool>();
     args.udp = args.tcp ? false : true;
+    args.jitter = result["jitter"].as<int>();
+    args.stats = result["stats"].as<std::string>();
+    args.grace = result["grace"].as<int>();
+    if (args.grace < 0) args.grace = 0;
+    args.pool = result["pool"].as<int>();
+    if (args.pool < 0) args.pool = 0;
+    args.predict = result["predict"].as<int>();
+    if (args.predict < 0) args.predict = 0;
 #ifndef NetJoyTUI
     args.latency = result["latency"].as<bool>();   
+    args.clients = result["clients"].as<int>();
+    args.applyThread = result["apply-thread"].as<bool>();
+    args.netCpu = result["net-cpu"].as<int>();
+    args.applyCpu = result["apply-cpu"].as<int>();
 #endif
     return args;
 }
\ No newline at end of file
@@ -26,6 +26,7 @@ THE SOFTWARE.
 #include "NetworkCommunication.h"
 #include "FPSCounter.hpp"
 #include "JoyReceiver++.h"
+#include "SessionTable.hpp"
 
 static void overwriteFPS(const std::string& text) {
     // Move the cursor to the beginning of the last line
@@ -77,6 +78,29 @@ int main(int argc, char* argv[]) {
         return 0.0;
     };
 
+    // FPS and latency readout, once per applied report
+    auto show_frame_stats = [&](int rate, double networkMs) {
+        fpsOutput = do_fps_counting(rate);
+        if (!fpsOutput.empty()) {
+            overwriteFPS("FPS: " + fpsOutput);
+        }
+        latencyOutput = do_latency_timing();
+        if (latencyOutput && rate > 0) {
+            std::string netDelay;
+            if (networkMs >= 0)
+                netDelay = "  Network: " + formatDecimalString(std::to_string(networkMs), 5) + " ms";
+            overwriteLatency("Latency: " + formatDecimalString(std::to_string(((latencyOutput * 1000) - 1000.0 / rate) / 2), 5) + " ms" + netDelay + "    ");
+        }
+    };
+    PadApplier applier;
+    // Connect to the first report reaching the pad, which the apply thread updates when there is one
+    auto note_first_frame = [&]() {
+        if (firstFrameAt) return;
+        firstFrameAt = args.applyThread ? applier.first_applied_at() : netjoy_clock_us();
+        if (firstFrameAt) connectTimes.record(resumed, padPool.last_lease_pooled(), firstFrameAt - connectStart);
+    };
+    JOYRECEIVER_PIN_THREAD(args.netCpu);
+
     // Register the signal handler
     std::signal(SIGINT, signalHandler);
 
@@ -86,6 +110,13 @@ int main(int argc, char* argv[]) {
     // Set Up Console
     hideConsoleCursor();
     std::system("cls");
+
+    // Many senders share the port, each on its own virtual pad
+    if (UDP_COMMUNICATION && args.clients > 1) {
+        std::cout << "Serving up to " << args.clients << " Connections on port : " << args.port << " UDP"
+            << "\n\t\t LAN : " << localIP << "\n\t\t WAN : " << externalIP << std::endl;
+        JOYRECEIVER_SERVE_SESSIONS(server, vigemClient, args);
+    }
     ///********************************
     // Make Connection -> Receive Input Loop
     while (!APP_KILLED) {
@@ -104,100 +135,99 @@ int main(int argc, char* argv[]) {
             break;
         }
         
-        JOYRECEIVER_GET_MODE_AND_TIMING_FROM_BUFFER(buffer, bytesReceived, client_timing, op_mode, expectedFrameDelay);
+        JOYRECEIVER_GET_MODE_AND_TIMING_FROM_BUFFER(buffer, bytesReceived, client_timing, op_mode, client_protocol, client_fec, client_caps, expectedFrameDelay);
         if (op_mode == -1) break;
         std::cout << "<< Connection (" << connectionIP << ") Received >> \r\n";
         std::cout << "  Emulating " << ((op_mode == 2) ? "DS4" : "XBOX") << " Controller @ " << client_timing << "fps" << std::endl;
-        JOYRECEIVER_PLUGIN_VIGEM_CONTROLLER();
+        JOYRECEIVER_PLUGIN_OR_RESUME_CONTROLLER();
+        input_receiver.reset(client_protocol, client_fec, client_timing, (client_caps & NETJOY_CAP_STREAM) != 0);
 
         // Send response back to client
-        allGood = server.send_data("Go for Joy!", 12);
+        allGood = JOYRECEIVER_SEND_GO_FOR_JOY(server, client_protocol, client_fec, client_caps, sessionToken, resumed);
         if (allGood < 1) {
             std::cout << "<< Connection (" << connectionIP << ") Failed >>" << std::endl;
             break;
         }
+        std::cout << "  " << (resumed ? "Session resumed" : padPool.last_lease_pooled() ? "Pooled pad leased" : "Pad plugged in") << " in "
+            << formatDecimalString(std::to_string((netjoy_clock_us() - connectStart) / 1000.0), 2) << " ms" << std::endl;
+        if (!resumed) std::cout << "  Pad lease times (mean) : " << padPool.lease_times() << std::endl;
         
         // Prep UI for loop
         std::cout << std::endl << std::endl;
         fps_counter.reset();
         buffer_size = ((op_mode == 2) ? DS4_REPORT_NETWORK_DATA_SIZE : XBOX_REPORT_NETWORK_DATA_SIZE);
 
-        memset(feedBackComp, 0, sizeof(feedBackComp));
-        memset(feedbackData, 0, sizeof(feedbackData));
+        if (!resumed) feedbackState.clear(); // a resumed pad keeps rumbling as the game left it
+        feedbackSent = FeedbackState::generation(feedbackState.load());
+        firstFrameAt = 0;
+        if (args.applyThread) {
+            applier.start(vigemClient, gamepad, op_mode, args.applyCpu, args.latency ? show_frame_stats : std::function<void(int, double)>());
+        }
 
         /* Start Receive Joystick Data Loop */
         while (!APP_KILLED) {
             //*****************************
             // Receive joystick input from client to the buffer
             receive:
-            bytesReceived = server.receive_data(buffer, buffer_size);
+            bytesReceived = input_receiver.receive(buffer, buffer_size);
             if (bytesReceived < 1) {
                 break;
             }
-            if (bytesReceived == sizeof(UDPConnection::SIGPacket)) {
+            JOYRECEIVER_APPLY_CLIENT_RATE(input_receiver, client_timing, expectedFrameDelay);
+            if (input_receiver.signal_received()) {
                 JOYRECEIVER_PROCESS_SIGNAL_PACKET();
             }
-            if (bytesReceived != buffer_size) {
+            if (bytesReceived != buffer_size && !input_receiver.is_streamed()) {
                 JOYRECEIVER_GET_COMPLETE_PACKET();
             }
 
             //******************************
-            // Update virtual gamepad
-            if (op_mode == 2) {
-                // Cast the buffer to an DS4_REPORT_EX pointer
-                ds4_report_ex = *reinterpret_cast<DS4_REPORT_EX*>(buffer);
-                vigem_target_ds4_update_ex(vigemClient, gamepad, ds4_report_ex);
-#if DEVTEST
-                output_extra_ds4_data(ds4_report_ex);
-#endif
+            // Update virtual gamepad, or hand the report to the apply thread
+            const double networkMs = input_receiver.clock_synced() ? input_receiver.one_way_ms() : -1.0;
+            if (args.applyThread) {
+                applier.push(buffer, buffer_size, client_timing, networkMs);
             }
             else {
-                // Cast the buffer to an XUSB_REPORT pointer
-                xbox_report = *reinterpret_cast<XUSB_REPORT*>(buffer);
-                vigem_target_x360_update(vigemClient, gamepad, xbox_report);
+                JOYRECEIVER_UPDATE_PAD(vigemClient, gamepad, op_mode, buffer);
             }
+            note_first_frame();
 
             //*******************************
             // Send response back to client :: Rumble + lightbar data
-            {
-                static int frameCount = 0;
-                lock.lock();
-                // gives at least 5 feedback responses a second to avoid timeouts
-                if (std::memcmp(feedBackComp, feedbackData, sizeof(feedbackData)) != 0 || (frameCount += 5) > client_timing) {
-                    std::memcpy(feedBackComp, feedbackData, sizeof(feedbackData));
-                    frameCount = 0;
-
-                    allGood = server.send_data(feedbackData, sizeof(feedbackData));
-                    if (allGood < 1) {
-                        break;
-                    }
-                }
-                lock.unlock();
+            // on change, or at least 5 times a second to avoid timeouts
+            allGood = JOYRECEIVER_SEND_FEEDBACK(input_receiver, feedbackState, feedbackSent);
+            if (allGood < 1) {
+                break;
             }
 
-            // FPS output
-            if (args.latency) {
-                fpsOutput = do_fps_counting(client_timing);
-                if (!fpsOutput.empty()) {
-                    overwriteFPS("FPS: " + fpsOutput);
-                }
-                latencyOutput = do_latency_timing();
-                if (latencyOutput) {
-                    overwriteLatency("Latency: " + formatDecimalString(std::to_string(((latencyOutput * 1000) - expectedFrameDelay) / 2), 5) + " ms    ");
-                }
+            // FPS output, the apply thread does its own
+            if (args.latency && !args.applyThread) {
+                show_frame_stats(client_timing, networkMs);
             }
         }
         /* End of Receive Joystick Data Loop */
+        applier.stop();
+        if (args.applyThread) note_first_frame(); // one the network thread had not seen yet
         
         if (!APP_KILLED) {
             std::system("cls");
             std::cout << "<< Connection (" << connectionIP << ") Lost >>" << std::endl;
+            if (firstFrameAt)
+                std::cout << "  Connect to first frame : " << formatDecimalString(std::to_string((firstFrameAt - connectStart) / 1000.0), 2) << " ms" << std::endl;
+            std::cout << "  Connect to first frame (mean) : " << connectTimes.summary() << std::endl;
+            std::cout << "  Connect to first frame, new pads (mean) : " << connectTimes.pool_summary() << std::endl;
+            JOYRECEIVER_PRINT_LATENCY_STATS(input_receiver);
+            if (applier.coalesced || applier.dropped)
+                std::cout << "  Apply thread : " << applier.coalesced << " coalesced, " << applier.dropped << " dropped" << std::endl;
         }
+        JOYRECEIVER_DUMP_LATENCY_STATS(args.stats, connectionIP, input_receiver.latency_stats());
 
-        // Unregister rumble notifications // unplug virtual deveice
-        JOYRECEIVER_UNPLUG_VIGEM_CONTROLLER();
+        // Unregister rumble notifications // unplug virtual deveice, or hold it for the sender to resume
+        JOYRECEIVER_HOLD_OR_UNPLUG_CONTROLLER();
+        if (heldPad.is_holding())
+            std::cout << "  Holding the pad " << args.grace << " ms for the sender to resume" << std::endl;
     }
-    if (UDP_COMMUNICATION) server.hang_up();
+    input_receiver.hang_up();
     JOYRECEIVER_SHUTDOWN_VIGEM_BUS();
     swallowInput();
     showConsoleCursor();
@@ -209,6 +239,7 @@ void signalHandler(int signal) {
     if (signal == SIGINT) {
         std::cout << "\r\n<< Exiting >>" << std::endl;
         APP_KILLED = 1;
+        connectionWaiter.cancel();
         Sleep(5);
     }
 }
\ No newline at end of file
@@ -4,6 +4,11 @@
 #include <conio.h>
 #include <thread>
 #include <mutex>
+#include <fstream>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <vector>
 
 #pragma comment(lib, "setupapi.lib")
 #pragma comment(lib, "VIGEmClient.lib")
@@ -11,25 +16,50 @@
 constexpr auto APP_NAME = "NetJoy";
 #define APP_VERSION_NUM     L"3.0.4.0"
 volatile sig_atomic_t APP_KILLED = 0;
-std::mutex mtx;
-char feedbackData[5] = { 0 }; // For sending rumble data back to joySender
 void signalHandler(int signal);
 
+#include "FeedbackState.hpp"
+FeedbackState feedbackState; // rumble + lightbar for joySender, written by the ViGEm feedback thread / callback
+
 #include "utilities.hpp"
+#include "JitterBuffer.hpp"
+#include "FecDecoder.hpp"
+#include "ClockSync.hpp"
+#include "LatencyHistogram.hpp"
+#include "SpscRing.hpp"
+#include "DeadReckoning.hpp"
+
+// Cancelled by the SIGINT handler (or tUI) to cut a connection wait short
+SocketWaiter connectionWaiter;
+constexpr int CONNECTION_WAIT_SLICE_MILLISECONDS = 1000; // backstop for APP_KILLED set elsewhere
+// Unchanged feedback is still sent this often while reports arrive, so the sender does not time out.
+// Timed rather than counted in reports, a send-on-change sender may only send heartbeats
+constexpr int64_t FEEDBACK_KEEPALIVE_US = 200000;
+// Button bytes carried over when stale reports are coalesced: XUSB_REPORT.wButtons, and for a
+// DS4 wButtons above the d-pad hat plus the PS / touchpad click bits of bSpecial
+struct ReportButtonByte { int offset; uint8_t mask; };
+constexpr ReportButtonByte XBOX_BUTTON_BYTES[] = { { 0, 0xFF }, { 1, 0xFF } };
+constexpr ReportButtonByte DS4_BUTTON_BYTES[] = { { 4, 0xF0 }, { 5, 0xFF }, { 6, 0x03 } };
 
 std::thread ds4Rumbler;
-bool ds4ThreadStop = true;
-void ds4RumbleThread(PVIGEM_CLIENT vigemClient, PVIGEM_TARGET gamepad) {
+// Stop flag of the DS4 feedback thread, a new one per plug-in so a thread still waiting on a pad
+// that went back to the pool is not revived by the next connection leasing it. The thread sets
+// exited on its way out, until then the pool keeps the pad from being leased again: the old thread
+// can wait up to 3 s for an output report and would take it from the new one
+struct Ds4ThreadFlag {
+    volatile bool stop = false;
+    std::atomic<bool> exited{ false };
+};
+std::shared_ptr<Ds4ThreadFlag> ds4ThreadStop = std::make_shared<Ds4ThreadFlag>();
+// Publishes DS4 rumble + lightbar output for gamepad to feedback until stop is set
+void ds4RumbleThread(PVIGEM_CLIENT vigemClient, PVIGEM_TARGET gamepad, FeedbackState& feedback, const volatile bool& stop) {
     DS4_OUTPUT_BUFFER buffer;
-    std::unique_lock<std::mutex> lock(mtx, std::defer_lock);
-    while (!APP_KILLED && !ds4ThreadStop) {
+    while (!APP_KILLED && !stop) {
 
         auto vigemErr = vigem_target_ds4_await_output_report_timeout(vigemClient, gamepad, 3000, &buffer);
         if (!VIGEM_SUCCESS(vigemErr) && vigemErr != VIGEM_ERROR_TIMED_OUT) {
             std::cerr << "DS4 Rumble callback failed with error code: 0x" << std::hex << vigemErr << std::endl;
-            lock.lock();
-            std::memset(feedbackData, '\0', sizeof(feedbackData));
-            lock.unlock();
+            feedback.clear();
         }
         else if (vigemErr != VIGEM_ERROR_TIMED_OUT) {
 #if 0 
@@ -45,9 +75,7 @@ void ds4RumbleThread(PVIGEM_CLIENT vigemClient, PVIGEM_TARGET gamepad) {
             displayBytes(buffer.Buffer, 64);
             repositionConsoleCursor(-5, 0);
 #endif
-            lock.lock();
-            std::memcpy(feedbackData, &buffer.Buffer[4], 5 * sizeof(char));
-            lock.unlock();
+            feedback.store(reinterpret_cast<const char*>(&buffer.Buffer[4]));
         }
     }
 }
@@ -66,11 +94,220 @@ xbox_rumble( PVIGEM_CLIENT Client, PVIGEM_TARGET Target,
     std::cout << "SmallMotor:" << (int)SmallMotor << "   " << "   ";
     repositionConsoleCursor(2, 0);
 #endif
-    // Set the UserData with the desired value
-    feedbackData[0] = static_cast<char>(LargeMotor);
-    feedbackData[1] = static_cast<char>(SmallMotor);
+    // Publish the motors to the UserData (the pad's FeedbackState)
+    const char motors[2] = { static_cast<char>(LargeMotor), static_cast<char>(SmallMotor) };
+    static_cast<FeedbackState*>(UserData)->store(motors, 0, sizeof(motors));
+}
+
+// Sticks centred, nothing pressed, for a pad nobody is driving until its next report
+void JOYRECEIVER_NEUTRAL_PAD(PVIGEM_CLIENT vigemClient, PVIGEM_TARGET gamepad, int op_mode) {
+    if (op_mode == 2) {
+        DS4_REPORT neutral;
+        DS4_REPORT_INIT(&neutral);
+        vigem_target_ds4_update(vigemClient, gamepad, neutral);
+    }
+    else {
+        XUSB_REPORT neutral;
+        XUSB_REPORT_INIT(&neutral);
+        vigem_target_x360_update(vigemClient, gamepad, neutral);
+    }
 }
 
+// Virtual pads plugged in ahead of time (--pool) and leased to connections by type, so a connection does
+// not wait on the driver to plug in a device and games do not have to enumerate a new one. A pad given
+// back is reset to neutral and kept for the next lease while its type has room, otherwise unplugged.
+// A DS4 pad is only leased again once its old feedback thread has exited.
+// Used from the thread that handles connections only
+class ControllerPool {
+private:
+    struct IdlePad {
+        PVIGEM_TARGET gamepad;
+        std::shared_ptr<Ds4ThreadFlag> feedbackThread;  // DS4 only, the thread that served it last
+    };
+
+    PVIGEM_CLIENT client = nullptr;
+    int capacity = 0;                       // idle pads kept per type
+    std::vector<IdlePad> idle[2];           // XBOX, DS4
+    bool pooled = false;
+
+    static int kind(int op_mode) { return (op_mode == 2) ? 1 : 0; }
+
+    PVIGEM_TARGET plug_in(int op_mode, VIGEM_ERROR& err) {
+        PVIGEM_TARGET gamepad = (op_mode == 2) ? vigem_target_ds4_alloc() : vigem_target_x360_alloc();
+        /* Add gamepad to the ViGEm client bus, this equals a plug-in event */
+        err = vigem_target_add(client, gamepad);
+        if (!VIGEM_SUCCESS(err)) {
+            vigem_target_free(gamepad);
+            return nullptr;
+        }
+        return gamepad;
+    }
+
+    void unplug(PVIGEM_TARGET gamepad) {
+        /* Free resources(this disconnects the virtual device) */
+        vigem_target_remove(client, gamepad);
+        vigem_target_free(gamepad);
+    }
+
+public:
+    // Plugs in perType pads of each type, the number kept idle from then on
+    void fill(PVIGEM_CLIENT vigemClient, int perType) {
+        client = vigemClient;
+        capacity = perType;
+        for (int op_mode = 1; op_mode <= 2; ++op_mode) {
+            while (static_cast<int>(idle[kind(op_mode)].size()) < capacity) {
+                VIGEM_ERROR err;
+                PVIGEM_TARGET gamepad = plug_in(op_mode, err);
+                if (gamepad == nullptr) {
+                    std::cerr << "Pooling a virtual Gamepad failed with error code: 0x" << std::hex << err << std::dec << std::endl;
+                    return;
+                }
+                idle[kind(op_mode)].push_back({ gamepad, nullptr });
+            }
+        }
+    }
+
+    // Lease times: an idle pad taken from the pool, and one plugged in for want of one
+    LatencyHistogram pooledLeases;
+    LatencyHistogram coldLeases;
+
+    // An idle pad of the op_mode type, else a newly plugged in one. nullptr with err set when ViGEm refuses
+    PVIGEM_TARGET lease(PVIGEM_CLIENT vigemClient, int op_mode, VIGEM_ERROR& err) {
+        const int64_t start = netjoy_clock_us();
+        client = vigemClient;
+        std::vector<IdlePad>& pads = idle[kind(op_mode)];
+        err = VIGEM_ERROR_NONE;
+        // the most recently given back pad whose feedback thread is gone
+        auto ready = pads.rbegin();
+        while (ready != pads.rend() && ready->feedbackThread && !ready->feedbackThread->exited.load()) ++ready;
+        pooled = ready != pads.rend();
+        if (!pooled) {
+            PVIGEM_TARGET gamepad = plug_in(op_mode, err);
+            if (gamepad != nullptr) coldLeases.record(netjoy_clock_us() - start);
+            return gamepad;
+        }
+        PVIGEM_TARGET gamepad = ready->gamepad;
+        pads.erase(std::next(ready).base());
+        pooledLeases.record(netjoy_clock_us() - start);
+        return gamepad;
+    }
+
+    // True when the last lease came from the idle pads
+    bool last_lease_pooled() const { return pooled; }
+
+    // "pooled 0.01 ms (3), plugged in 41.27 ms (2)", the mean lease times so far
+    std::string lease_times() const {
+        return "pooled " + formatDecimalString(std::to_string(pooledLeases.mean_ms()), 2) + " ms (" + std::to_string(pooledLeases.count())
+            + "), plugged in " + formatDecimalString(std::to_string(coldLeases.mean_ms()), 2) + " ms (" + std::to_string(coldLeases.count()) + ")";
+    }
+
+    // Takes back a pad whose feedback is already unregistered (XBOX) or told to stop (DS4, feedbackThread)
+    void give_back(PVIGEM_TARGET gamepad, int op_mode, std::shared_ptr<Ds4ThreadFlag> feedbackThread = nullptr) {
+        std::vector<IdlePad>& pads = idle[kind(op_mode)];
+        if (static_cast<int>(pads.size()) >= capacity) {
+            unplug(gamepad);
+            return;
+        }
+        // the game sees an idle pad until the next lease
+        JOYRECEIVER_NEUTRAL_PAD(client, gamepad, op_mode);
+        pads.push_back({ gamepad, std::move(feedbackThread) });
+    }
+
+    // Unplugs every idle pad, before the bus is disconnected
+    void drain() {
+        for (auto& pads : idle) {
+            for (const IdlePad& pad : pads) unplug(pad.gamepad);
+            pads.clear();
+        }
+    }
+};
+ControllerPool padPool;
+
+// Unregisters the feedback of gamepad and returns it to the pool, which unplugs it when full
+void JOYRECEIVER_UNPLUG_PAD(PVIGEM_CLIENT vigemClient, PVIGEM_TARGET gamepad, int op_mode) {
+    if (gamepad == nullptr) return;
+    if (op_mode == 2) ds4ThreadStop->stop = true;
+    else vigem_target_x360_unregister_notification(gamepad);
+    padPool.give_back(gamepad, op_mode, (op_mode == 2) ? ds4ThreadStop : nullptr);
+}
+
+// Virtual pad of a dropped connection, kept plugged in for the grace period (-g/--grace) so games do
+// not see it unplugged. It is set to neutral while held, so a stick or button down when the link
+// dropped does not stay down. The sender that had it gets it back, feedback and all, when it returns
+// from the same address with the resume token of its welcome (NETJOY_CAP_RESUME) in the same format
+class PadKeeper {
+private:
+    PVIGEM_CLIENT client = nullptr;
+    PVIGEM_TARGET pad = nullptr;
+    int format = 0;
+    uint16_t token = 0;
+    char address[INET_ADDRSTRLEN] = { 0 };
+    int64_t expires = 0;    // us
+
+public:
+    bool is_holding() const { return pad != nullptr; }
+
+    void hold(PVIGEM_CLIENT vigemClient, PVIGEM_TARGET gamepad, int op_mode, uint16_t resumeToken, const char* clientIP, int graceMillisec) {
+        release();
+        client = vigemClient;
+        pad = gamepad;
+        format = op_mode;
+        token = resumeToken;
+        strcpy_s(address, sizeof(address), clientIP);
+        expires = netjoy_clock_us() + graceMillisec * 1000LL;
+        JOYRECEIVER_NEUTRAL_PAD(client, pad, format);
+    }
+
+    // Hands the held pad over when it is this sender's to resume, nullptr otherwise
+    PVIGEM_TARGET resume(uint16_t resumeToken, int op_mode, const char* clientIP) {
+        if (pad == nullptr || resumeToken == 0 || resumeToken != token || op_mode != format) return nullptr;
+        if (std::strcmp(address, clientIP) != 0 || netjoy_clock_us() >= expires) return nullptr;
+        PVIGEM_TARGET resumed = pad;
+        pad = nullptr;
+        return resumed;
+    }
+
+    void release() {
+        if (pad == nullptr) return;
+        JOYRECEIVER_UNPLUG_PAD(client, pad, format);
+        pad = nullptr;
+    }
+
+    // Unplugs the held pad once nobody came back for it
+    void release_expired() {
+        if (pad != nullptr && netjoy_clock_us() >= expires) release();
+    }
+};
+PadKeeper heldPad;
+
+// Connect (poke or SYN) to first applied report, for sessions that resumed a held pad and for new
+// ones, which are also split by whether their pad came from the pool
+struct ConnectTimes {
+    LatencyHistogram resumed;
+    LatencyHistogram fresh;
+    LatencyHistogram pooled;    // new connections split by how their pad was leased
+    LatencyHistogram cold;
+
+    // wasPooled: the pad came from the ControllerPool rather than being plugged in
+    void record(bool wasResumed, bool wasPooled, int64_t microseconds) {
+        (wasResumed ? resumed : fresh).record(microseconds);
+        if (!wasResumed) (wasPooled ? pooled : cold).record(microseconds);
+    }
+
+    // "resumed 4.12 ms (2), new 57.80 ms (5)", the means so far
+    std::string summary() const {
+        return "resumed " + formatDecimalString(std::to_string(resumed.mean_ms()), 2) + " ms (" + std::to_string(resumed.count())
+            + "), new " + formatDecimalString(std::to_string(fresh.mean_ms()), 2) + " ms (" + std::to_string(fresh.count()) + ")";
+    }
+
+    // "pooled 3.05 ms (4), plugged in 61.20 ms (1)", the means of new connections so far
+    std::string pool_summary() const {
+        return "pooled " + formatDecimalString(std::to_string(pooled.mean_ms()), 2) + " ms (" + std::to_string(pooled.count())
+            + "), plugged in " + formatDecimalString(std::to_string(cold.mean_ms()), 2) + " ms (" + std::to_string(cold.count()) + ")";
+    }
+};
+ConnectTimes connectTimes;
+
 // xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx
 // Defined Common Functionality
 #define JOYRECEIVER_INIT_VARIABLES() \
@@ -82,16 +319,24 @@ NetworkConnection server(args.udp, args.port); \
 PVIGEM_TARGET gamepad; \
 XUSB_REPORT xbox_report = {0}; \
 DS4_REPORT_EX ds4_report_ex = {0}; \
+InputReceiver input_receiver(server, args.jitter, args.predict); \
 
-std::unique_lock<std::mutex> lock(mtx, std::defer_lock); \
 int allGood; \
 UINT8 connection_error_count = 0; \
-char feedBackComp[5] = { 0 }; \
-char buffer[64] = { 0 }; \
+uint32_t feedbackSent = 0; \
+char buffer[MAX_DATAGRAM_SIZE] = { 0 }; \
 int buffer_size = sizeof(buffer); \
 int bytesReceived = 0; \
 int op_mode = 0; \
 int client_timing = 0; \
+int client_protocol = 0; \
+int client_fec = 0; \
+uint32_t client_caps = 0; \
+uint16_t sessionToken = 0; \
+bool resumed = false; \
+bool clientHungUp = false; \
+int64_t connectStart = 0; \
+int64_t firstFrameAt = 0; \
 double expectedFrameDelay = 0; \
 std::string externalIP; \
 std::string localIP; \
@@ -109,7 +354,8 @@ auto vigemErr = vigem_connect(vigemClient); \
 if (!VIGEM_SUCCESS(vigemErr)){ \
     std::cerr << "ViGEm Bus connection failed with error code: 0x" << std::hex << vigemErr << std::endl; \
     APP_KILLED = 1; \
-}
+} \
+if (!APP_KILLED) padPool.fill(vigemClient, args.pool);
 
 #define JOYRECEIVER_DETERMINE_IPS_START_SERVER() \
 externalIP = server.get_external_ip(); \
@@ -123,12 +369,20 @@ server.start_as_server(args.port);
     std::pair<SOCKET, sockaddr_in> connectionResult; \
     SOCKET clientSocket; \
     while (!APP_KILLED) { \
+        /* Sleep until a client knocks, Ctrl+C cancels the wait */ \
+        allGood = server.wait_for_connection(connectionWaiter, heldPad.is_holding() ? 100 : CONNECTION_WAIT_SLICE_MILLISECONDS); \
+        if (allGood == 0 || allGood == -WSAECANCELLED) { \
+            heldPad.release_expired(); \
+            continue; \
+        } \
+        /* the poke (or a SYN that beat it) is waiting, the connect time starts here */ \
+        connectStart = netjoy_clock_us(); \
         connectionResult = server.await_connection(); \
         clientSocket = connectionResult.first; \
         if (clientSocket == INVALID_SOCKET) { \
             allGood = WSAGetLastError(); \
             if (allGood == WSAEWOULDBLOCK) { \
-                Sleep(10); \
+                continue; \
             } else if (allGood == WSAEINVAL) { \
                 std::cout << " << Unable to use port : " << args.port << " >>\r\n"; \
                 std::cout << "<< Exiting >>" << std::endl; \
@@ -157,14 +411,69 @@ server.start_as_server(args.port);
     } \
 }
 
-void JOYRECEIVER_GET_MODE_AND_TIMING_FROM_BUFFER(const char* buffer, const int bytesReceived, int& client_timing, int& op_mode, double& expectedFrameDelay){
+// Features this host can use with a client on the current transport
+uint32_t JOYRECEIVER_HOST_CAPABILITIES() {
+    uint32_t caps = NETJOY_CAP_BINARY_HELLO | NETJOY_CAP_RESUME | NETJOY_CAP_IMU_DELTA;
+    if (UDP_COMMUNICATION) caps |= NETJOY_CAP_TIMESTAMPS | NETJOY_CAP_DELTA | NETJOY_CAP_BATCHING | NETJOY_CAP_FEC | NETJOY_CAP_CLOCK | NETJOY_CAP_RATE | NETJOY_CAP_ACKED_SIGNALS;
+    else caps |= NETJOY_CAP_STREAM;
+    return caps;
+}
+
+// Agrees to what a HelloMessage offers, returns false when it is unusable
+bool JOYRECEIVER_PARSE_HELLO(const char* buffer, int& client_timing, int& op_mode, int& client_protocol, int& client_fec, uint32_t& client_caps) {
+    HelloMessage hello;
+    std::memcpy(&hello, buffer, HELLO_SIZE);
+
+    client_timing = hello.rate;
+    op_mode = hello.format;
+    client_caps = hello.capabilities & JOYRECEIVER_HOST_CAPABILITIES();
+    client_protocol = (client_caps & NETJOY_CAP_TIMESTAMPS) ? hello.version : 0;
+    if (client_protocol > NETJOY_PROTOCOL_VERSION) client_protocol = NETJOY_PROTOCOL_VERSION;
+    client_fec = ((client_caps & NETJOY_CAP_FEC) && client_protocol >= NETJOY_PROTOCOL_FEC) ? hello.fecGroup : 0;
+    if (client_fec < MIN_FEC_GROUP || client_fec > MAX_FEC_GROUP) client_fec = 0;
+    if (client_fec == 0) client_caps &= ~NETJOY_CAP_FEC;
+    if (client_protocol < NETJOY_PROTOCOL_BUNDLE) client_caps &= ~NETJOY_CAP_BATCHING;
+    if (client_protocol < NETJOY_PROTOCOL_DELTA) client_caps &= ~NETJOY_CAP_DELTA;
+    if (client_protocol < NETJOY_PROTOCOL_CLOCK) client_caps &= ~NETJOY_CAP_CLOCK;
+    if (client_protocol < NETJOY_PROTOCOL_RATE) client_caps &= ~NETJOY_CAP_RATE;
+    if (client_protocol == 0) client_caps &= ~NETJOY_CAP_TIMESTAMPS;
+    // motion deltas need DS4 reports, and frames (UDP) or stream messages (TCP) to carry them
+    if (op_mode != REPORT_FORMAT_DS4 || (UDP_COMMUNICATION ? client_protocol < NETJOY_PROTOCOL_IMU : !(client_caps & NETJOY_CAP_STREAM)))
+        client_caps &= ~NETJOY_CAP_IMU_DELTA;
+
+    return client_timing > 0 && (op_mode == REPORT_FORMAT_XUSB || op_mode == REPORT_FORMAT_DS4);
+}
+
+// Parses the client's HelloMessage or older "fps:mode[:protocol[:fec]]" settings (client_caps 0),
+// returns false when they are malformed
+bool JOYRECEIVER_PARSE_SETTINGS(const char* buffer, const int bytesReceived, int& client_timing, int& op_mode, int& client_protocol, int& client_fec, uint32_t& client_caps) {
+    if (is_hello_message(buffer, bytesReceived))
+        return JOYRECEIVER_PARSE_HELLO(buffer, client_timing, op_mode, client_protocol, client_fec, client_caps);
+
+    client_caps = 0;
     try {
         std::vector<std::string> split_settings = split(std::string(buffer, bytesReceived), ':');
         client_timing = std::stoi(split_settings[0]);
         op_mode = (split_settings.size() > 1) ? std::stoi(split_settings[1]) : 0;
-        expectedFrameDelay = 1000.0 / client_timing;
+        // framing capable clients append the highest protocol version they speak (UDP only)
+        client_protocol = (split_settings.size() > 2 && UDP_COMMUNICATION) ? std::stoi(split_settings[2]) : 0;
+        if (client_protocol < 0) client_protocol = 0;
+        if (client_protocol > NETJOY_PROTOCOL_VERSION) client_protocol = NETJOY_PROTOCOL_VERSION;
+        // followed by the parity group size when it wants FEC
+        client_fec = (split_settings.size() > 3 && client_protocol >= NETJOY_PROTOCOL_FEC) ? std::stoi(split_settings[3]) : 0;
+        if (client_fec < MIN_FEC_GROUP || client_fec > MAX_FEC_GROUP) client_fec = 0;
     }
     catch (...) {
+        return false;
+    }
+    return true;
+}
+
+void JOYRECEIVER_GET_MODE_AND_TIMING_FROM_BUFFER(const char* buffer, const int bytesReceived, int& client_timing, int& op_mode, int& client_protocol, int& client_fec, uint32_t& client_caps, double& expectedFrameDelay){
+    if (JOYRECEIVER_PARSE_SETTINGS(buffer, bytesReceived, client_timing, op_mode, client_protocol, client_fec, client_caps)) {
+        expectedFrameDelay = 1000.0 / client_timing;
+    }
+    else {
         std::cerr << "\r\n<< Illegal connection attempted: program exiting >>" << std::endl;
         std::cerr << " Received from " << connectionIP << ": (" << bytesReceived << " bytes)" << std::endl;
         displayBytes(reinterpret_cast<const byte*>(buffer), bytesReceived);
@@ -180,30 +489,682 @@ void JOYRECEIVER_GET_MODE_AND_TIMING_FROM_BUFFER(const char* buffer, const int b
     }
 }
 
+// Builds the reply to the client's settings (at least MAX_WELCOME_REPLY_SIZE bytes): a WelcomeMessage
+// for a binary hello, else "Go for Joy!" followed by the protocol version and parity group size
+// for a framing client. Returns the reply size
+int JOYRECEIVER_GO_FOR_JOY_MESSAGE(char* reply, int client_protocol, int client_fec, uint32_t client_caps, uint16_t sessionId = 0, int pad = 0, bool resumed = false) {
+    if (client_caps & NETJOY_CAP_BINARY_HELLO) {
+        WelcomeMessage welcome{};
+        welcome.magic = NETJOY_WELCOME_MAGIC;
+        welcome.version = static_cast<uint8_t>(client_protocol);
+        welcome.fecGroup = static_cast<uint8_t>(client_fec);
+        welcome.sessionId = sessionId;
+        welcome.capabilities = client_caps;
+        welcome.pad = static_cast<uint8_t>(pad);
+        welcome.flags = resumed ? WELCOME_FLAG_RESUMED : 0;
+        std::memcpy(reply, &welcome, WELCOME_SIZE);
+        return WELCOME_SIZE;
+    }
+    int replySize = GO_FOR_JOY_SIZE;
+    std::memcpy(reply, GO_FOR_JOY_MSG, GO_FOR_JOY_SIZE);
+    if (client_protocol) reply[replySize++] = static_cast<char>(client_protocol);
+    if (client_fec) reply[replySize++] = static_cast<char>(client_fec);
+    return replySize;
+}
+
+int JOYRECEIVER_SEND_GO_FOR_JOY(NetworkConnection& server, int client_protocol, int client_fec, uint32_t client_caps, uint16_t sessionToken = 0, bool resumed = false) {
+    char reply[MAX_WELCOME_REPLY_SIZE];
+    server.use_acked_signals((client_caps & NETJOY_CAP_ACKED_SIGNALS) != 0);
+    const uint16_t sessionId = sessionToken ? sessionToken : server.session_id();
+    return server.send_data(reply, JOYRECEIVER_GO_FOR_JOY_MESSAGE(reply, client_protocol, client_fec, client_caps, sessionId, 0, resumed));
+}
+
+// Session id of a HelloMessage: the UDP handshake id, or on TCP the resume token the sender was given
+uint16_t JOYRECEIVER_HELLO_SESSION(const char* buffer, int bytesReceived) {
+    if (!is_hello_message(buffer, bytesReceived)) return 0;
+    HelloMessage hello;
+    std::memcpy(&hello, buffer, HELLO_SIZE);
+    return hello.sessionId;
+}
+
+// Token a resuming sender presents: the UDP handshake id, on TCP one we make up (or the one it brought back)
+uint16_t JOYRECEIVER_SESSION_TOKEN(NetworkConnection& server, uint16_t helloSession, bool resumed) {
+    if (UDP_COMMUNICATION) return server.session_id();
+    return resumed ? helloSession : UDPConnection::new_session_id();
+}
+
+// Carries the button presses of a skipped report into newest, so a tap that starts and ends
+// between two applied reports still reaches the pad. Buttons already down in held (the last
+// applied report, or nullptr) are left to newest, so their release is not held back
+void JOYRECEIVER_CARRY_PRESSES(char* newest, const char* skipped, const char* held, int size) {
+    const ReportButtonByte* bytes = XBOX_BUTTON_BYTES;
+    int count = sizeof(XBOX_BUTTON_BYTES) / sizeof(ReportButtonByte);
+    if (size == DS4_REPORT_NETWORK_DATA_SIZE) {
+        bytes = DS4_BUTTON_BYTES;
+        count = sizeof(DS4_BUTTON_BYTES) / sizeof(ReportButtonByte);
+    }
+    else if (size != XBOX_REPORT_NETWORK_DATA_SIZE) return;
+
+    for (int i = 0; i < count; ++i) {
+        uint8_t down = held ? static_cast<uint8_t>(held[bytes[i].offset]) : 0;
+        newest[bytes[i].offset] |= skipped[bytes[i].offset] & ~down & bytes[i].mask;
+    }
+}
+
+// Pulls input reports off the connection. Framed (UDP) reports are held in a jitter
+// buffer and handed out on the sender's timeline, SIGPackets are passed straight through.
+// Delta frames are rebuilt against the stored keyframe (motion deltas against the frame before, once it is there) before they are
+// buffered, and redundant copies carried in a bundle or parity datagrams fill in frames that were lost on the way.
+// Reports that pile up behind a stall are coalesced, only the newest is handed out (latest wins)
+class InputReceiver {
+private:
+    NetworkConnection& server;
+    JitterBuffer jitter;
+    KeyframeStore keyframes;
+    ImuDeltaDecoder imu;
+    FecDecoder fec;
+    ClockSync clock;
+    LatencyStats latency;
+    DeadReckoning predictor;
+    char packet[MAX_DATAGRAM_SIZE];
+    char rebuilt[MAX_FRAME_PACKET_SIZE];
+    char report[MAX_FRAME_PAYLOAD_SIZE];
+    char bundleReports[MAX_BUNDLE_REDUNDANCY + 1][MAX_FRAME_PAYLOAD_SIZE];
+    char previous[MAX_FRAME_PAYLOAD_SIZE];  // newest streamed report, the base of a motion delta
+    int previousSize = 0;
+    int protocol = 0;
+    bool useFec = false;
+    bool haveKeyframe = false;
+    bool ackPending = false;
+    uint16_t ackedKeyframe = 0;
+    int clientRate = 0;             // reports per second, as last announced
+    int64_t lastFeedback = 0;       // us
+    int64_t lastRoundTrip = 0;      // us, newest accepted clock sample
+
+    // frames expected (from the seq span) and received, for the loss in LinkReports
+    bool haveSeq = false;
+    uint16_t highestSeq = 0;
+    uint32_t expected = 0;
+    uint32_t arrived = 0;
+    uint32_t expectedReported = 0;
+    uint32_t arrivedReported = 0;
+
+    void count_frame(uint16_t seq) {
+        if (!haveSeq) {
+            haveSeq = true;
+            highestSeq = seq;
+            expected = 1;
+        }
+        else if (seq_newer(seq, highestSeq)) {
+            expected += static_cast<uint16_t>(seq - highestSeq);
+            highestSeq = seq;
+        }
+        ++arrived;
+    }
+
+    // Loss since the last report (in 256ths), jitter and round trip for the sender's rate controller
+    LinkReport link_report() {
+        LinkReport report{};
+        report.rate = static_cast<uint16_t>(clientRate);
+        int64_t expectedInterval = expected - expectedReported;
+        int64_t lost = expectedInterval - static_cast<int64_t>(arrived - arrivedReported);
+        if (expectedInterval > 0 && lost > 0) {
+            int64_t fraction = lost * 256 / expectedInterval;
+            report.loss = static_cast<uint8_t>(fraction < 255 ? fraction : 255);
+        }
+        expectedReported = expected;
+        arrivedReported = arrived;
+
+        int64_t jitter100us = static_cast<int64_t>(jitter.jitter_ms() * 10.0);
+        report.jitter = static_cast<uint8_t>(jitter100us < 255 ? jitter100us : 255);
+        int64_t roundTrip100us = lastRoundTrip / 100;
+        report.roundTrip = static_cast<uint16_t>(roundTrip100us < 0xFFFF ? roundTrip100us : 0xFFFF);
+        return report;
+    }
+
+    // latest-wins coalescing
+    char latest[MAX_FRAME_PAYLOAD_SIZE];
+    char applied[MAX_FRAME_PAYLOAD_SIZE];   // last report handed out
+    int appliedSize = 0;
+    char held[MAX_FRAME_PAYLOAD_SIZE];      // unframed report waiting for next_report()
+    int heldSize = 0;
+    char sigPending[sizeof(UDPConnection::SIGPacket)];
+    bool haveSigPending = false;
+    bool signalled = false;                 // the last receive() handed out a SIGPacket
+
+    // length-prefixed TCP messages (NETJOY_CAP_STREAM)
+    StreamReader stream;
+    bool streamed = false;
+
+    void carry_presses(char* newest, const char* skipped, int size) const {
+        JOYRECEIVER_CARRY_PRESSES(newest, skipped, (appliedSize == size) ? applied : nullptr, size);
+    }
+
+    int hand_out(const char* report, int size) {
+        if (size > 0 && size <= MAX_FRAME_PAYLOAD_SIZE) {
+            std::memcpy(applied, report, size);
+            appliedSize = size;
+        }
+        return size;
+    }
+
+    // Pops the next due framed report and folds every later one that is also due into it
+    int pop_latest(char* out, int64_t now) {
+        int size = jitter.pop(out, now);
+        if (size <= 0) return size;
+        int next;
+        while ((next = jitter.pop(latest, now)) > 0) {
+            if (next == size) carry_presses(latest, out, size);
+            std::memcpy(out, latest, next);
+            size = next;
+            ++coalesced;
+        }
+        predictor.observe(out, size, jitter.last_played_stamp(), now);
+        return hand_out(out, record_apply(size, now));
+    }
+
+    // Makes up the report of a frame that is missing at its time (or puts the last real one back once
+    // the horizon has passed), returns its size or 0
+    int predict(char* out, int64_t now) {
+        const uint32_t predicted = predictor.predicted;
+        int size = predictor.predict(out, clientRate, now);
+        if (size > 0 && predictor.predicted != predicted) latency.predictionHorizon.record(predictor.horizon_us());
+        return size;
+    }
+
+    // Reads whatever is already waiting on the socket without blocking, so a stall is caught up
+    // in one go. A SIGPacket ends the drain and is kept for receive(). Returns < 1 on a socket error
+    int drain_socket() {
+        while (!haveSigPending && server.wait_for_data(0) > 0) {
+            int bytes = server.receive_data(packet, sizeof(packet));
+            if (bytes < 1) return bytes;
+            if (UDPConnection::is_sig_packet(packet, bytes)) {
+                if (!server.accept_signal(packet)) continue; // an ack, or a resend already handled
+                std::memcpy(sigPending, packet, bytes);
+                haveSigPending = true;
+            }
+            else if (is_framed()) queue_packet(packet, bytes);
+            else hold_report(packet, bytes);
+        }
+        return 1;
+    }
+
+    int take_sig_packet(char* buffer) {
+        haveSigPending = false;
+        signalled = true;
+        std::memcpy(buffer, sigPending, sizeof(sigPending));
+        return sizeof(sigPending);
+    }
+
+    // inter arrival jitter: transit change for framed streams, gap change otherwise
+    bool haveArrival = false;
+    int64_t lastArrival = 0;
+    int64_t lastSpacing = 0;        // us, sender stamp difference or arrival gap
+    uint32_t lastSendStamp = 0;
+
+    void record_arrival(int64_t arrival, uint32_t sendStamp) {
+        if (haveArrival) {
+            int64_t gap = arrival - lastArrival;
+            int64_t d = is_framed() ? gap - static_cast<int32_t>(sendStamp - lastSendStamp) : gap - lastSpacing;
+            latency.arrivalJitter.record(d < 0 ? -d : d);
+            lastSpacing = gap;
+        }
+        haveArrival = true;
+        lastArrival = arrival;
+        lastSendStamp = sendStamp;
+    }
+
+    // sender stamp to playout of the frame just popped, only meaningful once the clocks agree
+    int record_apply(int size, int64_t now) {
+        if (size > 0 && clock.is_synced())
+            latency.inputToApply.record(clock.one_way_delay(jitter.last_played_stamp(), now));
+        return size;
+    }
+
+public:
+    uint32_t droppedNoBase = 0;     // deltas whose keyframe never arrived, imu_stats() counts motion deltas
+    uint32_t coalesced = 0;         // stale reports folded into a newer one instead of applied
+    int64_t lastOneWay = 0;         // us, network delay of the newest frame once the clocks are synced
+    double averageOneWay = 0.0;     // us
+
+    InputReceiver(NetworkConnection& server, int maxJitterMillisec, int predictMillisec = 0)
+        : server(server), jitter(maxJitterMillisec), predictor(predictMillisec) {}
+
+    void reset(int clientProtocol, int fecGroup = 0, int clientTiming = 0, bool streamFraming = false) {
+        protocol = clientProtocol;
+        streamed = streamFraming && !UDP_COMMUNICATION;
+        stream.reset();
+        clientRate = clientTiming;
+        lastRoundTrip = 0;
+        haveSeq = false;
+        expected = arrived = expectedReported = arrivedReported = 0;
+        useFec = fecGroup > 0;
+        jitter.reset();
+        keyframes.reset();
+        imu.reset();
+        fec.reset();
+        clock.reset();
+        latency.reset();
+        predictor.reset();
+        haveArrival = false;
+        lastOneWay = 0;
+        averageOneWay = 0.0;
+        haveKeyframe = false;
+        ackPending = false;
+        droppedNoBase = 0;
+        coalesced = 0;
+        appliedSize = 0;
+        previousSize = 0;
+        heldSize = 0;
+        haveSigPending = false;
+        signalled = false;
+    }
+
+    bool is_framed() const { return protocol > 0; }
+    bool is_streamed() const { return streamed; }
+    // true when the last receive() returned a SIGPacket rather than an input report
+    bool signal_received() const { return signalled; }
+    const JitterBuffer& stats() const { return jitter; }
+    const FecDecoder& fec_stats() const { return fec; }
+    const ImuDeltaDecoder& imu_stats() const { return imu; }
+    const ClockSync& clock_stats() const { return clock; }
+    const LatencyStats& latency_stats() const { return latency; }
+    const DeadReckoning& prediction_stats() const { return predictor; }
+    bool clock_synced() const { return clock.is_synced(); }
+    double one_way_ms() const { return averageOneWay / 1000.0; }
+    int client_rate() const { return clientRate; }
+
+    // true when a new keyframe should be acknowledged to the client
+    bool ack_pending() const { return ackPending; }
+
+    // true when feedback should go out even though it has not changed
+    bool feedback_due() const { return ackPending || netjoy_clock_us() - lastFeedback >= FEEDBACK_KEEPALIVE_US; }
+
+    // Builds the rumble + lightbar reply into out (at least FEEDBACK_RATE_SIZE bytes), with the
+    // keyframe acknowledgement when the client uses deltas, our clock for the client to echo and
+    // the link statistics its rate controller works from. Returns the reply size
+    int feedback_packet(const char* feedback, char* out) {
+        lastFeedback = netjoy_clock_us();
+        std::memcpy(out, feedback, FEEDBACK_DATA_SIZE);
+        if (protocol < NETJOY_PROTOCOL_DELTA) return FEEDBACK_DATA_SIZE;
+
+        std::memcpy(out + FEEDBACK_DATA_SIZE, &ackedKeyframe, sizeof(ackedKeyframe));
+        if (haveKeyframe) ackPending = false;
+        if (protocol < NETJOY_PROTOCOL_CLOCK) return FEEDBACK_ACK_SIZE;
+
+        uint32_t stamp = static_cast<uint32_t>(netjoy_clock_us());
+        std::memcpy(out + FEEDBACK_ACK_SIZE, &stamp, sizeof(stamp));
+        if (protocol < NETJOY_PROTOCOL_RATE) return FEEDBACK_CLOCK_SIZE;
+
+        LinkReport report = link_report();
+        std::memcpy(out + FEEDBACK_CLOCK_SIZE, &report, LINK_REPORT_SIZE);
+        return FEEDBACK_RATE_SIZE;
+    }
+
+    int send_feedback(const char* feedback) {
+        char reply[FEEDBACK_RATE_SIZE];
+        int size = feedback_packet(feedback, reply);
+        if (!streamed) return server.send_data(reply, size);
+        char message[STREAM_HEADER_SIZE + FEEDBACK_RATE_SIZE];
+        return server.send_data(message, write_stream_message(message, STREAM_FEEDBACK, reply, size));
+    }
+
+    // Tells the client we are leaving, over TCP only once it reads streamed messages
+    void hang_up() {
+        if (UDP_COMMUNICATION) {
+            server.hang_up();
+            return;
+        }
+        if (!streamed) return;
+        UDPConnection::SIGPacket pkt = UDPConnection::make_packet(UDPConnection::PACKET_HANGUP);
+        char message[STREAM_HEADER_SIZE + sizeof(UDPConnection::SIGPacket)];
+        server.send_data(message, write_stream_message(message, STREAM_SIGNAL, (const char*)&pkt, sizeof(pkt)));
+    }
+
+    // Next report that is due for playout, the newest when several are, returns its size or 0
+    int next_report(char* out) {
+        if (heldSize > 0) {
+            int size = heldSize;
+            heldSize = 0;
+            std::memcpy(out, held, size);
+            return hand_out(out, size);
+        }
+        const int64_t now = netjoy_clock_us();
+        int size = pop_latest(out, now);
+        return (size > 0) ? size : predict(out, now);
+    }
+
+    // Microseconds until the next report (or prediction for a missing one) is due, -1 when none will be
+    int64_t time_until_next() const {
+        if (heldSize > 0) return 0;
+        const int64_t now = netjoy_clock_us();
+        int64_t wait = jitter.time_until_next(now);
+        int64_t guess = predictor.time_until_due(clientRate, now);
+        return (guess >= 0 && (wait < 0 || guess < wait)) ? guess : wait;
+    }
+
+    // Keeps an unframed report for next_report(), folding it over one that is still waiting
+    void hold_report(const char* data, int size) {
+        if (size <= 0 || size > MAX_FRAME_PAYLOAD_SIZE) return;
+        record_arrival(netjoy_clock_us(), 0);
+        std::memcpy(latest, data, size);
+        if (heldSize > 0) {
+            if (heldSize == size) carry_presses(latest, held, size);
+            ++coalesced;
+        }
+        std::memcpy(held, latest, size);
+        heldSize = size;
+    }
+
+    // Queues a framed datagram (or takes a rate announcement) received outside of receive(),
+    // returns false if it is neither. On a streamed connection the bytes join the stream
+    bool queue_packet(const char* data, int size) {
+        if (streamed) return stream.append(data, size);
+        if (!is_framed()) return false;
+        if (is_rate_message(data, size)) {
+            RateMessage msg;
+            std::memcpy(&msg, data, RATE_MESSAGE_SIZE);
+            if (msg.rate > 0) clientRate = msg.rate;
+            return true;
+        }
+        if (!is_frame_packet(data, size)) return false;
+        queue_datagram(data, size, false);
+        return true;
+    }
+
+private:
+    // recovered datagrams arrive late by nature, they are queued as redundant copies
+    void queue_datagram(const char* data, int size, bool recovered) {
+        FrameHeader hdr;
+        std::memcpy(&hdr, data, FRAME_HEADER_SIZE);
+        const char* payload = data + FRAME_HEADER_SIZE;
+        int payloadSize = size - FRAME_HEADER_SIZE;
+
+        if (hdr.type == FRAME_PARITY) {
+            if (!useFec || recovered) return;
+            int rebuiltSize = fec.recover(data, size, rebuilt);
+            if (rebuiltSize > 0) queue_datagram(rebuilt, rebuiltSize, true);
+            return;
+        }
+        if (useFec && !recovered) fec.store(data, size);
+
+        if (hdr.flags & FRAME_FLAG_CLOCK) {
+            if (payloadSize < CLOCK_ECHO_SIZE) return;
+            payloadSize -= CLOCK_ECHO_SIZE;
+            if (!recovered) {
+                ClockEcho echo;
+                std::memcpy(&echo, payload + payloadSize, CLOCK_ECHO_SIZE);
+                int64_t roundTrip = clock.add_sample(echo.receiverStamp, hdr.timestamp - echo.heldFor, hdr.timestamp, netjoy_clock_us());
+                if (roundTrip >= 0) {
+                    latency.feedbackRtt.record(roundTrip);
+                    lastRoundTrip = roundTrip;
+                }
+            }
+        }
+        // tag the frame with its network delay, recovered frames arrive late by nature
+        if (!recovered) {
+            const int64_t arrival = netjoy_clock_us();
+            count_frame(hdr.seq);
+            record_arrival(arrival, hdr.timestamp);
+            if (clock.is_synced()) {
+                lastOneWay = clock.one_way_delay(hdr.timestamp, arrival);
+                averageOneWay += (lastOneWay - averageOneWay) / 16.0;
+            }
+        }
+
+        if (hdr.type == FRAME_BUNDLE) {
+            queue_bundle(hdr, payload, payloadSize, recovered);
+            return;
+        }
+        payloadSize = decode_report(hdr, payload, payloadSize, report);
+        if (payloadSize > 0) jitter.push(hdr, report, payloadSize, netjoy_clock_us(), recovered);
+        queue_unblocked();
+    }
+
+    // Queues the motion deltas that were waiting on a frame that has turned up since, late by nature
+    void queue_unblocked() {
+        FrameHeader hdr;
+        int size;
+        while ((size = imu.next_ready(hdr, report)) > 0) jitter.push(hdr, report, size, netjoy_clock_us(), true);
+    }
+
+    // Rebuilds the full report of a FRAME_REPORT / FRAME_DELTA / FRAME_IMU_DELTA payload into out, returns its size or 0
+    int decode_report(const FrameHeader& hdr, const char* payload, int payloadSize, char* out) {
+        if (hdr.type == FRAME_DELTA) {
+            DeltaHeader dh{};
+            int baseSize = 0;
+            const char* base = nullptr;
+            if (payloadSize >= DELTA_HEADER_SIZE) {
+                std::memcpy(&dh, payload, DELTA_HEADER_SIZE);
+                base = keyframes.find(dh.baseSeq, baseSize);
+            }
+            int size = (base != nullptr) ? decode_delta(out, base, baseSize, payload, payloadSize) : 0;
+            if (size == 0) ++droppedNoBase;
+            else imu.keep(hdr.seq, out, size);
+            return size;
+        }
+        // chained off the frame before it, held until that one is there when it was lost or is late
+        if (hdr.type == FRAME_IMU_DELTA) return imu.decode(hdr, payload, payloadSize, out);
+
+        if (payloadSize > MAX_FRAME_PAYLOAD_SIZE) payloadSize = MAX_FRAME_PAYLOAD_SIZE;
+        std::memcpy(out, payload, payloadSize);
+        imu.keep(hdr.seq, out, payloadSize);
+        if ((hdr.flags & FRAME_FLAG_KEYFRAME) && (!haveKeyframe || seq_newer(hdr.seq, ackedKeyframe))) {
+            keyframes.store(hdr.seq, payload, payloadSize);
+            haveKeyframe = true;
+            ackedKeyframe = hdr.seq;
+            ackPending = true;
+        }
+        return payloadSize;
+    }
+
+    // Queues the newest frame of a bundle, then any redundant copies the jitter buffer is missing
+    void queue_bundle(const FrameHeader& hdr, const char* payload, int payloadSize, bool recovered) {
+        BundleHeader bh;
+        if (payloadSize < BUNDLE_HEADER_SIZE) return;
+        std::memcpy(&bh, payload, BUNDLE_HEADER_SIZE);
+        int pos = BUNDLE_HEADER_SIZE;
+        if (bh.frameSize > payloadSize - pos) return;
+
+        FrameHeader frame = hdr;
+        frame.type = bh.frameType;
+        int reportSize = decode_report(frame, payload + pos, bh.frameSize, bundleReports[0]);
+        if (reportSize == 0) return; // copies are chained off the newest frame
+        pos += bh.frameSize;
+
+        const int64_t arrival = netjoy_clock_us();
+        jitter.push(frame, bundleReports[0], reportSize, arrival, recovered);
+
+        int count = (bh.count < MAX_BUNDLE_REDUNDANCY) ? bh.count : MAX_BUNDLE_REDUNDANCY;
+        for (int n = 1; n <= count; ++n) {
+            BundleEntry entry;
+            if (payloadSize - pos < BUNDLE_ENTRY_SIZE) break;
+            std::memcpy(&entry, payload + pos, BUNDLE_ENTRY_SIZE);
+            pos += BUNDLE_ENTRY_SIZE;
+            if (entry.size > payloadSize - pos) break;
+            if (!decode_delta(bundleReports[n], bundleReports[n - 1], reportSize, payload + pos, entry.size)) break;
+            pos += entry.size;
+
+            FrameHeader copy{};
+            copy.type = FRAME_REPORT;
+            copy.seq = static_cast<uint16_t>(hdr.seq - n);
+            copy.timestamp = entry.timestamp;
+            imu.keep(copy.seq, bundleReports[n], reportSize);
+            jitter.push(copy, bundleReports[n], reportSize, arrival, true);
+        }
+        queue_unblocked();
+    }
+
+    // Every input report already in the stream is folded into the newest, a signal waits for the
+    // report before it to be handed out. Reads only when nothing whole is buffered, or to catch up
+    int receive_stream(char* buffer) {
+        while (!APP_KILLED) {
+            StreamReader::Message msg;
+            while (!haveSigPending && stream.next(msg)) {
+                if (msg.type == STREAM_INPUT && msg.size <= MAX_FRAME_PAYLOAD_SIZE) {
+                    hold_report(msg.data, msg.size);
+                    std::memcpy(previous, msg.data, msg.size);
+                    previousSize = msg.size;
+                }
+                else if (msg.type == STREAM_IMU_DELTA) {
+                    // a stream loses nothing, so the previous input is always there to build on
+                    int size = (previousSize > 0) ? decode_imu_delta(report, previous, previousSize, msg.data, msg.size) : 0;
+                    if (size == 0) {
+                        WSASetLastError(WSAECONNABORTED);
+                        return -WSAECONNABORTED;
+                    }
+                    hold_report(report, size);
+                    std::memcpy(previous, report, size);
+                }
+                else if (msg.type == STREAM_SIGNAL && msg.size == sizeof(sigPending)) {
+                    std::memcpy(sigPending, msg.data, msg.size);
+                    haveSigPending = true;
+                }
+            }
+            if (stream.corrupt()) {
+                WSASetLastError(WSAECONNABORTED);
+                return -WSAECONNABORTED;
+            }
+            if (heldSize > 0) {
+                // more already waiting on the socket, fold it in too
+                if (!haveSigPending && server.wait_for_data(0) > 0 && stream.fill(server) > 0) continue;
+                return next_report(buffer);
+            }
+            if (haveSigPending) return take_sig_packet(buffer);
+            int bytes = stream.fill(server);
+            if (bytes < 1) return bytes;
+        }
+        return 0;
+    }
+
+public:
+    // Receives the next input report (or SIGPacket) into buffer, returns like NetworkConnection::receive_data
+    int receive(char* buffer, int bufferSize) {
+        signalled = false;
+        if (haveSigPending) return take_sig_packet(buffer);
+        if (streamed) return receive_stream(buffer);
+        if (!is_framed()) {
+            int bytes = server.receive_data(buffer, bufferSize);
+            if (bytes < 1) return bytes;
+            if (UDP_COMMUNICATION && UDPConnection::is_sig_packet(buffer, bytes)) {
+                // an ack, or a resend already handled, is not handed out
+                if (!server.accept_signal(buffer)) return receive(buffer, bufferSize);
+                signalled = true;
+                return bytes;
+            }
+            if (!UDP_COMMUNICATION) { // a TCP report may arrive in pieces
+                record_arrival(netjoy_clock_us(), 0);
+                return bytes;
+            }
+            hold_report(buffer, bytes);
+            drain_socket(); // an error here shows up again on the next receive
+            return next_report(buffer);
+        }
+
+        const int64_t deadline = netjoy_clock_us() + NETWORK_TIMEOUT_MILLISECONDS * 1000LL;
+        while (!APP_KILLED) {
+            int drained = drain_socket();
+            if (drained < 1) return drained;
+            int64_t now = netjoy_clock_us();
+            int size = pop_latest(buffer, now);
+            if (size > 0) return size;
+            if (haveSigPending) return take_sig_packet(buffer);
+            size = predict(buffer, now);
+            if (size > 0) return size;
+            if (now >= deadline) break;
+
+            // sleep on the socket until data arrives or the next frame (or prediction) is due
+            int64_t wait = jitter.time_until_next(now);
+            int64_t guess = predictor.time_until_due(clientRate, now);
+            if (guess >= 0 && (wait < 0 || guess < wait)) wait = guess;
+            if (wait < 0 || now + wait > deadline) wait = deadline - now;
+            int ready = server.wait_for_data(static_cast<int>((wait + 999) / 1000));
+            if (ready < 0) return ready;
+        }
+        WSASetLastError(WSAETIMEDOUT);
+        return -WSAETIMEDOUT;
+    }
+};
+
+
+// Sends the rumble + lightbar in state when it holds a generation not yet sent, or a keep-alive
+// is due, returns like send_data (1 when nothing needed sending)
+int JOYRECEIVER_SEND_FEEDBACK(InputReceiver& receiver, const FeedbackState& state, uint32_t& sentGeneration) {
+    const uint64_t snapshot = state.load();
+    if (FeedbackState::generation(snapshot) == sentGeneration && !receiver.feedback_due()) return 1;
+    sentGeneration = FeedbackState::generation(snapshot);
+
+    char feedback[FEEDBACK_DATA_SIZE];
+    FeedbackState::copy(snapshot, feedback);
+    return receiver.send_feedback(feedback);
+}
+
+// Follows a rate change the client announced, keeping the fps readout and latency estimate in step
+void JOYRECEIVER_APPLY_CLIENT_RATE(const InputReceiver& receiver, int& client_timing, double& expectedFrameDelay) {
+    int rate = receiver.client_rate();
+    if (rate < 1 || rate == client_timing) return;
+    client_timing = rate;
+    expectedFrameDelay = 1000.0 / client_timing;
+}
+
+// p50 / p90 / p99 / p99.9 / max of a finished connection, and how many stale reports it skipped
+void JOYRECEIVER_PRINT_LATENCY_STATS(const InputReceiver& receiver) {
+    const LatencyStats& stats = receiver.latency_stats();
+    if (stats.inputToApply.count())
+        std::cout << "  Input to apply  (p50/p90/p99/p99.9/max) : " << stats.inputToApply.summary() << std::endl;
+    if (stats.arrivalJitter.count())
+        std::cout << "  Arrival jitter  (p50/p90/p99/p99.9/max) : " << stats.arrivalJitter.summary() << std::endl;
+    if (stats.feedbackRtt.count())
+        std::cout << "  Feedback RTT    (p50/p90/p99/p99.9/max) : " << stats.feedbackRtt.summary() << std::endl;
+    if (receiver.coalesced)
+        std::cout << "  Coalesced reports : " << receiver.coalesced << std::endl;
+    const DeadReckoning& prediction = receiver.prediction_stats();
+    if (prediction.predicted) {
+        std::cout << "  Predicted reports : " << prediction.predicted << " over " << prediction.gaps << " gaps, error (mean/max) "
+            << formatDecimalString(std::to_string(prediction.gaps ? 100.0 * prediction.errorSum / prediction.gaps : 0.0), 2) << " / "
+            << formatDecimalString(std::to_string(100.0 * prediction.errorMax), 2) << " % of axis range" << std::endl;
+        if (prediction.restored)
+            std::cout << "  Gaps past horizon : " << prediction.restored << " (last real report put back)" << std::endl;
+        std::cout << "  Predicted horizon (p50/p90/p99/p99.9/max) : " << stats.predictionHorizon.summary() << std::endl;
+    }
+}
+
+// Appends the histograms of a finished connection to path (-s/--stats), nothing when no path was given
+void JOYRECEIVER_DUMP_LATENCY_STATS(const std::string& path, const std::string& client, const LatencyStats& stats) {
+    if (path.empty()) return;
+    std::ofstream out(path, std::ios::app);
+    if (!out) return;
+
+    char when[32] = "";
+    std::time_t now = std::time(nullptr);
+    std::tm local{};
+    if (localtime_s(&local, &now) == 0) std::strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &local);
+    out << "# " << when << " " << client << "\n";
+    stats.write(out);
+    out << "\n";
+}
 
 #define JOYRECEIVER_PLUGIN_VIGEM_CONTROLLER() \
 { \
-    /* Check operating mode and allocate the appropriate gamepad */ \
-    if (op_mode == 2) { /* Emulating a DS4 controller */ \
-        gamepad = vigem_target_ds4_alloc(); \
-    } else { /* Emulating an XBOX360 controller */ \
-        gamepad = vigem_target_x360_alloc(); \
-    } \
-\
-    /* Add gamepad to the ViGEm client bus, this equals a plug-in event */ \
-    vigemErr = vigem_target_add(vigemClient, gamepad); \
-    if (!VIGEM_SUCCESS(vigemErr)) { \
+    /* Lease a gamepad of the operating mode's type, an idle pooled one or a newly plugged in one */ \
+    gamepad = padPool.lease(vigemClient, op_mode, vigemErr); \
+    if (gamepad == nullptr) { \
         std::cerr << "Virtual Gamepad plugin failed with error code: 0x" << std::hex << vigemErr << std::endl; \
         APP_KILLED = 1; \
     } \
 \
     /* Register 360 rumble callback or spin up DS4 feedback thread */ \
-    if (op_mode == 2) { \
-        ds4ThreadStop = false; \
-        ds4Rumbler = std::thread(ds4RumbleThread, std::ref(vigemClient), std::ref(gamepad)); \
+    if (gamepad == nullptr) { \
+        /* nothing to give feedback for, the app is closing */ \
+    } else if (op_mode == 2) { \
+        ds4ThreadStop = std::make_shared<Ds4ThreadFlag>(); \
+        ds4Rumbler = std::thread([client = vigemClient, pad = gamepad, flag = ds4ThreadStop]() { \
+            ds4RumbleThread(client, pad, feedbackState, flag->stop); \
+            flag->exited = true; \
+        }); \
         ds4Rumbler.detach(); \
     } else { \
-        vigemErr = vigem_target_x360_register_notification(vigemClient, gamepad, &xbox_rumble, &feedbackData); \
+        vigemErr = vigem_target_x360_register_notification(vigemClient, gamepad, &xbox_rumble, &feedbackState); \
         if (!VIGEM_SUCCESS(vigemErr)) { \
             std::cerr << "Registering 360 Rumble callback failed with error code: 0x" << std::hex << vigemErr << std::endl; \
         } \
@@ -211,17 +1172,40 @@ void JOYRECEIVER_GET_MODE_AND_TIMING_FROM_BUFFER(const char* buffer, const int b
 }
 
 
-#define JOYRECEIVER_UNPLUG_VIGEM_CONTROLLER() \
+#define JOYRECEIVER_UNPLUG_VIGEM_CONTROLLER() JOYRECEIVER_UNPLUG_PAD(vigemClient, gamepad, op_mode)
+
+// Takes back the pad held for a resuming sender, otherwise unplugs any held pad and plugs in a new one.
+// Expects the client's settings still in buffer
+#define JOYRECEIVER_PLUGIN_OR_RESUME_CONTROLLER() \
+{ \
+    const uint16_t helloSession = JOYRECEIVER_HELLO_SESSION(buffer, bytesReceived); \
+    PVIGEM_TARGET heldGamepad = (client_caps & NETJOY_CAP_RESUME) ? heldPad.resume(helloSession, op_mode, connectionIP) : nullptr; \
+    resumed = heldGamepad != nullptr; \
+    if (resumed) { \
+        gamepad = heldGamepad; \
+    } else { \
+        heldPad.release(); \
+        JOYRECEIVER_PLUGIN_VIGEM_CONTROLLER(); \
+    } \
+    sessionToken = (client_caps & NETJOY_CAP_RESUME) ? JOYRECEIVER_SESSION_TOKEN(server, helloSession, resumed) : 0; \
+    clientHungUp = false; \
+}
+
+// Keeps the pad plugged in for the grace period when the connection dropped under a sender that can
+// resume, unplugs it when the sender hung up or the app is closing
+#define JOYRECEIVER_HOLD_OR_UNPLUG_CONTROLLER() \
 { \
-    if (op_mode == 2) ds4ThreadStop = true; \
-    else vigem_target_x360_unregister_notification(gamepad); \
-    /* Free resources(this disconnects the virtual device) */ \
-    vigem_target_remove(vigemClient, gamepad); \
-    vigem_target_free(gamepad); \
+    if (!APP_KILLED && !clientHungUp && args.grace > 0 && (client_caps & NETJOY_CAP_RESUME)) { \
+        heldPad.hold(vigemClient, gamepad, op_mode, sessionToken, connectionIP, args.grace); \
+    } else { \
+        JOYRECEIVER_UNPLUG_VIGEM_CONTROLLER(); \
+    } \
 }
 
 #define JOYRECEIVER_SHUTDOWN_VIGEM_BUS() \
 { \
+    heldPad.release(); \
+    padPool.drain(); \
     vigem_disconnect(vigemClient); \
     vigem_free(vigemClient); \
 }
@@ -251,6 +1235,7 @@ void JOYRECEIVER_GET_MODE_AND_TIMING_FROM_BUFFER(const char* buffer, const int b
     UDPConnection::SIGPacket* pkt = (UDPConnection::SIGPacket*)buffer; \
     JR_PSP \
     if(pkt->type == UDPConnection::PACKET_HANGUP){ \
+        clientHungUp = true; \
         break; \
     } \
     ALIVE_PACKET_SIGNALS_MAPPING(); \
@@ -325,3 +1310,108 @@ void output_extra_ds4_data(DS4_REPORT_EX& report) {
 #endif
 }
 #endif
+
+// Hands a network report to the virtual pad
+void JOYRECEIVER_UPDATE_PAD(PVIGEM_CLIENT vigemClient, PVIGEM_TARGET gamepad, int op_mode, const char* report) {
+    if (op_mode == 2) {
+        DS4_REPORT_EX ds4_report_ex = { 0 };
+        std::memcpy(&ds4_report_ex, report, DS4_REPORT_NETWORK_DATA_SIZE);
+        vigem_target_ds4_update_ex(vigemClient, gamepad, ds4_report_ex);
+#if DEVTEST
+        output_extra_ds4_data(ds4_report_ex);
+#endif
+    }
+    else {
+        XUSB_REPORT xbox_report = { 0 };
+        std::memcpy(&xbox_report, report, XBOX_REPORT_NETWORK_DATA_SIZE);
+        vigem_target_x360_update(vigemClient, gamepad, xbox_report);
+    }
+}
+
+// Pins the calling thread to one CPU (--net-cpu / --apply-cpu), nothing when cpu < 0
+void JOYRECEIVER_PIN_THREAD(int cpu) {
+    if (cpu < 0 || cpu >= static_cast<int>(sizeof(DWORD_PTR) * 8)) return;
+    SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << cpu);
+}
+
+// Reports in flight from the network thread to the apply thread
+constexpr int APPLY_RING_SLOTS = 16;
+
+// Updates the virtual pad on a thread of its own (-a), fed by the network thread through an
+// SpscRing, so a slow ViGEm call or console write does not hold up the socket and feedback.
+// Reports that queue up while it is busy are coalesced the way InputReceiver does it
+class PadApplier {
+private:
+    SpscRing<APPLY_RING_SLOTS, MAX_FRAME_PAYLOAD_SIZE> ring;
+    std::thread worker;
+    std::atomic<bool> running{ false };
+    // what the readout shows, published by the network thread
+    std::atomic<int> shownRate{ 0 };
+    std::atomic<double> shownNetworkMs{ -1.0 };
+    std::atomic<int64_t> firstAppliedAt{ 0 };  // netjoy_clock_us() of the first pad update since start()
+    char report[MAX_FRAME_PAYLOAD_SIZE];
+    char latest[MAX_FRAME_PAYLOAD_SIZE];
+    char applied[MAX_FRAME_PAYLOAD_SIZE];
+    int appliedSize = 0;
+
+    void run(PVIGEM_CLIENT vigemClient, PVIGEM_TARGET gamepad, int op_mode, int cpu, std::function<void(int, double)> onApplied) {
+        JOYRECEIVER_PIN_THREAD(cpu);
+        while (running.load(std::memory_order_acquire)) {
+            int size = ring.pop(report);
+            if (size < 0) {
+                ring.wait(100); // stop() wakes it
+                continue;
+            }
+            int next;
+            while ((next = ring.pop(latest)) >= 0) {
+                if (next == size) JOYRECEIVER_CARRY_PRESSES(latest, report, (appliedSize == size) ? applied : nullptr, size);
+                std::memcpy(report, latest, next);
+                size = next;
+                ++coalesced;
+            }
+            JOYRECEIVER_UPDATE_PAD(vigemClient, gamepad, op_mode, report);
+            if (firstAppliedAt.load(std::memory_order_relaxed) == 0)
+                firstAppliedAt.store(netjoy_clock_us(), std::memory_order_release);
+            std::memcpy(applied, report, size);
+            appliedSize = size;
+            if (onApplied) onApplied(shownRate.load(std::memory_order_relaxed), shownNetworkMs.load(std::memory_order_relaxed));
+        }
+    }
+
+public:
+    // read once stop() has joined the thread
+    uint32_t coalesced = 0;         // reports folded into a newer one
+    uint32_t dropped = 0;           // reports the network thread found no room for
+
+    ~PadApplier() { stop(); }
+
+    // Starts the apply thread for gamepad, onApplied (may be empty) runs on it after each update
+    // with the rate and network delay (ms, < 0 unknown) last pushed
+    void start(PVIGEM_CLIENT vigemClient, PVIGEM_TARGET gamepad, int op_mode, int cpu, std::function<void(int, double)> onApplied) {
+        stop();
+        ring.clear();
+        coalesced = dropped = 0;
+        appliedSize = 0;
+        firstAppliedAt.store(0, std::memory_order_relaxed);
+        running.store(true, std::memory_order_release);
+        worker = std::thread(&PadApplier::run, this, vigemClient, gamepad, op_mode, cpu, std::move(onApplied));
+    }
+
+    // Joins the apply thread, must come before the gamepad is unplugged
+    void stop() {
+        if (!worker.joinable()) return;
+        running.store(false, std::memory_order_release);
+        ring.wake();
+        worker.join();
+    }
+
+    // When the first report since start() reached the pad (netjoy_clock_us()), 0 until one has
+    int64_t first_applied_at() const { return firstAppliedAt.load(std::memory_order_acquire); }
+
+    // Network thread: queues a report for the pad along with what the readout should show
+    void push(const char* data, int size, int rate, double networkMs) {
+        shownRate.store(rate, std::memory_order_relaxed);
+        shownNetworkMs.store(networkMs, std::memory_order_relaxed);
+        if (!ring.push(data, size)) ++dropped;
+    }
+};
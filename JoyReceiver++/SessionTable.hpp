@@ -0,0 +1,396 @@
+/*
+Copyright (c) 2025 Dave Quinn <qcent@yahoo.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#pragma once
+
+#include <memory>
+
+constexpr int MAX_RECEIVER_SESSIONS = 16;
+static_assert(MAX_DATAGRAM_SIZE <= UDPBatch::PACKET_SIZE, "UDPBatch packets are too small for a framed datagram");
+
+// Rumble + lightbar bytes of one virtual pad, shared with its ViGEm feedback thread/callback
+// so they outlive the session if the DS4 thread is still waiting on an output report. The
+// thread's stop / exited flags go back to the pool with the pad
+struct SessionFeedback : Ds4ThreadFlag {
+    FeedbackState data;
+};
+
+// One sender served on the shared UDP port: its address, virtual pad and input stream
+struct ReceiverSession {
+    enum State { HANDSHAKE, SETTINGS, ACTIVE };
+
+    sockaddr_in address{};
+    uint16_t sessionId = 0;
+    State state = HANDSHAKE;
+    int pad = 0;                    // player number shown in the console
+    int op_mode = 0;
+    int client_timing = 0;
+    int client_protocol = 0;
+    int client_fec = 0;
+    uint32_t client_caps = 0;
+    int reportSize = 0;
+    PVIGEM_TARGET gamepad = nullptr;
+    std::shared_ptr<SessionFeedback> feedback;
+    uint32_t feedbackSent = 0;      // FeedbackState generation last sent
+    int64_t lastHeard = 0;          // us
+    int64_t openedAt = 0;           // us, SYN (or resume) to first applied report is printed once
+    bool applied = false;
+    bool resumed = false;           // the pad was picked back up by the last handshake
+    bool pooled = false;            // the pad was leased from the ControllerPool, not plugged in
+    bool holding = false;           // quiet past the timeout, pad set to neutral for the grace period
+    InputReceiver input;
+
+    ReceiverSession(NetworkConnection& server, int maxJitterMillisec, int predictMillisec)
+        : input(server, maxJitterMillisec, predictMillisec) {}
+};
+
+// Demultiplexes the datagrams of one UDP socket into per sender sessions keyed by source
+// address + handshake session id. Each session gets its own virtual pad and feedback channel
+class SessionTable {
+private:
+    NetworkConnection& server;
+    UDPConnection& udp;
+    PVIGEM_CLIENT vigemClient;
+    int maxSessions;
+    int maxJitter;
+    int grace;                      // ms a quiet resumable session keeps its pad past the timeout
+    int predict;                    // ms of missing frames made up by dead reckoning
+    std::string statsFile;
+    std::unique_ptr<ReceiverSession> sessions[MAX_RECEIVER_SESSIONS];
+    UDPBatch inbox;                 // datagrams drained from the socket in one go
+    UDPBatch outbox;                // handshake replies + feedback, sent once per pass
+    char report[MAX_FRAME_PAYLOAD_SIZE];
+
+    void queue_send(const char* data, int size, const sockaddr_in& to) {
+        if (outbox.full()) flush();
+        outbox.add(data, size, to);
+    }
+
+    static bool same_address(const sockaddr_in& a, const sockaddr_in& b) {
+        return a.sin_addr.s_addr == b.sin_addr.s_addr && a.sin_port == b.sin_port;
+    }
+
+    static std::string address_string(const sockaddr_in& address) {
+        char ip[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &(address.sin_addr), ip, INET_ADDRSTRLEN);
+        return std::string(ip) + ":" + std::to_string(ntohs(address.sin_port));
+    }
+
+    ReceiverSession* find(const sockaddr_in& from) {
+        for (auto& s : sessions) {
+            if (s && same_address(s->address, from)) return s.get();
+        }
+        return nullptr;
+    }
+
+    // A live session the sender asks to resume from a new socket: same host and the session id
+    // of its welcome, agreed on with NETJOY_CAP_RESUME
+    ReceiverSession* find_resumable(const sockaddr_in& from, uint16_t sessionId) {
+        for (auto& s : sessions) {
+            if (s && s->state == ReceiverSession::ACTIVE && (s->client_caps & NETJOY_CAP_RESUME)
+                && s->sessionId == sessionId && s->address.sin_addr.s_addr == from.sin_addr.s_addr)
+                return s.get();
+        }
+        return nullptr;
+    }
+
+    // New session in the first free slot, nullptr when the table is full
+    ReceiverSession* open(const sockaddr_in& from, uint16_t sessionId) {
+        for (int i = 0; i < maxSessions; ++i) {
+            if (sessions[i]) continue;
+            sessions[i] = std::make_unique<ReceiverSession>(server, maxJitter, predict);
+            ReceiverSession& s = *sessions[i];
+            s.address = from;
+            s.sessionId = sessionId;
+            s.pad = i + 1;
+            s.lastHeard = netjoy_clock_us();
+            s.openedAt = s.lastHeard;
+            return &s;
+        }
+        return nullptr;
+    }
+
+    void close(ReceiverSession& s, const char* reason, bool notifyClient) {
+        if (notifyClient) {
+            // resent from flush() until acknowledged, when the sender agreed to acked signals
+            udp.send_signal(UDPConnection::PACKET_HANGUP, s.sessionId, s.address, (s.client_caps & NETJOY_CAP_ACKED_SIGNALS) != 0);
+        }
+        if (s.state == ReceiverSession::ACTIVE) {
+            std::cout << "<< Pad " << s.pad << " : " << address_string(s.address) << " " << reason << " >>" << std::endl;
+            JOYRECEIVER_PRINT_LATENCY_STATS(s.input);
+            JOYRECEIVER_DUMP_LATENCY_STATS(statsFile, "Pad " + std::to_string(s.pad) + " " + address_string(s.address), s.input.latency_stats());
+        }
+        unplug(s);
+        sessions[s.pad - 1].reset();
+    }
+
+    bool plug_in(ReceiverSession& s) {
+        s.feedback = std::make_shared<SessionFeedback>();
+        VIGEM_ERROR vigemErr;
+        s.gamepad = padPool.lease(vigemClient, s.op_mode, vigemErr);
+        if (s.gamepad == nullptr) {
+            std::cerr << "Virtual Gamepad plugin failed with error code: 0x" << std::hex << vigemErr << std::dec << std::endl;
+            return false;
+        }
+
+        if (s.op_mode == 2) {
+            std::thread([client = vigemClient, gamepad = s.gamepad, feedback = s.feedback]() {
+                ds4RumbleThread(client, gamepad, feedback->data, feedback->stop);
+                feedback->exited = true;
+            }).detach();
+        }
+        else {
+            vigemErr = vigem_target_x360_register_notification(vigemClient, s.gamepad, &xbox_rumble, &s.feedback->data);
+            if (!VIGEM_SUCCESS(vigemErr)) {
+                std::cerr << "Registering 360 Rumble callback failed with error code: 0x" << std::hex << vigemErr << std::dec << std::endl;
+            }
+        }
+        return true;
+    }
+
+    void unplug(ReceiverSession& s) {
+        if (s.gamepad == nullptr) return;
+        if (s.op_mode == 2) s.feedback->stop = true;
+        else vigem_target_x360_unregister_notification(s.gamepad);
+        padPool.give_back(s.gamepad, s.op_mode, (s.op_mode == 2) ? s.feedback : nullptr);
+        s.gamepad = nullptr;
+    }
+
+    // Client settings arrive after the SYN/ACK handshake, answered like the single client host does
+    void handle_settings(ReceiverSession& s, const char* data, int size) {
+        const int heldMode = s.op_mode;
+        bool parsed = JOYRECEIVER_PARSE_SETTINGS(data, size, s.client_timing, s.op_mode, s.client_protocol, s.client_fec, s.client_caps);
+        // a binary hello names the session it belongs to
+        if (parsed && is_hello_message(data, size)) {
+            HelloMessage hello;
+            std::memcpy(&hello, data, HELLO_SIZE);
+            parsed = (hello.sessionId == s.sessionId);
+            if (hello.capabilities & NETJOY_CAP_MULTI_PAD) s.client_caps |= NETJOY_CAP_MULTI_PAD;
+        }
+        if (!parsed) {
+            std::cout << "<< Illegal connection attempted from " << address_string(s.address) << " >>" << std::endl;
+            close(s, "Rejected", true);
+            return;
+        }
+        // a resumed session keeps its pad, unless the sender switched controller type
+        const bool resumed = (s.gamepad != nullptr && s.op_mode == heldMode);
+        s.resumed = resumed;
+        if (!resumed) {
+            unplug(s);
+            if (!plug_in(s)) {
+                close(s, "Failed", true);
+                return;
+            }
+            s.pooled = padPool.last_lease_pooled();
+        }
+        s.input.reset(s.client_protocol, s.client_fec, s.client_timing);
+        s.reportSize = (s.op_mode == 2) ? DS4_REPORT_NETWORK_DATA_SIZE : XBOX_REPORT_NETWORK_DATA_SIZE;
+
+        char reply[MAX_WELCOME_REPLY_SIZE];
+        queue_send(reply, JOYRECEIVER_GO_FOR_JOY_MESSAGE(reply, s.client_protocol, s.client_fec, s.client_caps, s.sessionId, s.pad, resumed), s.address);
+        s.state = ReceiverSession::ACTIVE;
+
+        std::cout << "<< Pad " << s.pad << " : " << address_string(s.address) << (resumed ? " Resumed" : padPool.last_lease_pooled() ? " Connected (pooled pad)" : " Connected") << " >> Emulating "
+            << ((s.op_mode == 2) ? "DS4" : "XBOX") << " Controller @ " << s.client_timing << "fps" << std::endl;
+        if (!resumed) std::cout << "  Pad lease times (mean) : " << padPool.lease_times() << std::endl;
+    }
+
+    void handle_signal(ReceiverSession* s, const char* data, const sockaddr_in& from) {
+        UDPConnection::SIGPacket pkt;
+        std::memcpy(&pkt, data, sizeof(pkt));
+        if (!udp.accept_signal(pkt, from)) return; // an ack, or a resend already handled
+
+        switch (pkt.type) {
+        case UDPConnection::PACKET_SYN:
+            // the sender's welcome id from a new socket (or its old one) picks its pad back up
+            if (ReceiverSession* held = find_resumable(from, pkt.session_id)) {
+                if (s && s != held) close(*s, "Reconnecting", false);
+                s = held;
+                s->address = from;
+                s->state = ReceiverSession::HANDSHAKE;
+                s->openedAt = netjoy_clock_us();
+                s->applied = false;
+            }
+            // a new id from a known address is the same sender reconnecting
+            if (s && (s->state != ReceiverSession::HANDSHAKE || s->sessionId != pkt.session_id)) {
+                close(*s, "Reconnecting", false);
+                s = nullptr;
+            }
+            if (s == nullptr) s = open(from, pkt.session_id);
+            if (s == nullptr) return; // table full, the sender's handshake times out
+            {
+                UDPConnection::SIGPacket synAck = UDPConnection::make_packet(UDPConnection::PACKET_SYN_ACK, pkt.session_id);
+                queue_send((const char*)&synAck, sizeof(synAck), from);
+            }
+            break;
+        case UDPConnection::PACKET_ACK:
+            if (s && s->state == ReceiverSession::HANDSHAKE && s->sessionId == pkt.session_id)
+                s->state = ReceiverSession::SETTINGS;
+            break;
+        case UDPConnection::PACKET_HANGUP:
+            if (s) close(*s, "Disconnected", false);
+            return;
+        default: // PACKET_ALIVE: the sender is busy mapping its controller
+            break;
+        }
+        if (s) s->lastHeard = netjoy_clock_us();
+    }
+
+    void handle_datagram(const char* data, int size, const sockaddr_in& from) {
+        ReceiverSession* s = find(from);
+        if (UDPConnection::is_sig_packet(data, size)) {
+            handle_signal(s, data, from);
+            return;
+        }
+        if (s == nullptr) return; // connection poke before the SYN, or a stranger
+        s->lastHeard = netjoy_clock_us();
+
+        // settings also stand in for a lost ACK
+        if (s->state != ReceiverSession::ACTIVE) {
+            handle_settings(*s, data, size);
+            return;
+        }
+        // unframed (older) senders send the bare report, it waits for update() so a batch coalesces
+        if (!s->input.queue_packet(data, size)) s->input.hold_report(data, size);
+        if (s->input.client_rate() > 0) s->client_timing = s->input.client_rate();
+    }
+
+    void apply_report(ReceiverSession& s, const char* data, int size) {
+        if (size != s.reportSize || s.gamepad == nullptr) return;
+        s.holding = false;
+
+        if (s.op_mode == 2) {
+            DS4_REPORT_EX ds4_report_ex = { 0 };
+            std::memcpy(&ds4_report_ex, data, size);
+            vigem_target_ds4_update_ex(vigemClient, s.gamepad, ds4_report_ex);
+        }
+        else {
+            XUSB_REPORT xbox_report = { 0 };
+            std::memcpy(&xbox_report, data, size);
+            vigem_target_x360_update(vigemClient, s.gamepad, xbox_report);
+        }
+        if (!s.applied) {
+            s.applied = true;
+            const int64_t connectUs = netjoy_clock_us() - s.openedAt;
+            connectTimes.record(s.resumed, s.pooled, connectUs);
+            std::cout << "<< Pad " << s.pad << " : first frame " << formatDecimalString(std::to_string(connectUs / 1000.0), 2)
+                << " ms after connect >> mean " << connectTimes.summary() << std::endl;
+            std::cout << "  new pads (mean) : " << connectTimes.pool_summary() << std::endl;
+        }
+        send_feedback(s);
+    }
+
+    // Rumble + lightbar back to the sender, on change or at least 5 times a second to avoid timeouts
+    void send_feedback(ReceiverSession& s) {
+        const uint64_t snapshot = s.feedback->data.load();
+        if (FeedbackState::generation(snapshot) != s.feedbackSent || s.input.feedback_due()) {
+            s.feedbackSent = FeedbackState::generation(snapshot);
+
+            char feedback[FEEDBACK_DATA_SIZE];
+            FeedbackState::copy(snapshot, feedback);
+            char reply[FEEDBACK_RATE_SIZE];
+            queue_send(reply, s.input.feedback_packet(feedback, reply), s.address);
+        }
+    }
+
+public:
+    SessionTable(NetworkConnection& server, PVIGEM_CLIENT vigemClient, int maxClients, int maxJitterMillisec, const std::string& statsFile = "", int graceMillisec = 0, int predictMillisec = 0)
+        : server(server), udp(*server.get_raw_interface<UDPConnection>()), vigemClient(vigemClient),
+          maxSessions(maxClients < MAX_RECEIVER_SESSIONS ? maxClients : MAX_RECEIVER_SESSIONS), maxJitter(maxJitterMillisec),
+          grace(graceMillisec), predict(predictMillisec), statsFile(statsFile) {}
+
+    ~SessionTable() {
+        for (auto& s : sessions) {
+            if (s) close(*s, "Closed", true);
+        }
+        flush();
+    }
+
+    int count() const {
+        int n = 0;
+        for (const auto& s : sessions) n += (s && s->state == ReceiverSession::ACTIVE);
+        return n;
+    }
+
+    // Waits up to timeoutMillisec for datagrams and hands every queued one to its session
+    // before any framed report reaches a pad
+    void receive(int timeoutMillisec) {
+        int count = udp.receive_batch(inbox, timeoutMillisec);
+        for (int i = 0; i < count; ++i) {
+            const UDPBatch::Packet& p = inbox.packets[i];
+            if (p.size > 0) handle_datagram(p.data, p.size, p.address);
+        }
+    }
+
+    // Sends the queued replies, and the hang-ups waiting for an ack that are due again
+    void flush() {
+        udp.resend_signals();
+        if (outbox.count == 0) return;
+        udp.send_batch(outbox);
+        outbox.clear();
+    }
+
+    // Plays out due reports and drops sessions that have gone quiet
+    void update() {
+        const int64_t now = netjoy_clock_us();
+        for (auto& s : sessions) {
+            if (!s) continue;
+            // a pad the sender can resume is held for the grace period on top of the timeout, at neutral
+            const int64_t timeout = NETWORK_TIMEOUT_MILLISECONDS + ((s->client_caps & NETJOY_CAP_RESUME) ? grace : 0);
+            if (now - s->lastHeard > timeout * 1000LL) {
+                close(*s, "Lost", true);
+                continue;
+            }
+            if (!s->holding && s->gamepad != nullptr && now - s->lastHeard > NETWORK_TIMEOUT_MILLISECONDS * 1000LL) {
+                s->holding = true;
+                JOYRECEIVER_NEUTRAL_PAD(vigemClient, s->gamepad, s->op_mode);
+            }
+            if (s->state != ReceiverSession::ACTIVE) continue;
+
+            int size;
+            while ((size = s->input.next_report(report)) > 0) {
+                apply_report(*s, report, size);
+            }
+        }
+    }
+
+    // Milliseconds until the next buffered report is due, at most cap
+    int next_wait_ms(int cap) const {
+        int64_t wait = cap * 1000LL;
+        for (const auto& s : sessions) {
+            if (!s || s->state != ReceiverSession::ACTIVE) continue;
+            int64_t next = s->input.time_until_next();
+            if (next >= 0 && next < wait) wait = next;
+        }
+        return static_cast<int>((wait + 999) / 1000);
+    }
+};
+
+// Serves up to args.clients senders on the shared UDP port until the app is killed
+void JOYRECEIVER_SERVE_SESSIONS(NetworkConnection& server, PVIGEM_CLIENT vigemClient, const Arguments& args) {
+    auto table = std::make_unique<SessionTable>(server, vigemClient, args.clients, args.jitter, args.stats, args.grace, args.predict);
+    while (!APP_KILLED) {
+        table->receive(table->next_wait_ms(50));
+        table->update();
+        table->flush();
+    }
+}
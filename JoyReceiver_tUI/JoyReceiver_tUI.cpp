@@ -84,13 +84,14 @@ int main(int argc, char* argv[]) {
             break;
         }
 
-        JOYRECEIVER_GET_MODE_AND_TIMING_FROM_BUFFER(buffer, bytesReceived, client_timing, op_mode, expectedFrameDelay);
+        JOYRECEIVER_GET_MODE_AND_TIMING_FROM_BUFFER(buffer, bytesReceived, client_timing, op_mode, client_protocol, client_fec, client_caps, expectedFrameDelay);
         if (op_mode == -1) break;
         g_mode = op_mode;
-        JOYRECEIVER_PLUGIN_VIGEM_CONTROLLER();
+        JOYRECEIVER_PLUGIN_OR_RESUME_CONTROLLER();
+        input_receiver.reset(client_protocol, client_fec, client_timing, (client_caps & NETJOY_CAP_STREAM) != 0);
 
         // Send response back to client
-        allGood = server.send_data("Go for Joy!", 12);
+        allGood = JOYRECEIVER_SEND_GO_FOR_JOY(server, client_protocol, client_fec, client_caps, sessionToken, resumed);
         if (allGood < 1) {
             int len = INET_ADDRSTRLEN + 30;
             swprintf(errorPointer, len, L" << Connection To: %S Failed >> ", connectionIP);
@@ -102,6 +103,7 @@ int main(int argc, char* argv[]) {
         // Prep UI for loop
         tUI_BUILD_MAIN_LOOP(args);
         fps_counter.reset();
+        feedbackSent = FeedbackState::generation(feedbackState.load());
         buffer_size = ((op_mode == 2) ? DS4_REPORT_NETWORK_DATA_SIZE : XBOX_REPORT_NETWORK_DATA_SIZE);
 
         /* Start Receive Joystick Data Loop */
@@ -128,13 +130,17 @@ int main(int argc, char* argv[]) {
             //*****************************
             // Receive joystick input from client to the buffer
             receive:
-            bytesReceived = server.receive_data(buffer, std::max(buffer_size, (int)sizeof(UDPConnection::SIGPacket)));
-            if (bytesReceived == sizeof(UDPConnection::SIGPacket)) {
+            bytesReceived = input_receiver.receive(buffer, std::max(buffer_size, (int)sizeof(UDPConnection::SIGPacket)));
+            if (input_receiver.signal_received()) {
                 JOYRECEIVER_PROCESS_SIGNAL_PACKET();
             }
             if (bytesReceived == -WSAETIMEDOUT) {
-                bytesReceived = JOYRECEIVER_tUI_WAIT_FOR_CLIENT_MAPPING(server, buffer, buffer_size);
+                bytesReceived = JOYRECEIVER_tUI_WAIT_FOR_CLIENT_MAPPING(server, buffer, buffer_size, input_receiver.is_streamed());
                 fps_counter.reset();
+                // first framed report (or stream bytes) after mapping goes through the receiver
+                if (bytesReceived > 0 && input_receiver.queue_packet(buffer, bytesReceived)) {
+                    goto receive;
+                }
             }
             if (bytesReceived < 1) {
                 int len = INET_ADDRSTRLEN + 31;
@@ -143,8 +149,9 @@ int main(int argc, char* argv[]) {
                 errorOut.SetText(errorPointer);
                 break;
             }
+            JOYRECEIVER_APPLY_CLIENT_RATE(input_receiver, client_timing, expectedFrameDelay);
 
-            if (bytesReceived < buffer_size) {
+            if (bytesReceived < buffer_size && !input_receiver.is_streamed()) {
                 JOYRECEIVER_GET_COMPLETE_PACKET();
             }
 
@@ -180,24 +187,14 @@ int main(int argc, char* argv[]) {
 
             //*******************************
             // Send response back to client :: Rumble + lightbar data
-            {
-                static int frameCount = 0;
-                lock.lock(); 
-                // gives at least 5 feedback responses a second to avoid timeouts
-                if (std::memcmp(feedBackComp, feedbackData, sizeof(feedbackData)) != 0 || (frameCount += 5) > client_timing) {
-                    std::memcpy(feedBackComp, feedbackData, sizeof(feedbackData));
-                    frameCount = 0;
-
-                    allGood = server.send_data(feedbackData, sizeof(feedbackData));
-                    if (allGood < 1) {
-                        int len = INET_ADDRSTRLEN + 29;
-                        swprintf(errorPointer, len, L" << Connection To: %S Lost >> ", connectionIP);
-                        errorOut.SetWidth(len);
-                        errorOut.SetText(errorPointer);
-                        break;
-                    }
-                }
-                lock.unlock();
+            // on change, or at least 5 times a second to avoid timeouts
+            allGood = JOYRECEIVER_SEND_FEEDBACK(input_receiver, feedbackState, feedbackSent);
+            if (allGood < 1) {
+                int len = INET_ADDRSTRLEN + 29;
+                swprintf(errorPointer, len, L" << Connection To: %S Lost >> ", connectionIP);
+                errorOut.SetWidth(len);
+                errorOut.SetText(errorPointer);
+                break;
             }
 
             // FPS output
@@ -214,17 +211,19 @@ int main(int argc, char* argv[]) {
         }
         /* End of Receive Joystick Data Loop */
                 
+        JOYRECEIVER_DUMP_LATENCY_STATS(args.stats, connectionIP, input_receiver.latency_stats());
         if (!APP_KILLED) {
+            JOYRECEIVER_tUI_LATENCY_SUMMARY(input_receiver.latency_stats());
             tUI_SET_SUIT_POSITIONS(SUIT_POSITIONS_SCATTERED());
             g_screen.ClearButtonsExcept(HEAP_BTN_IDs);
             g_status |= tUI_RESTART_f;
             g_status &= ~CTRLR_SCREEN_f;
         }
 
-        // Unregister rumble notifications // unplug virtual device
-        JOYRECEIVER_UNPLUG_VIGEM_CONTROLLER();
+        // Unregister rumble notifications // unplug virtual device, or hold it for the sender to resume
+        JOYRECEIVER_HOLD_OR_UNPLUG_CONTROLLER();
     }
-    if (UDP_COMMUNICATION) server.hang_up();
+    input_receiver.hang_up();
     JOYRECEIVER_SHUTDOWN_VIGEM_BUS();
     CLEAN_EGGS();
     swallowInput();
@@ -238,6 +237,7 @@ int main(int argc, char* argv[]) {
 void signalHandler(int signal) {
     if (signal == SIGINT) {
         APP_KILLED = 1;
+        connectionWaiter.cancel();
         Sleep(5);
     }
 }
\ No newline at end of file
@@ -173,14 +173,17 @@ void threadedAwaitConnection(NetworkConnection& server, int& retVal, char* clien
     std::pair<SOCKET, sockaddr_in> connectionResult;
     SOCKET clientSocket;
     while (!APP_KILLED && retVal == WSAEWOULDBLOCK) {
+        // Sleep until a client knocks, the screen loop cancels the wait when the app is closed
+        int ready = server.wait_for_connection(connectionWaiter, CONNECTION_WAIT_SLICE_MILLISECONDS);
+        if (ready == 0 || ready == -WSAECANCELLED) continue;
+
         // Attempt to accept a client connection in non Blocking mode
         connectionResult = server.await_connection();
         clientSocket = connectionResult.first;
         if (clientSocket == INVALID_SOCKET) {
             retVal = WSAGetLastError();
             if (retVal == WSAEWOULDBLOCK) {
-                // No client connection is immediately available
-                Sleep(10); // Sleep for 10 milliseconds
+                // Knock was not a connection (stale packet or failed handshake), wait again
             }
             else if (retVal == WSAEINVAL) {
                 // Invalid argument error * seems to trigger when we don't have access to the specified port
@@ -258,6 +261,30 @@ void JOYRECEIVER_tUI_BUILD_CONNECTION() {
     output1.SetText(L" Waiting For Connection ");
 }
 
+// Percentiles of the last connection, one row each under the IPs while waiting for the next one:
+// input to apply, arrival jitter and feedback round trip as p50 / p90 / p99 / p99.9 / max
+constexpr int LATENCY_ROWS = 3;
+constexpr int LATENCY_ROW_WIDTH = 50;   // columns 12 to 61 of the backdrop's rows 14 to 16
+wchar_t g_latencyRows[LATENCY_ROWS][LATENCY_ROW_WIDTH + 1] = {};
+
+void JOYRECEIVER_tUI_LATENCY_SUMMARY(const LatencyStats& stats) {
+    const LatencyHistogram* rows[LATENCY_ROWS] = { &stats.inputToApply, &stats.arrivalJitter, &stats.feedbackRtt };
+    const wchar_t* names[LATENCY_ROWS] = { L"Apply", L"Jitter", L"RTT" };
+    for (int i = 0; i < LATENCY_ROWS; ++i) {
+        const LatencyHistogram& h = *rows[i];
+        const double ms[5] = { h.percentile_ms(50), h.percentile_ms(90), h.percentile_ms(99), h.percentile_ms(99.9), h.max_ms() };
+        if (!h.count()) swprintf(g_latencyRows[i], LATENCY_ROW_WIDTH + 1, L"%-6s --", names[i]);
+        else if (swprintf(g_latencyRows[i], LATENCY_ROW_WIDTH + 1, L"%-6s %.1f / %.1f / %.1f / %.1f / %.1f ms",
+            names[i], ms[0], ms[1], ms[2], ms[3], ms[4]) < 0) {
+            // seconds long tails, whole milliseconds still fit
+            swprintf(g_latencyRows[i], LATENCY_ROW_WIDTH + 1, L"%-6s %.0f / %.0f / %.0f / %.0f / %.0f ms",
+                names[i], ms[0], ms[1], ms[2], ms[3], ms[4]);
+        }
+    }
+}
+
+int g_listenPort = 0; // shown while waiting for a connection
+
 void REDRAW_CX_TEXT() {
     tUI_DRAW_BG_AND_BUTTONS();
     errorOut.Draw();
@@ -267,7 +294,7 @@ void REDRAW_CX_TEXT() {
     /* Show PORT and IPs */
     setTextColor(fullColorSchemes[g_currentColorScheme].menuColors.col4);
     setCursorPosition(26, 9);
-    wprintf_s(L" %d %s ", *(int*)feedbackData, (UDP_COMMUNICATION ? L"UDP" : L"TCP"));
+    wprintf_s(L" %d %s ", g_listenPort, (UDP_COMMUNICATION ? L"UDP" : L"TCP"));
 
     setTextColor(fullColorSchemes[g_currentColorScheme].menuColors.col1);
     setCursorPosition(28, 11);
@@ -276,13 +303,21 @@ void REDRAW_CX_TEXT() {
     setTextColor(fullColorSchemes[g_currentColorScheme].menuColors.col3);
     setCursorPosition(28, 13);
     wprintf_s(L" %S ", externalIP.c_str());
+
+    /* Latency of the last connection */
+    setTextColor(fullColorSchemes[g_currentColorScheme].menuColors.col2);
+    for (int i = 0; i < LATENCY_ROWS; ++i) {
+        if (!g_latencyRows[i][0]) break;
+        setCursorPosition(12, 14 + i);
+        wprintf_s(L"%s", g_latencyRows[i]);
+    }
 }
 
 void JOYRECEIVER_tUI_AWAIT_ANIMATED_CONNECTION(NetworkConnection& server, Arguments& args, int& allGood, char* connectionIP) {
     /* Set up animation variables */
     JOYRECEIVER_tUI_INIT_FOOTER_ANIMATION();
 
-    std::memcpy(feedbackData, (void*)&args.port, sizeof(int)); // you wanna get nuts? let's get nutz
+    g_listenPort = args.port;
     
     auto roll_new_color = [&]() {
         GET_NEW_COLOR_SCHEME();
@@ -366,12 +401,14 @@ void JOYRECEIVER_tUI_AWAIT_ANIMATED_CONNECTION(NetworkConnection& server, Argume
         }
 
         if (!APP_KILLED && allGood == WSAEWOULDBLOCK) {
+            heldPad.release_expired();
             Sleep(20);
         }
     }
+    if (allGood == WSAEWOULDBLOCK) connectionWaiter.cancel();
     connectThread.detach();
     g_screen.ClearButtonsExcept(HEAP_BTN_IDs);
-    memset(feedbackData, 0, sizeof(feedbackData));
+    feedbackState.clear();
 
     if (!APP_KILLED) {
         /* return to blocking mode */
@@ -381,7 +418,7 @@ void JOYRECEIVER_tUI_AWAIT_ANIMATED_CONNECTION(NetworkConnection& server, Argume
     }
 }
 
-int JOYRECEIVER_tUI_WAIT_FOR_CLIENT_MAPPING(NetworkConnection& server, char* buffer, int buffer_size) {
+int JOYRECEIVER_tUI_WAIT_FOR_CLIENT_MAPPING(NetworkConnection& server, char* buffer, int buffer_size, bool streamed = false) {
     int bytesReceived = 0, counter = 0, len = 43;
     int lastAniFrame = g_frameNum - 1, bgDrawCount = 0;
     bool inEditor = false;
@@ -444,11 +481,14 @@ int JOYRECEIVER_tUI_WAIT_FOR_CLIENT_MAPPING(NetworkConnection& server, char* buf
     size_t framesWithoutSignal = 0;
     // loop
     while (!APP_KILLED) {
-        // check on network traffic
-        bytesReceived = server.receive_data(buffer, std::max(buffer_size, (int)sizeof(UDPConnection::SIGPacket)));
+        // check on network traffic, a framed UDP client can send up to MAX_DATAGRAM_SIZE
+        bytesReceived = server.receive_data(buffer, std::max(buffer_size, UDP_COMMUNICATION ? MAX_DATAGRAM_SIZE : (int)sizeof(UDPConnection::SIGPacket)));
 
         //// IS UDP 'CONNECTION' ALIVE? /////
         if (UDP_COMMUNICATION) {
+            if (bytesReceived == sizeof(UDPConnection::SIGPacket) && !server.accept_signal(buffer)) {
+                bytesReceived = -WSAEWOULDBLOCK; // an ack, or a resend already handled
+            }
             if (bytesReceived > 0 && bytesReceived != sizeof(UDPConnection::SIGPacket)) {
                 break; // recv'd a non udp signal packet
             }
@@ -469,7 +509,7 @@ int JOYRECEIVER_tUI_WAIT_FOR_CLIENT_MAPPING(NetworkConnection& server, char* buf
             }
         }
         ////---------------------/////
-        else if (bytesReceived && bytesReceived != buffer_size) {
+        else if (bytesReceived && bytesReceived != buffer_size && !streamed) { // stream bytes are the receiver's to piece together
             JOYRECEIVER_GET_COMPLETE_PACKET();
         }
         if (bytesReceived > -1) {
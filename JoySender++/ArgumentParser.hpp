@@ -37,6 +37,13 @@ struct Arguments {
     bool select = true;
     int mode = 1;
     int fps = 0;
+    int minFps = 0;
+    int maxFps = 0;
+    int redundancy = 0;
+    int fec = 0;
+    bool onChange = false;
+    bool hidPaced = false;
+    int heartbeat = 100;
 
 };
 
@@ -53,9 +60,16 @@ Arguments parse_arguments(int argc, char* argv[]) {
         ("n,host", "IP address of host/server", cxxopts::value<std::string>()->default_value(""))
         ("p,port", "Port to run on", cxxopts::value<int>()->default_value("5000"))
         ("f,fps", "How many times to attempt to communicate with server per second", cxxopts::value<int>()->default_value("0"))
+        ("min-fps", "Lowest rate the sender may drop to on a congested link (UDP, 0 = fixed rate)", cxxopts::value<int>()->default_value("0"))
+        ("max-fps", "Highest rate the sender may climb to on a clean link (UDP, default --fps)", cxxopts::value<int>()->default_value("0"))
+        ("o,on-change", "Send reports as soon as they change instead of every frame, idle pads only send a heartbeat", cxxopts::value<bool>()->implicit_value("true"))
+        ("i,hid-paced", "DS4 mode: send each controller report as it arrives, decimated to --fps", cxxopts::value<bool>()->implicit_value("true"))
+        ("heartbeat", "Milliseconds between the reports of an idle pad in on-change mode (20-500)", cxxopts::value<int>()->default_value("100"))
         ("m,mode", "Operational Mode: 1: Xbox360 Emulation, 2: DS4 Emulation", cxxopts::value<int>()->default_value("1"))
         ("t,tcp", "Use TCP protocol", cxxopts::value<bool>()->implicit_value("true"))
         ("u,udp", "Use UDP protocol", cxxopts::value<bool>()->implicit_value("true"))
+        ("r,redundancy", "Previous frames repeated in each UDP datagram to hide packet loss (0-4)", cxxopts::value<int>()->default_value("0"))
+        ("e,fec", "Send an XOR parity datagram after every K UDP datagrams (2-16, 0 = off)", cxxopts::value<int>()->default_value("0"))
 #ifndef NetJoyTUI 
         ("l,latency", "Show latency output", cxxopts::value<bool>()->implicit_value("true"))
 #endif        
@@ -93,8 +107,17 @@ Arguments parse_arguments(int argc, char* argv[]) {
     args.select = result["auto"].as<bool>();
     args.mode = result["mode"].as<int>();
     args.fps = result["fps"].as<int>();
+    args.minFps = result["min-fps"].as<int>();
+    args.maxFps = result["max-fps"].as<int>();
     args.udp = result["udp"].as<bool>();
     args.tcp = result["tcp"].as<bool>();
+    args.redundancy = result["redundancy"].as<int>();
+    args.fec = result["fec"].as<int>();
+    args.onChange = result["on-change"].as<bool>();
+    args.heartbeat = result["heartbeat"].as<int>();
+    args.hidPaced = result["hid-paced"].as<bool>();
+    if (args.heartbeat < 20) args.heartbeat = 20;
+    if (args.heartbeat > 500) args.heartbeat = 500; // well inside the host's receive timeout
 
     args.udp = args.tcp ? false : true;
     if (args.fps == 0) args.fps = (args.udp ?  80 : 60); // default 80fps for udp, 60/tcp
@@ -237,6 +237,7 @@ public:
                     if (GetOverlappedResult(selectedDevice, &overlapped, &bytesRead, FALSE))
                     {
                         // Read operation completed successfully
+                        CloseHandle(overlapped.hEvent);
                         return true;
                     }
                     else
@@ -342,6 +343,12 @@ public:
         return HidD_FlushQueue(selectedDevice);
     }
 
+    // Size of the driver's input report ring (2 - 512, default 32). Small keeps every read close to
+    // the newest report when reads are paced by report arrival
+    bool SetInputBuffers(ULONG count) {
+        return HidD_SetNumInputBuffers(selectedDevice, count);
+    }
+
     std::vector<HidDeviceInfo> scanDevices(unsigned short _vendorId,
         unsigned short _productId,
         const  wchar_t* _serial,
@@ -53,22 +53,31 @@ int joySender(Arguments& args) {
     SDLJoystickData activeGamepad;
     XUSB_REPORT xbox_report = {0};
     BYTE* ds4_report = ds4_InReportBuf;
+    FrameWriter frameWriter;
+    ResumeTicket resumeTicket;
+    RateController rateControl;
+    rateControl.reset(args.fps);
+    SendGate sendGate;
+    ArrivalPacer hidPacer;
+    FramePacer framePacer;
 
     // Lambdas and variables for fps/fps-limiting and latency calculations
     FPSCounter fps_counter;
     FPSCounter latencyTimer;
     std::string fpsOutput;
     double loop_delay = 0.0;
-    auto do_fps_counting = [&fps_counter, &args, &loop_delay](int report_frequency = 30) {
+    auto do_fps_counting = [&fps_counter, &rateControl, &loop_delay](int report_frequency = 30) {
         // set up some static doubles we will use each frame
-        static double averageFrameTime_ms, fps, target_sleep = 1000 / (args.fps);
+        static double averageFrameTime_ms, fps;
+        const int rate = rateControl.rate(); // args.fps unless the link has moved it
+        const double target_sleep = 1000 / rate;
 
         int count = fps_counter.increment_frame_count();
 
-        // determine how long to sleep to limit frame rate
+        // estimate the idle time per frame for the latency readout
         averageFrameTime_ms = (fps_counter.get_elapsed_time() / count) * 1000;
         fps = fps_counter.get_fps();
-        if (fps < args.fps)
+        if (fps < rate)
             loop_delay = target_sleep - averageFrameTime_ms;
         else
             loop_delay = target_sleep;
@@ -142,6 +151,9 @@ int joySender(Arguments& args) {
         if (APP_KILLED) return 0;
         NetworkConnection client(args.udp, args.host, args.port);
 
+        // connect to hello reply, timed to compare a resumed session with a cold connect
+        const int64_t connectStart = netjoy_clock_us();
+        client.resume_session(resumeTicket.token_for(args));
         allGood = client.establish_connection(args.host, args.port);
 
         // *******************
@@ -153,8 +165,7 @@ int joySender(Arguments& args) {
             std::cout << std::endl;
 
             // Send timing and mode data
-            std::string txSettings = std::to_string(args.fps) + ":" + std::to_string(args.mode);
-            allGood = client.send_data(txSettings.c_str(), static_cast<int>(txSettings.length()));
+            allGood = JOYSENDER_SEND_HELLO(client, args, resumeTicket.token_for(args));
             if (allGood < 1) {
                 g_outputText += "<< Connection Failed >> \r\n";
                 displayOutputText();
@@ -169,12 +180,16 @@ int joySender(Arguments& args) {
             }
             else{
                 inConnection = true;   
+                JOYSENDER_APPLY_HOST_REPLY(client, buffer, allGood, args, frameWriter, rateControl, resumeTicket);
+                g_outputText += "<< " + std::string(resumeTicket.resumed ? "Session Resumed" : "Session Started") + " in "
+                    + formatDecimalString(std::to_string((netjoy_clock_us() - connectStart) / 1000.0), 2) + " ms >> \r\n";
+                sendGate.reset(args.onChange, args.heartbeat, args.mode == 2, args.hidPaced);
 #if !DEVTEST
                 client.set_silence(true);
 #endif
                 failed_connections = 0;
 
-                std::thread rumbleThread = std::thread(JOYSENDER_FEEDBACK_THREAD, std::ref(client), buffer, buffer_size, std::ref(activeGamepad), std::ref(args), std::ref(inConnection));
+                std::thread rumbleThread = std::thread(JOYSENDER_FEEDBACK_THREAD, std::ref(client), buffer, buffer_size, std::ref(activeGamepad), std::ref(args), std::ref(inConnection), std::ref(frameWriter), std::ref(rateControl));
                 rumbleThread.detach();
             }
 
@@ -186,6 +201,8 @@ int joySender(Arguments& args) {
         // *****************\\
         // Connection loop   ||
         fps_counter.reset();
+        hidPacer.reset();
+        framePacer.reset(rateControl.rate());
         while (inConnection){
             // Shift + R will Reset program allowing joystick reconnection / selection
             // Shift + M will reMap all buttons on an SDL device
@@ -219,16 +236,20 @@ int joySender(Arguments& args) {
 #endif
             }
             if (!allGood) {
-                if (UDP_COMMUNICATION) client.hang_up();
+                JOYSENDER_HANG_UP(client, frameWriter);
                 g_outputText += "<< Device Disconnected >> \r\n";
                 displayOutputText();
                 inConnection = false;
                 return 1;
             }
+            // HID paced: every report arrival comes through here, only some are sent
+            if (args.mode == 2 && args.hidPaced && !hidPacer.due(rateControl.rate(), netjoy_clock_us())) {
+                continue;
+            }
 
             // ###################################
             // let's calculate some timing
-            fpsOutput = do_fps_counting(args.fps);
+            fpsOutput = do_fps_counting(rateControl.rate());
             if (args.latency) {
                 if (!fpsOutput.empty()) {
                     overwriteFPS(fpsOutput + " fps  ");
@@ -244,11 +265,12 @@ int joySender(Arguments& args) {
             // Send joystick input to server
             if (args.mode == 2) {
                 // Shift bytearray to index of first stick value
-                allGood = client.send_data(reinterpret_cast<const char*>(ds4_report+ds4DataOffset), DS4_REPORT_NETWORK_DATA_SIZE);
+                allGood = JOYSENDER_SEND_CHANGED_REPORT(client, frameWriter, sendGate, rateControl.rate(), reinterpret_cast<const char*>(ds4_report+ds4DataOffset), DS4_REPORT_NETWORK_DATA_SIZE);
             }
             else {
-                allGood = client.send_data(reinterpret_cast<const char*>(&xbox_report), sizeof(xbox_report));
+                allGood = JOYSENDER_SEND_CHANGED_REPORT(client, frameWriter, sendGate, rateControl.rate(), reinterpret_cast<const char*>(&xbox_report), sizeof(xbox_report));
             }
+            if (allGood > 0) allGood = JOYSENDER_ANNOUNCE_RATE(client, rateControl);
             // Error check
             if (allGood < 1) {
                 g_outputText += "<< Connection Lost >> \r\n";
@@ -274,8 +296,8 @@ int joySender(Arguments& args) {
             */
 
             // Sleep to yield thread
-            Sleep(loop_delay > 0 ? loop_delay : 0);
-            if (args.mode == 2) {
+            JOYSENDER_WAIT_FOR_NEXT_FRAME(args, sendGate, framePacer, rateControl.rate(), args.heartbeat);
+            if (args.mode == 2 && !args.hidPaced) {
                 // make sure we get a recent report
                 DS4manager.Flush();
             }
@@ -283,7 +305,9 @@ int joySender(Arguments& args) {
         // ****************** \\
         // Connection ended    \\
  
-        if (UDP_COMMUNICATION) client.hang_up();
+        JOYSENDER_HANG_UP(client, frameWriter);
+        if (args.latency && framePacer.frames)
+            g_outputText += "Pacing: " + framePacer.summary() + "\r\n";
 
         // Catch key presses that could have terminiated connection
         // Shift + R  Resets program allowing joystick reconnection / selection, holding a number will change op mode
@@ -33,6 +33,8 @@ THE SOFTWARE.
 #include "NetworkCommunication.h"
 #include "ArgumentParser.hpp"
 #include "FPSCounter.hpp"
+#include "RateController.hpp"
+#include "FramePacer.hpp"
 
 #pragma comment(lib, "SDL3.lib")
 
@@ -40,6 +42,7 @@ THE SOFTWARE.
 volatile sig_atomic_t APP_KILLED = 0;
 constexpr auto APP_NAME = "NetJoy";
 constexpr auto OLDMAP_WARNING_MSG = "! WARNING OLD MAP FILE DETECTED, RE-MAPPING INPUTS RECOMMENDED !";
+constexpr unsigned long HID_PACED_INPUT_BUFFERS = 2;  // the driver's minimum
 bool OLDMAP_FLAG = 0;
 unsigned char RESTART_FLAG = 0;
 unsigned char MAPPING_FLAG = 0;
@@ -317,6 +320,8 @@ void JOYSENDER_OPMODE_INIT(SDLJoystickData& activeGamepad, Arguments& args, int&
                     ds4DataOffset = DS4_VIA_USB;
             }
         }
+        // paced reads should never find a backlog, the driver keeps just the newest report or two
+        if (args.hidPaced) DS4manager.SetInputBuffers(HID_PACED_INPUT_BUFFERS);
     }
     else {
 
@@ -382,8 +387,272 @@ int JOYSENDER_CONSOLE_SELECT_DS4_DIALOG() {
 
 
 
+// Opening message to the host, offers every feature this sender can use on the transport
+HelloMessage JOYSENDER_HELLO_MESSAGE(const Arguments& args, uint16_t sessionId) {
+    HelloMessage hello{};
+    hello.magic = NETJOY_HELLO_MAGIC;
+    hello.version = args.udp ? NETJOY_PROTOCOL_VERSION : 0;
+    hello.format = static_cast<uint8_t>(args.mode);
+    hello.rate = static_cast<uint16_t>(args.fps);
+    hello.capabilities = NETJOY_CAP_BINARY_HELLO | NETJOY_CAP_MULTI_PAD | NETJOY_CAP_RESUME;
+    if (args.udp) hello.capabilities |= NETJOY_CAP_TIMESTAMPS | NETJOY_CAP_DELTA | NETJOY_CAP_BATCHING | NETJOY_CAP_CLOCK | NETJOY_CAP_RATE | NETJOY_CAP_ACKED_SIGNALS;
+    if (args.udp && args.fec) hello.capabilities |= NETJOY_CAP_FEC;
+    if (!args.udp) hello.capabilities |= NETJOY_CAP_STREAM;
+    if (args.mode == REPORT_FORMAT_DS4) hello.capabilities |= NETJOY_CAP_IMU_DELTA;
+    hello.sessionId = sessionId;
+    hello.fecGroup = static_cast<uint8_t>(args.fec);
+    return hello;
+}
+
+// Resume token of the last welcome (NETJOY_CAP_RESUME). Offered again when reconnecting to the same
+// host in the same mode, in the UDP handshake or the hello, the host then hands back the virtual pad
+// it kept plugged in for us instead of plugging in a new one
+struct ResumeTicket {
+    uint16_t token = 0;
+    std::string host;
+    int mode = 0;
+    bool resumed = false;       // the last welcome gave us our old pad back
+
+    uint16_t token_for(const Arguments& args) const {
+        return (host == args.host && mode == args.mode) ? token : 0;
+    }
+};
+
+// Sends the HelloMessage, on TCP carrying the resume token (UDP offers it in the handshake)
+int JOYSENDER_SEND_HELLO(NetworkConnection& client, const Arguments& args, uint16_t resumeToken = 0) {
+    HelloMessage hello = JOYSENDER_HELLO_MESSAGE(args, args.udp ? client.session_id() : resumeToken);
+    return client.send_data(reinterpret_cast<const char*>(&hello), HELLO_SIZE);
+}
+
+// Sets up the connection, frame writer, rate controller and resume ticket with what the host agreed to in its
+// WelcomeMessage. Hosts from before the binary hello reply "Go for Joy!" with the protocol version and parity
+// group size appended
+void JOYSENDER_APPLY_HOST_REPLY(NetworkConnection& client, const char* buffer, int bytesReceived, const Arguments& args, FrameWriter& frames, RateController& rate, ResumeTicket& ticket) {
+    client.use_acked_signals(false);
+    ticket = ResumeTicket();
+    if (is_welcome_message(buffer, bytesReceived)) {
+        WelcomeMessage welcome;
+        std::memcpy(&welcome, buffer, WELCOME_SIZE);
+        frames.reset((welcome.capabilities & NETJOY_CAP_TIMESTAMPS) ? welcome.version : 0,
+            (welcome.capabilities & NETJOY_CAP_BATCHING) ? args.redundancy : 0,
+            (welcome.capabilities & NETJOY_CAP_FEC) ? welcome.fecGroup : 0);
+        if (!(welcome.capabilities & NETJOY_CAP_DELTA)) frames.delta = false;
+        if (!(welcome.capabilities & NETJOY_CAP_CLOCK)) frames.clock = false;
+        frames.stream = (welcome.capabilities & NETJOY_CAP_STREAM) != 0;
+        frames.imu = (welcome.capabilities & NETJOY_CAP_IMU_DELTA) != 0;
+        client.use_acked_signals((welcome.capabilities & NETJOY_CAP_ACKED_SIGNALS) != 0);
+        if (welcome.capabilities & NETJOY_CAP_RESUME) {
+            ticket.token = welcome.sessionId;
+            ticket.host = args.host;
+            ticket.mode = args.mode;
+            ticket.resumed = (welcome.flags & WELCOME_FLAG_RESUMED) != 0;
+        }
+        rate.reset(args.fps, args.minFps, args.maxFps, (welcome.capabilities & NETJOY_CAP_RATE) && welcome.version >= NETJOY_PROTOCOL_RATE);
+        return;
+    }
+    int protocol = (bytesReceived > GO_FOR_JOY_SIZE) ? static_cast<uint8_t>(buffer[GO_FOR_JOY_SIZE]) : 0;
+    int fec = (bytesReceived > GO_FOR_JOY_SIZE + 1) ? static_cast<uint8_t>(buffer[GO_FOR_JOY_SIZE + 1]) : 0;
+    frames.reset(protocol, args.redundancy, fec);
+    rate.reset(args.fps);
+}
+
+// Send-on-change (-o/--on-change): a report goes out as soon as it differs from the last one
+// sent, no closer together than the send rate, and an unchanged report only every heartbeat
+// to keep the host's timeouts quiet. A DS4 report only counts as changed on its controls
+// (sticks, buttons, triggers, touchpad fingers): its counter and timestamp change on every read
+// and its gyro / accel words with every tremor, so motion goes out with the heartbeat and the
+// control changes. With motion set (-i) motion changes count too, and go out at the HID paced rate
+class SendGate {
+private:
+    char last[MAX_FRAME_PAYLOAD_SIZE];
+    int lastSize = 0;
+    int64_t lastSend = 0;
+    int64_t heartbeat = 0;      // us
+    bool ds4 = false;
+    bool motion = false;        // DS4 gyro / accel changes are changes
+    bool held = false;          // the last report checked was changed but came too soon
+
+    bool same_input(const char* report, int size) const {
+        if (size != lastSize) return false;
+        if (!ds4 || size < DS4_TOUCH_FINGERS_OFFSET + DS4_TOUCH_FINGERS_SIZE) return std::memcmp(report, last, size) == 0;
+        return ds4_same_controls(report, last)
+            && std::memcmp(report + DS4_TOUCH_FINGERS_OFFSET, last + DS4_TOUCH_FINGERS_OFFSET, DS4_TOUCH_FINGERS_SIZE) == 0
+            && (!motion || std::memcmp(report + DS4_MOTION_OFFSET, last + DS4_MOTION_OFFSET, DS4_MOTION_WORDS * 2) == 0);
+    }
+
+public:
+    bool enabled = false;
+
+    void reset(bool onChange, int heartbeatMillisec, bool ds4Report, bool motionChanges = false) {
+        enabled = onChange;
+        heartbeat = heartbeatMillisec * 1000LL;
+        ds4 = ds4Report;
+        motion = motionChanges;
+        lastSize = 0;
+        held = false;
+    }
+
+    // true when report should be sent now, at most rate reports per second
+    bool should_send(const char* report, int size, int rate, int64_t now) {
+        if (!enabled) return true;
+        const int64_t since = now - lastSend;
+        const bool changed = !same_input(report, size);
+        held = changed && since < 1000000 / rate;
+        if (held || (!changed && since < heartbeat)) return false;
+
+        if (size > MAX_FRAME_PAYLOAD_SIZE) size = MAX_FRAME_PAYLOAD_SIZE;
+        std::memcpy(last, report, size);
+        lastSize = size;
+        lastSend = now;
+        return true;
+    }
+
+    // Milliseconds the send loop can idle before a held change or the heartbeat is due
+    int wait_ms(int rate, int64_t now) const {
+        int64_t wait = lastSend + (held ? 1000000 / rate : heartbeat) - now;
+        return wait > 0 ? static_cast<int>((wait + 999) / 1000) : 0;
+    }
+};
+
+// Sends an input report to the host, wrapped in a FrameHeader when framing was agreed on, or
+// in a StreamHeader on a streamed TCP connection
+int JOYSENDER_SEND_INPUT_REPORT(NetworkConnection& client, FrameWriter& frames, const char* report, int size) {
+    if (frames.stream) {
+        char message[STREAM_HEADER_SIZE + MAX_FRAME_PAYLOAD_SIZE];
+        return client.send_data(message, frames.write_stream(message, report, size));
+    }
+    if (!frames.enabled) {
+        return client.send_data(report, size);
+    }
+    char packet[MAX_FRAME_PACKET_SIZE];
+    int packetSize = frames.write(packet, report, size);
+    int sent = client.send_data(packet, packetSize);
+    if (sent > 0 && frames.parity_size() > 0) {
+        int paritySent = client.send_data(frames.parity_packet(), frames.parity_size());
+        if (paritySent < 1) return paritySent;
+    }
+    return sent;
+}
+
+// HID paced sending (-i/--hid-paced): each controller report wakes the send loop as it arrives
+// (250 Hz DS4 over USB, up to 1000 Hz overclocked) and is sent at once, skipping arrivals so the
+// stream averages rate reports per second. No sleep and no queue flush between reads
+class ArrivalPacer {
+private:
+    int64_t nextSend = 0;
+
+public:
+    void reset() { nextSend = 0; }
+
+    bool due(int rate, int64_t now) {
+        if (now < nextSend) return false;
+        const int64_t interval = 1000000 / rate;
+        // keep the average on rate, unless we fell a whole interval behind
+        nextSend = (now - nextSend > interval) ? now + interval : nextSend + interval;
+        return true;
+    }
+};
+
+// Sends an input report when the SendGate lets it through, returns like send_data (1 when held back)
+int JOYSENDER_SEND_CHANGED_REPORT(NetworkConnection& client, FrameWriter& frames, SendGate& gate, int rate, const char* report, int size) {
+    if (!gate.should_send(report, size, rate, netjoy_clock_us())) return 1;
+    return JOYSENDER_SEND_INPUT_REPORT(client, frames, report, size);
+}
+
+// Yields the send loop until the next frame. In on-change mode an SDL pad wakes it as soon as
+// an input event arrives, so sends are not held to the frame tick, and idles up to maxWait ms.
+// Otherwise the FramePacer holds the loop to the rate's absolute deadlines
+void JOYSENDER_WAIT_FOR_NEXT_FRAME(const Arguments& args, const SendGate& gate, FramePacer& pacer, int rate, int maxWait) {
+    if (args.mode == 2 && args.hidPaced) return; // the next HID read is the wait
+    if (gate.enabled && args.mode == 1) {
+        int wait = gate.wait_ms(rate, netjoy_clock_us());
+        SDL_WaitEventTimeout(nullptr, wait < maxWait ? wait : maxWait);
+        return;
+    }
+    pacer.set_rate(rate);
+    pacer.wait();
+}
+
+// Hands the keyframe acknowledgement a delta capable host appends to its feedback to the FrameWriter
+void JOYSENDER_READ_KEYFRAME_ACK(FrameWriter& frames, const char* buffer, int bytesReceived) {
+    if (!frames.delta || bytesReceived < FEEDBACK_ACK_SIZE) return;
+    uint16_t keyframeSeq;
+    std::memcpy(&keyframeSeq, buffer + FEEDBACK_DATA_SIZE, sizeof(keyframeSeq));
+    frames.acknowledge(keyframeSeq);
+}
+
+// Hands the host's clock stamp that follows the acknowledgement to the FrameWriter, to be echoed
+void JOYSENDER_READ_CLOCK_STAMP(FrameWriter& frames, const char* buffer, int bytesReceived) {
+    if (!frames.clock || bytesReceived < FEEDBACK_CLOCK_SIZE) return;
+    uint32_t receiverStamp;
+    std::memcpy(&receiverStamp, buffer + FEEDBACK_ACK_SIZE, sizeof(receiverStamp));
+    frames.clock_stamp(receiverStamp, netjoy_clock_us());
+}
+
+// Hands the LinkReport a rate capable host puts after its clock stamp to the RateController
+void JOYSENDER_READ_LINK_REPORT(RateController& rate, const char* buffer, int bytesReceived) {
+    if (!rate.is_adaptive() || bytesReceived < FEEDBACK_RATE_SIZE) return;
+    LinkReport report;
+    std::memcpy(&report, buffer + FEEDBACK_CLOCK_SIZE, LINK_REPORT_SIZE);
+    rate.on_report(report, netjoy_clock_us());
+}
+
+// Tells the host about a rate change until its feedback shows it, returns like send_data (1 when nothing was due)
+int JOYSENDER_ANNOUNCE_RATE(NetworkConnection& client, RateController& rate) {
+    if (!rate.announce_due(netjoy_clock_us())) return 1;
+    RateMessage msg{};
+    msg.magic = NETJOY_RATE_MAGIC;
+    msg.rate = static_cast<uint16_t>(rate.rate());
+    return client.send_data(reinterpret_cast<const char*>(&msg), RATE_MESSAGE_SIZE);
+}
+
+// Tells the host we are leaving, over TCP only once it reads streamed messages
+void JOYSENDER_HANG_UP(NetworkConnection& client, const FrameWriter& frames) {
+    if (UDP_COMMUNICATION) {
+        client.hang_up();
+        return;
+    }
+    if (!frames.stream) return;
+    UDPConnection::SIGPacket pkt = UDPConnection::make_packet(UDPConnection::PACKET_HANGUP);
+    char message[STREAM_HEADER_SIZE + sizeof(UDPConnection::SIGPacket)];
+    client.send_data(message, write_stream_message(message, STREAM_SIGNAL, (const char*)&pkt, sizeof(pkt)));
+}
+
+// Receives the host's next feedback reply (or SIGPacket, flagged in signal) into buffer, returns
+// like receive_data. A streamed connection is read through stream, so replies that arrive together
+// or in pieces are still taken one at a time; otherwise each receive is one reply and a SIGPacket
+// is told apart by its size
+int JOYSENDER_RECEIVE_FEEDBACK(NetworkConnection& client, const FrameWriter& frames, StreamReader& stream, char* buffer, int buffer_size, bool& signal) {
+    signal = false;
+    if (!frames.stream) {
+        int bytes = client.receive_data(buffer, buffer_size);
+        signal = bytes == sizeof(UDPConnection::SIGPacket);
+        return bytes;
+    }
+    StreamReader::Message msg;
+    while (!APP_KILLED) {
+        while (stream.next(msg)) {
+            if (msg.type != STREAM_FEEDBACK && msg.type != STREAM_SIGNAL) continue;
+            int size = msg.size < buffer_size ? msg.size : buffer_size;
+            std::memcpy(buffer, msg.data, size);
+            signal = msg.type == STREAM_SIGNAL;
+            return size;
+        }
+        if (stream.corrupt()) {
+            WSASetLastError(WSAECONNABORTED);
+            return -WSAECONNABORTED;
+        }
+        int bytes = stream.fill(client);
+        if (bytes < 1) return bytes;
+    }
+    return 0;
+}
+
+
 #define JOYSENDER_PROCESS_SIGNAL_PACKET() \
 { \
+    /* acks and resends of a signal already handled are done with here */ \
+    if (!client.accept_signal(buffer)) continue; \
     UDPConnection::SIGPacket* pkt = (UDPConnection::SIGPacket*)buffer; \
     if(pkt->type == UDPConnection::PACKET_HANGUP){ \
         g_outputText += "<< Host Disconnected >> \r\n"; \
@@ -395,13 +664,15 @@ int JOYSENDER_CONSOLE_SELECT_DS4_DIALOG() {
 }
 
 
-void JOYSENDER_FEEDBACK_THREAD(NetworkConnection& client, char* buffer, size_t buffer_size, SDLJoystickData& activeGamepad, Arguments& args, bool& inConnection) {
+void JOYSENDER_FEEDBACK_THREAD(NetworkConnection& client, char* buffer, size_t buffer_size, SDLJoystickData& activeGamepad, Arguments& args, bool& inConnection, FrameWriter& frames, RateController& rate) {
     int timeouts = 0;
+    bool signal = false;
+    StreamReader stream;
     while (!APP_KILLED && inConnection) {
            
-        int allGood = client.receive_data(buffer, buffer_size);
+        int allGood = JOYSENDER_RECEIVE_FEEDBACK(client, frames, stream, buffer, static_cast<int>(buffer_size), signal);
 
-        if (allGood == sizeof(UDPConnection::SIGPacket)) JOYSENDER_PROCESS_SIGNAL_PACKET()
+        if (signal) JOYSENDER_PROCESS_SIGNAL_PACKET()
 
         if (allGood < 1) {           
             if (!inConnection) break;
@@ -427,6 +698,11 @@ void JOYSENDER_FEEDBACK_THREAD(NetworkConnection& client, char* buffer, size_t b
                 }
             }
         }
-        else processFeedbackBuffer((byte*)buffer, activeGamepad, args.mode);
+        else {
+            JOYSENDER_READ_KEYFRAME_ACK(frames, buffer, allGood);
+            JOYSENDER_READ_CLOCK_STAMP(frames, buffer, allGood);
+            JOYSENDER_READ_LINK_REPORT(rate, buffer, allGood);
+            processFeedbackBuffer((byte*)buffer, activeGamepad, args.mode);
+        }
     } 
 }
\ No newline at end of file
@@ -34,6 +34,7 @@ THE SOFTWARE.
 #include <cmath>
 
 #include "HidManager.h"
+#include "FramePacer.hpp"
 #include "DS4OutputReports.h"
 
  /*** LARGELY BASED OFF THE CODE FOUND AT: https://github.com/MTCKC/ProconXInput/blob/master/Controller.cpp ***/
@@ -159,6 +160,8 @@ public:
     }
 
 private:
+    static constexpr int RUMBLE_PERIOD_MS = 18;
+
     HidDeviceManager* hidManager;
     bool bluetooth;
     std::thread worker;
@@ -175,6 +178,8 @@ private:
     }
 
     void run() {
+        FramePacer pacer;
+        pacer.reset(1000.0 / RUMBLE_PERIOD_MS);
         while (running) {
             HD_RumbleFrame local;
 
@@ -200,7 +205,7 @@ private:
                 }
             }
 
-            std::this_thread::sleep_for(std::chrono::milliseconds(18));
+            pacer.wait();
         }
     }
 
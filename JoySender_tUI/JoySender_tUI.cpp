@@ -38,23 +38,23 @@ int joySendertUI(Arguments& args) {
     SDLJoystickData activeGamepad;
     XUSB_REPORT xbox_report = {0}; 
     BYTE* ds4_report = ds4_InReportBuf;
+    FrameWriter frameWriter;
+    ResumeTicket resumeTicket;
+    RateController rateControl;
+    rateControl.reset(args.fps);
+    SendGate sendGate;
+    ArrivalPacer hidPacer;
+    FramePacer framePacer;
     // Lambda Functions and variables for FPS and FPS Limiting calculations
     FPSCounter fps_counter;
-    double loop_delay = 0.0;
     std::string fpsOutput;
-    auto do_fps_counting = [&fps_counter, &args, &loop_delay](int report_frequency = 30) {
-        // set up some static doubles we will use each frame
-        static double averageFrameTime_ms, fps, target_sleep = 1000 / (args.fps);
+    auto do_fps_counting = [&fps_counter](int report_frequency = 30) {
+        // set up a static double we will use each frame
+        static double fps;
         
         int count = fps_counter.increment_frame_count();
 
-        // determine how long to sleep to limit frame rate
-        averageFrameTime_ms = (fps_counter.get_elapsed_time() / count) * 1000;
         fps = fps_counter.get_fps();
-        if (fps < args.fps)
-            loop_delay = target_sleep - averageFrameTime_ms;
-        else
-            loop_delay = target_sleep;
     
         // output fps to caller
         if (count >= report_frequency) {
@@ -107,6 +107,7 @@ int joySendertUI(Arguments& args) {
 #if !DEVTEST
         client.set_silence(true);
 #endif
+        client.resume_session(resumeTicket.token_for(args));
 
         // Establish connection to host
         JOYSENDER_tUI_ANIMATED_CX(activeGamepad, client, args, allGood);
@@ -143,6 +144,8 @@ int joySendertUI(Arguments& args) {
         // //########################################################  //
         // Connection Loop  //######################################  //
         fps_counter.reset();
+        hidPacer.reset();
+        framePacer.reset(rateControl.rate());
         while (inConnection){
             // ignore user input if in theme selector/editor
             if (theme_mtx.try_lock() && !(g_status & EDIT_THEME_f)) {
@@ -214,15 +217,20 @@ int joySendertUI(Arguments& args) {
                 allGood = DISCONNECT_ERROR;
                 break;
             }
+            // HID paced: every report arrival comes through here, only some are sent
+            if (args.mode == 2 && args.hidPaced && !hidPacer.due(rateControl.rate(), netjoy_clock_us())) {
+                continue;
+            }
 
             //  Send joystick input to server
             if (args.mode == 2) {
                 //# Shift bytearray to index of first stick value
-                allGood = client.send_data(reinterpret_cast<const char*>(ds4_report + ds4DataOffset), DS4_REPORT_NETWORK_DATA_SIZE);
+                allGood = JOYSENDER_SEND_CHANGED_REPORT(client, frameWriter, sendGate, rateControl.rate(), reinterpret_cast<const char*>(ds4_report + ds4DataOffset), DS4_REPORT_NETWORK_DATA_SIZE);
             }
             else {
-                allGood = client.send_data(reinterpret_cast<const char*>(&xbox_report), sizeof(xbox_report));
+                allGood = JOYSENDER_SEND_CHANGED_REPORT(client, frameWriter, sendGate, rateControl.rate(), reinterpret_cast<const char*>(&xbox_report), sizeof(xbox_report));
             }
+            if (allGood > 0) allGood = JOYSENDER_ANNOUNCE_RATE(client, rateControl);
             if (allGood < 1) {
                 swprintf(errorPointer, 50, L" << Connection To:  %S Failed >> ", args.host.c_str());
                 errorOut.SetText(errorPointer);
@@ -245,7 +253,7 @@ int joySendertUI(Arguments& args) {
             */
 
             // calculate timing
-            fpsOutput = do_fps_counting(args.fps);
+            fpsOutput = do_fps_counting(rateControl.rate());
             if (!fpsOutput.empty()) {
                 //updateFPS(g_converter.from_bytes(fpsOutput + "   ").c_str(), 8);
                 swprintf(fpsPointer, 8, L" %S   ",fpsOutput.c_str());
@@ -257,9 +265,9 @@ int joySendertUI(Arguments& args) {
                 }
             }
 
-            // Sleep to yield thread
-            Sleep(loop_delay > 0 ? loop_delay : 0);
-            if (args.mode == 2) {
+            // Sleep to yield thread, the screen still wants a redraw every frame
+            JOYSENDER_WAIT_FOR_NEXT_FRAME(args, sendGate, framePacer, rateControl.rate(), 1000 / rateControl.rate());
+            if (args.mode == 2 && !args.hidPaced) {
                 // make sure we get a recent report
                 DS4manager.Flush();
             }
@@ -267,7 +275,7 @@ int joySendertUI(Arguments& args) {
         // #########################################################  \\
         // Connection Ended    ######################################  \\
 
-        if (UDP_COMMUNICATION) client.hang_up();
+        JOYSENDER_HANG_UP(client, frameWriter);
         theme_mtx.lock(); // must exit theme thread
         theme_mtx.unlock();  // before restarting
         tUI_SET_SUIT_POSITIONS(SUIT_POSITIONS_SCATTERED());
@@ -2245,8 +2245,7 @@ int tUIMapTheseInputs(SDLJoystickData& joystick, std::vector<SDLButtonMapping::B
 //joySendertUI() Helpers
 
 #define JOYSENDER_tUI_CX_HANDSHAKE(){ \
-std::string txSettings = std::to_string(args.fps) + ":" + std::to_string(args.mode); \
-allGood = client.send_data(txSettings.c_str(), static_cast<int>(txSettings.length())); \
+allGood = JOYSENDER_SEND_HELLO(client, args, resumeTicket.token_for(args)); \
 if (allGood < 1) { \
     swprintf(errorPointer, 48, L" << Connection To %S Failed >> ", args.host.c_str()); \
     errorOut.SetText(errorPointer); \
@@ -2255,8 +2254,10 @@ if (allGood < 1) { \
 bytesReceived = client.receive_data(buffer, buffer_size); \
 if (bytesReceived > 0) { \
     inConnection = true; \
+    JOYSENDER_APPLY_HOST_REPLY(client, buffer, bytesReceived, args, frameWriter, rateControl, resumeTicket); \
+    sendGate.reset(args.onChange, args.heartbeat, args.mode == 2, args.hidPaced); \
     failed_connections = 0; \
-    std::thread rumbleThread = std::thread(JOYSENDER_tUI_FEEDBACK_THREAD, std::ref(client), buffer, buffer_size, std::ref(activeGamepad), std::ref(args), std::ref(inConnection)); \
+    std::thread rumbleThread = std::thread(JOYSENDER_tUI_FEEDBACK_THREAD, std::ref(client), buffer, buffer_size, std::ref(activeGamepad), std::ref(args), std::ref(inConnection), std::ref(frameWriter), std::ref(rateControl)); \
     rumbleThread.detach(); \
 } \
 else { \
@@ -2561,13 +2562,17 @@ void JOYSENDER_tUI_BUILD_MAP_SCREEN() {
     tUI_SET_SUIT_POSITIONS(SUIT_POSITIONS_MAP_SCREEN());
 }
 
-void JOYSENDER_tUI_FEEDBACK_THREAD(NetworkConnection& client, char* buffer, size_t buffer_size, SDLJoystickData& activeGamepad, Arguments& args, bool& inConnection){
+void JOYSENDER_tUI_FEEDBACK_THREAD(NetworkConnection& client, char* buffer, size_t buffer_size, SDLJoystickData& activeGamepad, Arguments& args, bool& inConnection, FrameWriter& frames, RateController& rate){
     int timeouts = 0;
+    bool signal = false;
+    StreamReader stream;
     while (!APP_KILLED && inConnection) {
 
-        int allGood = client.receive_data(buffer, buffer_size);
+        int allGood = JOYSENDER_RECEIVE_FEEDBACK(client, frames, stream, buffer, static_cast<int>(buffer_size), signal);
 
-        if (allGood == sizeof(UDPConnection::SIGPacket)) {
+        if (signal) {
+            // acks and resends of a signal already handled are done with here
+            if (!client.accept_signal(buffer)) continue;
             UDPConnection::SIGPacket* pkt = (UDPConnection::SIGPacket*)buffer;
             if (pkt->type == UDPConnection::PACKET_HANGUP) {
 
@@ -2605,6 +2610,11 @@ void JOYSENDER_tUI_FEEDBACK_THREAD(NetworkConnection& client, char* buffer, size
                 }
             }
         }
-        else processFeedbackBuffer((byte*)buffer, activeGamepad, args.mode);
+        else {
+            JOYSENDER_READ_KEYFRAME_ACK(frames, buffer, allGood);
+            JOYSENDER_READ_CLOCK_STAMP(frames, buffer, allGood);
+            JOYSENDER_READ_LINK_REPORT(rate, buffer, allGood);
+            processFeedbackBuffer((byte*)buffer, activeGamepad, args.mode);
+        }
     }
 }
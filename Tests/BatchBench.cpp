@@ -0,0 +1,213 @@
+/*
+Copyright (c) 2025 Dave Quinn <qcent@yahoo.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+
+// Loopback benchmark of the batched datagram path (DatagramBatch.hpp) against one syscall per
+// datagram. Receive: a wait then recvfrom for every datagram, as UDPConnection::receive_data does,
+// against a wait then receive_datagrams. Send: sendto per datagram against send_datagrams.
+// Reports packets per second and CPU per packet, and checks every datagram arrives intact
+
+#include "DatagramBatch.hpp"
+#include "Loopback.hpp"
+#include "NetJoyTest.hpp"
+
+constexpr int DATAGRAM_SIZE = 64;           // a DS4 frame
+constexpr int DATAGRAMS_PER_ROUND = 512;    // fits the receive buffer, nothing is dropped
+
+struct Result {
+    int64_t packets = 0;
+    int64_t wallUs = 0;
+    int64_t cpuUs = 0;
+};
+
+static void fill(char* data, uint32_t n) {
+    std::memset(data, static_cast<int>(n & 0xFF), DATAGRAM_SIZE);
+    std::memcpy(data, &n, sizeof(n));
+}
+
+static bool intact(const char* data, int size, uint32_t n) {
+    char expected[DATAGRAM_SIZE];
+    fill(expected, n);
+    return size == DATAGRAM_SIZE && std::memcmp(data, expected, DATAGRAM_SIZE) == 0;
+}
+
+static bool wait_readable(SOCKET s) {
+    fd_set readSet;
+    FD_ZERO(&readSet);
+    FD_SET(s, &readSet);
+    timeval timeout{ 1, 0 };
+    return select(static_cast<int>(s) + 1, &readSet, nullptr, nullptr, &timeout) > 0;
+}
+
+// Queues a round of datagrams from tx on rx, untimed
+static void queue_round(LoopbackUdp& tx, LoopbackUdp& rx, uint32_t& next) {
+    char data[DATAGRAM_SIZE];
+    for (int i = 0; i < DATAGRAMS_PER_ROUND; ++i) {
+        fill(data, next++);
+        tx.send_to(data, DATAGRAM_SIZE, rx.address());
+    }
+}
+
+static Result receive_single(int rounds) {
+    LoopbackUdp tx, rx(4 << 20);
+    Result r;
+    uint32_t sent = 0, received = 0;
+    char data[UDPBatch::PACKET_SIZE];
+    for (int round = 0; round < rounds; ++round) {
+        queue_round(tx, rx, sent);
+        int64_t wall = netjoy_now_us(), cpu = netjoy_thread_cpu_us();
+        for (int i = 0; i < DATAGRAMS_PER_ROUND; ++i) {
+            if (!wait_readable(rx.handle())) break;
+            int size = static_cast<int>(recvfrom(rx.handle(), data, sizeof(data), 0, nullptr, nullptr));
+            NETJOY_CHECK(intact(data, size, received));
+            ++received;
+        }
+        r.wallUs += netjoy_now_us() - wall;
+        r.cpuUs += netjoy_thread_cpu_us() - cpu;
+    }
+    NETJOY_CHECK_EQ(received, sent);
+    r.packets = received;
+    return r;
+}
+
+static Result receive_batched(int rounds) {
+    LoopbackUdp tx, rx(4 << 20);
+#ifdef _WIN32
+    u_long nonBlocking = 1;
+    ioctlsocket(rx.handle(), FIONBIO, &nonBlocking);
+#endif
+    Result r;
+    UDPBatch batch;
+    uint32_t sent = 0, received = 0;
+    for (int round = 0; round < rounds; ++round) {
+        queue_round(tx, rx, sent);
+        int64_t wall = netjoy_now_us(), cpu = netjoy_thread_cpu_us();
+        int got = 0;
+        while (got < DATAGRAMS_PER_ROUND && wait_readable(rx.handle())) {
+            batch.clear();
+            int error = 0;
+            int n = receive_datagrams(rx.handle(), batch, error);
+            NETJOY_CHECK_EQ(error, 0);
+            for (int i = 0; i < n; ++i) {
+                NETJOY_CHECK(intact(batch.packets[i].data, batch.packets[i].size, received));
+                NETJOY_CHECK(batch.packets[i].address.sin_port == tx.address().sin_port);
+                ++received;
+            }
+            got += n;
+        }
+        r.wallUs += netjoy_now_us() - wall;
+        r.cpuUs += netjoy_thread_cpu_us() - cpu;
+    }
+    NETJOY_CHECK_EQ(received, sent);
+    r.packets = received;
+    return r;
+}
+
+// A datagram too big for a batch packet is skipped, the ones around it still come through
+static void check_oversized() {
+    LoopbackUdp tx, rx;
+#ifdef _WIN32
+    u_long nonBlocking = 1;
+    ioctlsocket(rx.handle(), FIONBIO, &nonBlocking);
+#endif
+    char data[UDPBatch::PACKET_SIZE + 100];
+    fill(data, 0);
+    tx.send_to(data, DATAGRAM_SIZE, rx.address());
+    tx.send_to(data, sizeof(data), rx.address());
+    fill(data, 1);
+    tx.send_to(data, DATAGRAM_SIZE, rx.address());
+    UDPBatch batch;
+    int got = 0, error = 0;
+    while (got < 2 && wait_readable(rx.handle())) got += receive_datagrams(rx.handle(), batch, error);
+    NETJOY_CHECK_EQ(batch.count, 2);
+    NETJOY_CHECK(batch.count == 2 && intact(batch.packets[0].data, batch.packets[0].size, 0) && intact(batch.packets[1].data, batch.packets[1].size, 1));
+}
+
+// Sends rounds of datagrams, one sendto each or a batch at a time, with the receiver drained
+// between rounds (untimed) so it never drops
+static Result send(int rounds, bool batched) {
+    LoopbackUdp tx, rx(4 << 20);
+    Result r;
+    UDPBatch batch;
+    char data[DATAGRAM_SIZE];
+    char in[UDPBatch::PACKET_SIZE];
+    uint32_t next = 0, received = 0;
+    for (int round = 0; round < rounds; ++round) {
+        int64_t wall = netjoy_now_us(), cpu = netjoy_thread_cpu_us();
+        if (batched) {
+            for (int i = 0; i < DATAGRAMS_PER_ROUND; i += UDPBatch::MAX_PACKETS) {
+                batch.clear();
+                for (int j = 0; j < UDPBatch::MAX_PACKETS && i + j < DATAGRAMS_PER_ROUND; ++j) {
+                    fill(data, next++);
+                    batch.add(data, DATAGRAM_SIZE, rx.address());
+                }
+                int error = 0;
+                NETJOY_CHECK_EQ(send_datagrams(tx.handle(), batch, error), batch.count);
+            }
+        }
+        else {
+            for (int i = 0; i < DATAGRAMS_PER_ROUND; ++i) {
+                fill(data, next++);
+                tx.send_to(data, DATAGRAM_SIZE, rx.address());
+            }
+        }
+        r.wallUs += netjoy_now_us() - wall;
+        r.cpuUs += netjoy_thread_cpu_us() - cpu;
+        while (received < next && rx.receive(in, sizeof(in), 1000) > 0) {
+            NETJOY_CHECK(intact(in, DATAGRAM_SIZE, received));
+            ++received;
+        }
+    }
+    NETJOY_CHECK_EQ(received, next);
+    r.packets = next;
+    return r;
+}
+
+static void print(const char* name, const Result& r, const Result* baseline) {
+    double rate = r.packets * 1e6 / (r.wallUs ? r.wallUs : 1);
+    double cpu = r.cpuUs * 1000.0 / (r.packets ? r.packets : 1);
+    std::printf("%-22s %12.0f pkt/s %10.0f ns CPU/pkt", name, rate, cpu);
+    if (baseline) {
+        double baseCpu = baseline->cpuUs * 1000.0 / (baseline->packets ? baseline->packets : 1);
+        std::printf("   %.2fx less CPU", cpu > 0 ? baseCpu / cpu : 0.0);
+    }
+    std::printf("\n");
+}
+
+int main(int argc, char** argv) {
+    const int rounds = netjoy_quick_run(argc, argv) ? 4 : 400;
+#if defined(__linux__)
+    std::printf("batched path: recvmmsg / sendmmsg, %d datagrams of %d bytes\n", rounds * DATAGRAMS_PER_ROUND, DATAGRAM_SIZE);
+#else
+    std::printf("batched path: recvfrom / sendto loop (no recvmmsg here), %d datagrams of %d bytes\n", rounds * DATAGRAMS_PER_ROUND, DATAGRAM_SIZE);
+#endif
+    check_oversized();
+    Result single = receive_single(rounds);
+    Result batched = receive_batched(rounds);
+    print("receive, per datagram", single, nullptr);
+    print("receive, batched", batched, &single);
+    Result sendSingle = send(rounds, false);
+    Result sendBatched = send(rounds, true);
+    print("send, per datagram", sendSingle, nullptr);
+    print("send, batched", sendBatched, &sendSingle);
+    return netjoy_test_result("BatchBench");
+}
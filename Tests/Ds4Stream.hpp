@@ -0,0 +1,76 @@
+/*
+Copyright (c) 2025 Dave Quinn <qcent@yahoo.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#pragma once
+
+#include "NetJoyProtocol.h"
+#include "NetJoyTest.hpp"
+
+constexpr int DS4_TEST_REPORT_SIZE = 61;   // DS4_REPORT_NETWORK_DATA_SIZE
+
+// Generates the DS4 reports a controller in hand would send at a fixed rate: wTimestamp ticking
+// (and wrapping) in 5.33 us units, gyro / accel wandering with noise, and now and then a stick
+// moved, a button pressed, the battery draining, a finger on the touchpad or a full scale jump
+class Ds4Stream {
+private:
+    TestRandom random;
+    char report[DS4_TEST_REPORT_SIZE] = {};
+    uint8_t counter = 0;
+    uint16_t stamp;
+    int16_t motion[DS4_MOTION_WORDS] = { 3, -7, 12, 40, 8180, -410 };
+    int ticks;
+
+    void put_word(int offset, uint16_t word) { std::memcpy(report + offset, &word, sizeof(word)); }
+
+public:
+    int jumpPercent = 1;        // chance of a full scale motion jump per report
+    int controlPercent = 5;     // chance of a stick, button or trigger change per report
+
+    Ds4Stream(uint64_t seed, int rate = 250) : random(seed) {
+        ticks = 1000000 / rate * 3 / 16;
+        stamp = static_cast<uint16_t>(0xFFFF - ticks * 3);  // wraps within the first few reports
+        for (int i = 0; i < 4; ++i) report[i] = static_cast<char>(0x80);
+        report[4] = 0x08;   // dpad released
+        report[DS4_BATTERY_OFFSET] = 0x0B;
+    }
+
+    const char* next() {
+        counter = static_cast<uint8_t>((counter + 1) & 0x3F);
+        report[DS4_SPECIAL_OFFSET] = static_cast<char>((counter << 2) | (report[DS4_SPECIAL_OFFSET] & 0x03));
+        stamp = static_cast<uint16_t>(stamp + ticks);
+        put_word(DS4_TIMESTAMP_OFFSET, stamp);
+
+        for (int i = 0; i < DS4_MOTION_WORDS; ++i) {
+            if (random.chance(jumpPercent)) motion[i] = static_cast<int16_t>(motion[i] >= 0 ? -32768 + random.below(8) : 32767 - random.below(8));
+            else motion[i] = static_cast<int16_t>(motion[i] + random.below(41) - 20);
+            put_word(DS4_MOTION_OFFSET + i * 2, static_cast<uint16_t>(motion[i]));
+        }
+        if (random.chance(controlPercent)) {
+            int which = random.below(DS4_TIMESTAMP_OFFSET);
+            if (which == DS4_SPECIAL_OFFSET) report[which] ^= 0x01;
+            else report[which] = static_cast<char>(random.below(256));
+        }
+        if (random.chance(1)) report[DS4_BATTERY_OFFSET] = static_cast<char>(random.below(12));
+        if (random.chance(2)) report[DS4_TAIL_OFFSET + random.below(DS4_TEST_REPORT_SIZE - DS4_TAIL_OFFSET)] = static_cast<char>(random.below(256));
+        return report;
+    }
+};
@@ -0,0 +1,154 @@
+/*
+Copyright (c) 2025 Dave Quinn <qcent@yahoo.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+
+// FEC over a lossy loopback link: a FrameWriter with parity groups sends through a loss injecting
+// wrapper (a JoyProxy ImpairedLink) to a FecDecoder, which must rebuild every lost datagram its
+// group's parity can cover, byte for byte, and count the rest as lost
+
+#include "NetJoyProtocol.h"
+#include "FecDecoder.hpp"
+#include "Ds4Stream.hpp"
+#include "Loopback.hpp"
+#include <map>
+#include <string>
+
+struct FecRun {
+    int frames = 0;
+    int lostOnLink = 0;         // frame datagrams the link dropped
+    int recovered = 0;          // rebuilt from parity and matching what was sent
+    int unrecovered = 0;        // never arrived nor rebuilt
+    int expectedRecovered = 0;  // groups that lost one frame and kept their parity
+    int expectedLost = 0;       // frames of groups that lost more than parity can rebuild
+};
+
+// exact: the link only drops, so which groups parity can repair is known up front
+static FecRun run_fec(const char* name, const ImpairmentProfile& profile, int group, int frameCount, bool exact) {
+    LoopbackUdp tx, rx;
+    NETJOY_CHECK(tx.ok() && rx.ok());
+    LossySender lossy(tx, rx.address(), profile, 1234);
+    FrameWriter writer;
+    writer.reset(NETJOY_PROTOCOL_FEC, 0, group);
+    FecDecoder fec;
+    fec.reset();
+    Ds4Stream ds4(5);
+
+    std::map<uint16_t, std::string> sent;       // seq -> frame datagram
+    std::map<uint16_t, bool> arrived;           // seq -> arrived or rebuilt
+    std::map<uint16_t, PacketFate> fates;       // seq -> fate of the frame datagram
+    FecRun run;
+    run.frames = frameCount;
+
+    char packet[MAX_DATAGRAM_SIZE];
+    char rebuilt[MAX_FRAME_PACKET_SIZE];
+    int received = 0;
+    auto take = [&](const char* data, int size) {
+        FrameHeader hdr;
+        std::memcpy(&hdr, data, FRAME_HEADER_SIZE);
+        if (hdr.type != FRAME_PARITY) {
+            fec.store(data, size);
+            arrived[hdr.seq] = true;
+            return;
+        }
+        if (exact) {
+            int missing = 0;
+            for (int i = 0; i < hdr.flags; ++i) missing += fates[static_cast<uint16_t>(hdr.seq + i)] != FATE_SENT;
+            if (missing == 1) ++run.expectedRecovered;
+            else if (missing > 1) run.expectedLost += missing;
+        }
+        int rebuiltSize = fec.recover(data, size, rebuilt);
+        if (rebuiltSize <= 0) return;
+        FrameHeader lostHdr;
+        std::memcpy(&lostHdr, rebuilt, FRAME_HEADER_SIZE);
+        const std::string& original = sent[lostHdr.seq];
+        bool same = static_cast<int>(original.size()) == rebuiltSize && std::memcmp(original.data(), rebuilt, rebuiltSize) == 0;
+        NETJOY_CHECK(same);
+        if (same && !arrived[lostHdr.seq]) ++run.recovered;
+        arrived[lostHdr.seq] = true;
+    };
+    auto drain = [&](int64_t now) {
+        int delivered = lossy.flush(now);
+        while (received < delivered) {
+            int size = rx.receive(packet, sizeof(packet), 1000);
+            NETJOY_CHECK(size > 0);
+            if (size <= 0) break;
+            ++received;
+            take(packet, size);
+        }
+    };
+
+    int64_t now = 0;
+    for (int i = 0; i < frameCount; ++i) {
+        int size = writer.write(packet, ds4.next(), DS4_TEST_REPORT_SIZE);
+        FrameHeader hdr;
+        std::memcpy(&hdr, packet, FRAME_HEADER_SIZE);
+        sent[hdr.seq].assign(packet, size);
+        arrived[hdr.seq] = false;
+        fates[hdr.seq] = lossy.send(packet, size, now);
+        if (fates[hdr.seq] != FATE_SENT) ++run.lostOnLink;
+        if (writer.parity_size() > 0) lossy.send(writer.parity_packet(), writer.parity_size(), now);
+        drain(now);
+        now += 4000;    // 250 Hz
+    }
+    drain(now + 10 * ImpairedLink::REORDER_TIMEOUT_US);
+
+    for (const auto& a : arrived) run.unrecovered += a.second ? 0 : 1;
+    NETJOY_CHECK_EQ(fec.recovered, run.recovered);
+    if (exact) {
+        NETJOY_CHECK_EQ(run.recovered, run.expectedRecovered);
+        NETJOY_CHECK_EQ(fec.lost, run.expectedLost);
+        NETJOY_CHECK_EQ(run.unrecovered, run.lostOnLink - run.recovered);
+    }
+    std::printf("%-16s k=%-2d %6d frames  %5d lost on the link  %5d recovered  %5d lost (%.2f%% -> %.2f%%)\n",
+        name, group, run.frames, run.lostOnLink, run.recovered, run.unrecovered,
+        100.0 * run.lostOnLink / run.frames, 100.0 * run.unrecovered / run.frames);
+    return run;
+}
+
+int main() {
+    ImpairmentProfile random;
+    random.loss = 0.05;
+    for (int group : { MIN_FEC_GROUP, 4, 8, MAX_FEC_GROUP }) {
+        FecRun run = run_fec("5% random loss", random, group, 5000, true);
+        NETJOY_CHECK(run.recovered > 0);
+        NETJOY_CHECK(run.unrecovered < run.lostOnLink);
+    }
+
+    // bursts: parity helps much less, a burst takes out several frames of one group
+    ImpairmentProfile bursts;
+    impairment_preset("wifi", bursts);
+    bursts.delayMs = bursts.jitterMs = 0.0;
+    bursts.reorder = bursts.duplicate = 0.0;
+    run_fec("wifi bursts", bursts, 4, 5000, true);
+
+    // the whole wifi preset: late and reordered datagrams may be rebuilt before they turn up
+    ImpairmentProfile wifi;
+    impairment_preset("wifi", wifi);
+    FecRun run = run_fec("wifi", wifi, 4, 5000, false);
+    NETJOY_CHECK(run.unrecovered < run.lostOnLink);
+
+    // nothing lost, nothing rebuilt
+    run = run_fec("clean", ImpairmentProfile(), 4, 1000, true);
+    NETJOY_CHECK_EQ(run.recovered, 0);
+    NETJOY_CHECK_EQ(run.unrecovered, 0);
+    return netjoy_test_result("FecTest");
+}
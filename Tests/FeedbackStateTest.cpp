@@ -0,0 +1,137 @@
+/*
+Copyright (c) 2025 Dave Quinn <qcent@yahoo.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+// FeedbackState with its writers and readers running at once, as the ViGEm callback / DS4
+// feedback thread and the receive loop do. Writers store the rumble bytes, the lightbar bytes or
+// all of them (as the DS4 thread and clear() do), each store making every byte it covers the
+// same value, so a torn snapshot shows as a range with mixed bytes. Readers check every snapshot
+// for that, that the generation never goes back and that one generation always means the same
+// bytes; in the end the generation must count every store, none lost to a race
+
+#include "FeedbackState.hpp"
+#include "NetJoyTest.hpp"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+constexpr int STORES_PER_WRITER = 200000;
+constexpr int READERS = 2;
+
+// A writer's values come from its own band of byte values, so every store changes the bytes:
+// it differs from the writer's last value and from anything the other writers leave
+struct Writer {
+    int offset;
+    int count;
+    int lowest;     // band [lowest, lowest + 85)
+};
+
+struct ReaderResult {
+    uint64_t snapshots = 0;
+    uint64_t generations = 0;   // changes seen
+    uint64_t torn = 0;
+    uint64_t backwards = 0;
+    uint64_t changedInPlace = 0; // same generation, other bytes
+};
+
+static bool uniform(const char* bytes, int from, int to) {
+    for (int i = from + 1; i < to; ++i) {
+        if (bytes[i] != bytes[from]) return false;
+    }
+    return true;
+}
+
+int main() {
+    static_assert(FEEDBACK_DATA_SIZE == 5, "the writers split the bytes as rumble 0-1, lightbar 2-4");
+    const Writer writers[] = { { 0, 2, 1 }, { 2, 3, 86 }, { 0, FEEDBACK_DATA_SIZE, 171 } };
+
+    FeedbackState state;
+    std::atomic<int> writing{ 0 };
+    std::atomic<bool> go{ false };
+    ReaderResult results[READERS];
+    std::vector<std::thread> threads;
+
+    for (int r = 0; r < READERS; ++r) {
+        threads.emplace_back([&, r] {
+            ReaderResult& result = results[r];
+            uint64_t last = state.load();
+            char bytes[FEEDBACK_DATA_SIZE];
+            while (!go.load()) std::this_thread::yield();
+            do {
+                const uint64_t snapshot = state.load();
+                ++result.snapshots;
+                FeedbackState::copy(snapshot, bytes);
+                if (!uniform(bytes, 0, 2) || !uniform(bytes, 2, FEEDBACK_DATA_SIZE)) ++result.torn;
+                const uint32_t g = FeedbackState::generation(snapshot), lastG = FeedbackState::generation(last);
+                if (g < lastG) ++result.backwards;
+                else if (g == lastG && snapshot != last) ++result.changedInPlace;
+                else if (g > lastG) ++result.generations;
+                last = snapshot;
+                if (result.snapshots % 64 == 0) std::this_thread::yield();
+            } while (writing.load() > 0);
+        });
+    }
+
+    writing.store(static_cast<int>(sizeof(writers) / sizeof(writers[0])));
+    for (const Writer& w : writers) {
+        threads.emplace_back([&, w] {
+            char bytes[FEEDBACK_DATA_SIZE];
+            while (!go.load()) std::this_thread::yield();
+            for (int i = 0; i < STORES_PER_WRITER; ++i) {
+                std::memset(bytes, w.lowest + i % 85, sizeof(bytes));
+                state.store(bytes, w.offset, w.count);
+                // hand the CPU over now and then, so the threads interleave on a single core too
+                if (i % 64 == 0) std::this_thread::yield();
+            }
+            writing.fetch_sub(1);
+        });
+    }
+
+    const int64_t start = netjoy_now_us();
+    go.store(true);
+    for (std::thread& t : threads) t.join();
+    const int64_t us = netjoy_now_us() - start;
+
+    const uint32_t stores = 3 * STORES_PER_WRITER;
+    NETJOY_CHECK_EQ(FeedbackState::generation(state.load()), stores & 0xFFFFFF);
+    char bytes[FEEDBACK_DATA_SIZE];
+    FeedbackState::copy(state.load(), bytes);
+    NETJOY_CHECK(uniform(bytes, 0, 2) && uniform(bytes, 2, FEEDBACK_DATA_SIZE));
+    for (const ReaderResult& r : results) {
+        std::printf("reader: %llu snapshots, %llu generations seen\n", static_cast<unsigned long long>(r.snapshots),
+            static_cast<unsigned long long>(r.generations));
+        NETJOY_CHECK_EQ(r.torn, 0);
+        NETJOY_CHECK_EQ(r.backwards, 0);
+        NETJOY_CHECK_EQ(r.changedInPlace, 0);
+        NETJOY_CHECK(r.generations > 0);
+    }
+    std::printf("%u stores from 3 writers in %.1f ms\n", stores, us / 1000.0);
+
+    // a store that changes nothing keeps the generation
+    const uint32_t g = FeedbackState::generation(state.load());
+    state.store(bytes);
+    state.store(bytes + 2, 2, 3);
+    NETJOY_CHECK_EQ(FeedbackState::generation(state.load()), g);
+    state.clear();
+    NETJOY_CHECK_EQ(FeedbackState::generation(state.load()), g + 1);
+    NETJOY_CHECK_EQ(state.load() & FeedbackState::DATA_MASK, 0);
+    return netjoy_test_result("FeedbackStateTest");
+}
@@ -0,0 +1,102 @@
+/*
+Copyright (c) 2025 Dave Quinn <qcent@yahoo.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+// Timing of FramePacer at the rates the sender and the rumble loop run at, against the plain
+// sleep_for(period) loop it replaced. For each rate: the achieved rate and its error, the
+// spread of the interval between wakes (|interval - period|), how late wakes are past their
+// deadline and the CPU each frame costs (the spin before a deadline)
+
+#include "FramePacer.hpp"
+#include "NetJoyTest.hpp"
+
+struct Result {
+    double achieved = 0.0;
+    LatencyHistogram interval;  // |interval - period|, us
+    LatencyHistogram late;      // us past the deadline
+    uint64_t missed = 0;
+    uint64_t skipped = 0;
+    double cpuPerFrameUs = 0.0;
+};
+
+static Result run_pacer(double rate, int frames) {
+    FramePacer pacer;
+    Result r;
+    pacer.reset(rate);
+    const int64_t period = static_cast<int64_t>(1e6 / rate);
+    int64_t cpu = netjoy_thread_cpu_us();
+    int64_t last = netjoy_now_us();
+    for (int i = 0; i < frames; ++i) {
+        pacer.wait();
+        int64_t now = netjoy_now_us();
+        r.interval.record(std::llabs(now - last - period));
+        last = now;
+    }
+    r.cpuPerFrameUs = static_cast<double>(netjoy_thread_cpu_us() - cpu) / frames;
+    r.achieved = pacer.achieved_rate();
+    r.late = pacer.lateness;
+    r.missed = pacer.missed;
+    r.skipped = pacer.skipped;
+    return r;
+}
+
+// The loop before the pacer: sleep a period after each frame, so every oversleep adds up
+static Result run_sleep(double rate, int frames) {
+    Result r;
+    const int64_t period = static_cast<int64_t>(1e6 / rate);
+    int64_t cpu = netjoy_thread_cpu_us();
+    const int64_t start = netjoy_now_us();
+    int64_t last = start;
+    for (int i = 0; i < frames; ++i) {
+        std::this_thread::sleep_for(std::chrono::microseconds(period));
+        int64_t now = netjoy_now_us();
+        int64_t deadline = start + (i + 1) * period;
+        r.interval.record(std::llabs(now - last - period));
+        r.late.record(now - deadline);
+        if (now - deadline > FramePacer::MISS_THRESHOLD_US) ++r.missed;
+        last = now;
+    }
+    r.cpuPerFrameUs = static_cast<double>(netjoy_thread_cpu_us() - cpu) / frames;
+    r.achieved = frames * 1e6 / (netjoy_now_us() - start);
+    return r;
+}
+
+static void print(const char* loop, double rate, const Result& r) {
+    std::printf("%-6s %4.0f Hz %8.2f %+7.2f%% %7.1f  jitter %s  late %s  %llu missed, %llu skipped\n", loop, rate, r.achieved,
+        (r.achieved - rate) * 100.0 / rate, r.cpuPerFrameUs, r.interval.summary().c_str(), r.late.summary().c_str(),
+        static_cast<unsigned long long>(r.missed), static_cast<unsigned long long>(r.skipped));
+}
+
+int main(int argc, char** argv) {
+    const double seconds = netjoy_quick_run(argc, argv) ? 0.25 : 5.0;
+    const double rates[] = { 60, 125, 250, 500 };
+
+    std::printf("loop   rate    achieved   error  cpu us  (p50 / p90 / p99 / p99.9 / max)\n");
+    for (double rate : rates) {
+        const int frames = static_cast<int>(rate * seconds);
+        Result paced = run_pacer(rate, frames);
+        Result slept = run_sleep(rate, frames);
+        print("pacer", rate, paced);
+        print("sleep", rate, slept);
+    }
+    std::printf("(a wake a whole period late re-anchors the pacer, counted as skipped)\n");
+    return 0;
+}
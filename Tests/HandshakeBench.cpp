@@ -0,0 +1,234 @@
+/*
+Copyright (c) 2025 Dave Quinn <qcent@yahoo.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+// Connect time of the UDP handshake over loopback with loss, against the one it replaced, timed
+// from the client's poke to the server holding the connection. The two sides follow
+// UDPConnection: the client pokes then sends a SYN and answers the SYN_ACK with an ACK.
+//   old: the receiver polls a non-blocking socket every 10 ms, then sleeps 10 ms and expects the
+//        SYN at once; SYN_ACK and ACK are never resent, only read again up to 3 times 30 ms apart
+//   new: the receiver wakes on the poke (or a SYN that beat it), the SYN and SYN_ACK are resent
+//        on a doubling timer (50 ms up to 400 ms) until answered or the 1 s budget is spent
+
+#include "LatencyHistogram.hpp"
+#include "NetJoyTest.hpp"
+#include "Loopback.hpp"
+#include <thread>
+
+enum : uint8_t { SIG_SYN = 1, SIG_SYN_ACK, SIG_ACK };
+struct Sig { uint8_t type; uint8_t unused; uint16_t session; };
+
+constexpr int HANDSHAKE_TIMEOUT_MS = 1000;
+constexpr int HANDSHAKE_RTO_MS = 50;
+constexpr int HANDSHAKE_MAX_RTO_MS = 400;
+constexpr int64_t TRIAL_BUDGET_US = 1500000;    // the receiver gives up waiting for a poke
+
+// One side of the link: what it sends passes through its own lossy wrapper
+struct Peer {
+    LoopbackUdp socket;
+    LossySender* out = nullptr;
+
+    void send_sig(uint8_t type, uint16_t session) {
+        Sig s{ type, 0, session };
+        out->send(reinterpret_cast<const char*>(&s), sizeof(s), netjoy_now_us());
+    }
+    void poke() {
+        char b = 0;
+        out->send(&b, 1, netjoy_now_us());
+    }
+    // Size of the next datagram within timeoutMs (0 polls), 0 on timeout
+    int receive(Sig& s, int timeoutMs) {
+        char data[64];
+        int len = socket.receive(data, sizeof(data), timeoutMs);
+        if (len == sizeof(Sig)) std::memcpy(&s, data, sizeof(s));
+        return len > 0 ? len : 0;
+    }
+    // Next Sig before deadline (netjoy_now_us), skipping pokes
+    bool receive_until(Sig& s, int64_t deadline) {
+        for (int64_t now = netjoy_now_us(); now < deadline; now = netjoy_now_us()) {
+            if (receive(s, static_cast<int>((deadline - now + 999) / 1000)) == sizeof(Sig)) return true;
+        }
+        return false;
+    }
+};
+
+static void sleep_ms(int ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+
+static bool old_client(Peer& c, uint16_t session) {
+    c.poke();
+    c.send_sig(SIG_SYN, session);
+    Sig s{};
+    sleep_ms(10);
+    int len = c.receive(s, 1000);   // SO_RCVTIMEO of 1 s
+    for (int retries = 0; retries < 3; ++retries) {
+        if (len == 0) {
+            sleep_ms(30);
+            len = c.receive(s, 1000);
+            continue;
+        }
+        if (s.type == SIG_SYN_ACK && s.session == session) {
+            c.send_sig(SIG_ACK, session);
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool old_server(Peer& s, int64_t start) {
+    Sig p{};
+    for (;;) {     // await_connection on a non-blocking socket, SIGPackets ignored
+        int len = s.receive(p, 0);
+        if (len > 0 && len != sizeof(Sig)) break;
+        if (netjoy_now_us() - start > TRIAL_BUDGET_US) return false;
+        sleep_ms(10);
+    }
+    sleep_ms(10);
+    if (s.receive(p, 0) != sizeof(Sig) || p.type != SIG_SYN) return false;
+    const uint16_t session = p.session;
+    s.send_sig(SIG_SYN_ACK, session);
+    sleep_ms(10);
+    Sig ack{};
+    int len = s.receive(ack, 0);
+    for (int retries = 0; retries < 3; ++retries) {
+        if (len == 0) {
+            sleep_ms(30);
+            len = s.receive(ack, 0);
+            continue;
+        }
+        if (ack.type == SIG_ACK && ack.session == session) return true;
+    }
+    return false;
+}
+
+static bool new_client(Peer& c, uint16_t session) {
+    c.poke();
+    const int64_t deadline = netjoy_now_us() + HANDSHAKE_TIMEOUT_MS * 1000LL;
+    int64_t resendAt = 0;
+    int64_t rto = HANDSHAKE_RTO_MS * 1000LL;
+    for (int64_t now = netjoy_now_us(); now < deadline; now = netjoy_now_us()) {
+        if (now >= resendAt) {
+            c.send_sig(SIG_SYN, session);
+            resendAt = now + rto;
+            if (rto < HANDSHAKE_MAX_RTO_MS * 1000LL) rto *= 2;
+        }
+        Sig s{};
+        if (c.receive_until(s, resendAt < deadline ? resendAt : deadline) &&
+            s.type == SIG_SYN_ACK && s.session == session) {
+            c.send_sig(SIG_ACK, session);
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool new_server(Peer& s, int64_t start) {
+    Sig p{};
+    int len = 0;
+    while (len == 0) {  // wait_for_connection, then await_connection takes the first datagram
+        if (netjoy_now_us() - start > TRIAL_BUDGET_US) return false;
+        len = s.receive(p, 100);
+        if (len == sizeof(Sig) && p.type != SIG_SYN) len = 0;
+    }
+    bool haveSyn = (len == sizeof(Sig));
+    uint16_t session = haveSyn ? p.session : 0;
+
+    const int64_t deadline = netjoy_now_us() + HANDSHAKE_TIMEOUT_MS * 1000LL;
+    int64_t resendAt = 0;
+    int64_t rto = HANDSHAKE_RTO_MS * 1000LL;
+    for (int64_t now = netjoy_now_us(); now < deadline; now = netjoy_now_us()) {
+        if (haveSyn && now >= resendAt) {
+            s.send_sig(SIG_SYN_ACK, session);
+            resendAt = now + rto;
+            if (rto < HANDSHAKE_MAX_RTO_MS * 1000LL) rto *= 2;
+        }
+        Sig r{};
+        if (!s.receive_until(r, (haveSyn && resendAt < deadline) ? resendAt : deadline)) continue;
+        if (r.type == SIG_SYN) {
+            if (!haveSyn || r.session != session) {
+                session = r.session;
+                haveSyn = true;
+                rto = HANDSHAKE_RTO_MS * 1000LL;
+            }
+            resendAt = 0;
+        }
+        else if (haveSyn && r.type == SIG_ACK && r.session == session) {
+            return true;
+        }
+    }
+    return false;
+}
+
+struct Result {
+    LatencyHistogram connect;   // poke to the server holding the connection, us
+    int trials = 0;
+    int connected = 0;
+};
+
+static void run(bool oldHandshake, double loss, int trials, Result& r) {
+    ImpairmentProfile profile;
+    profile.loss = loss;
+    for (int i = 0; i < trials; ++i) {
+        Peer client, server;
+        NETJOY_CHECK(client.socket.ok() && server.socket.ok());
+        LossySender toServer(client.socket, server.socket.address(), profile, 1000 + i);
+        LossySender toClient(server.socket, client.socket.address(), profile, 5000 + i);
+        client.out = &toServer;
+        server.out = &toClient;
+        const uint16_t session = static_cast<uint16_t>(i + 1);
+
+        const int64_t start = netjoy_now_us();
+        int64_t establishedAt = 0;
+        std::thread receiver([&] {
+            if (oldHandshake ? old_server(server, start) : new_server(server, start)) establishedAt = netjoy_now_us();
+        });
+        if (oldHandshake) old_client(client, session);
+        else new_client(client, session);
+        receiver.join();
+
+        ++r.trials;
+        if (establishedAt) {
+            ++r.connected;
+            r.connect.record(establishedAt - start);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    const bool quick = netjoy_quick_run(argc, argv);
+    NETJOY_CHECK(loopback_startup());
+    const int trials = quick ? 4 : 100;
+    const double losses[] = { 0.0, 0.05, 0.2 };
+    const int lossCount = quick ? 1 : 3;    // a lost old handshake costs its client ~4 s
+
+    std::printf("handshake  loss   connected  connect ms (p50 / p90 / p99 / p99.9 / max)\n");
+    for (int l = 0; l < lossCount; ++l) {
+        const double loss = losses[l];
+        Result before, after;
+        run(true, loss, trials, before);
+        run(false, loss, trials, after);
+        std::printf("old        %3.0f%%  %4d/%-4d  %s\n", loss * 100, before.connected, before.trials, before.connect.summary().c_str());
+        std::printf("new        %3.0f%%  %4d/%-4d  %s\n", loss * 100, after.connected, after.trials, after.connect.summary().c_str());
+        // on a clean link the new handshake must connect every time
+        if (loss == 0.0) NETJOY_CHECK_EQ(after.connected, after.trials);
+    }
+    std::printf("(a failed old handshake leaves the sender blocked for up to ~4 s before it can retry)\n");
+    return netjoy_test_result("HandshakeBench");
+}
@@ -0,0 +1,79 @@
+/*
+Copyright (c) 2025 Dave Quinn <qcent@yahoo.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+
+// Throughput of the DS4 motion delta codec and the bytes it saves, on generated 250 Hz streams
+// from a still pad (motion noise only) to a busy one (sticks moving and full scale jumps)
+
+#include "Ds4Stream.hpp"
+#include <vector>
+
+struct BenchCase {
+    const char* name;
+    int controlPercent;
+    int jumpPercent;
+};
+
+int main(int argc, char** argv) {
+    const int reportsPerCase = netjoy_quick_run(argc, argv) ? 20000 : 2000000;
+    const BenchCase cases[] = { { "still", 0, 0 }, { "playing", 5, 0 }, { "busy", 30, 2 } };
+
+    std::printf("%-8s %10s %14s %14s %12s\n", "stream", "bytes", "encode/s", "decode/s", "ns/report");
+    for (const BenchCase& c : cases) {
+        Ds4Stream ds4(42);
+        ds4.controlPercent = c.controlPercent;
+        ds4.jumpPercent = c.jumpPercent;
+        std::vector<char> reports(static_cast<size_t>(reportsPerCase) * DS4_TEST_REPORT_SIZE);
+        for (int i = 0; i < reportsPerCase; ++i) std::memcpy(&reports[static_cast<size_t>(i) * DS4_TEST_REPORT_SIZE], ds4.next(), DS4_TEST_REPORT_SIZE);
+
+        std::vector<char> encoded(static_cast<size_t>(reportsPerCase) * MAX_IMU_DELTA_SIZE);
+        std::vector<int> sizes(reportsPerCase);
+        int64_t bytes = 0;
+        int64_t start = netjoy_now_us();
+        for (int i = 1; i < reportsPerCase; ++i) {
+            sizes[i] = encode_imu_delta(&encoded[static_cast<size_t>(i) * MAX_IMU_DELTA_SIZE], static_cast<uint16_t>(i - 1),
+                &reports[static_cast<size_t>(i - 1) * DS4_TEST_REPORT_SIZE], &reports[static_cast<size_t>(i) * DS4_TEST_REPORT_SIZE], DS4_TEST_REPORT_SIZE);
+            bytes += sizes[i];
+        }
+        int64_t encodeUs = netjoy_now_us() - start;
+
+        char previous[DS4_TEST_REPORT_SIZE];
+        char decoded[DS4_TEST_REPORT_SIZE];
+        std::memcpy(previous, &reports[0], DS4_TEST_REPORT_SIZE);
+        int mismatches = 0;
+        start = netjoy_now_us();
+        for (int i = 1; i < reportsPerCase; ++i) {
+            decode_imu_delta(decoded, previous, DS4_TEST_REPORT_SIZE, &encoded[static_cast<size_t>(i) * MAX_IMU_DELTA_SIZE], sizes[i]);
+            std::memcpy(previous, decoded, DS4_TEST_REPORT_SIZE);
+        }
+        int64_t decodeUs = netjoy_now_us() - start;
+        if (std::memcmp(previous, &reports[static_cast<size_t>(reportsPerCase - 1) * DS4_TEST_REPORT_SIZE], DS4_TEST_REPORT_SIZE) != 0) ++mismatches;
+
+        const double n = reportsPerCase - 1;
+        std::printf("%-8s %10.1f %14.0f %14.0f %5.0f / %-5.0f%s\n", c.name, bytes / n,
+            n * 1e6 / (encodeUs ? encodeUs : 1), n * 1e6 / (decodeUs ? decodeUs : 1),
+            encodeUs * 1000.0 / n, decodeUs * 1000.0 / n, mismatches ? "  MISMATCH" : "");
+        if (mismatches) return 1;
+    }
+    std::printf("(a full report is %d bytes)\n", DS4_TEST_REPORT_SIZE);
+    return 0;
+}
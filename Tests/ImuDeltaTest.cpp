@@ -0,0 +1,269 @@
+/*
+Copyright (c) 2025 Dave Quinn <qcent@yahoo.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+
+// Bit exact round trips of the DS4 motion delta codec (encode_imu_delta / decode_imu_delta) and of
+// ImuDeltaDecoder rebuilding frames that arrive out of order. Raw captures of DS4 reports
+// (DS4_REPORT_NETWORK_DATA_SIZE bytes back to back) given on the command line are replayed too
+
+#include "Ds4Stream.hpp"
+#include <fstream>
+#include <vector>
+
+static void check_zigzag() {
+    char buffer[4];
+    for (int step = -32768; step <= 32767; ++step) {
+        int n = put_zigzag16(buffer, static_cast<int16_t>(step));
+        int magnitude = step < 0 ? -step - 1 : step;
+        NETJOY_CHECK_EQ(n, magnitude < 64 ? 1 : magnitude < 8192 ? 2 : 3);
+        int pos = 0;
+        int16_t back = 0;
+        NETJOY_CHECK(get_zigzag16(buffer, n, pos, back));
+        NETJOY_CHECK_EQ(back, step);
+        NETJOY_CHECK_EQ(pos, n);
+        // cut short, it must not read past the end
+        pos = 0;
+        if (n > 1) NETJOY_CHECK(!get_zigzag16(buffer, n - 1, pos, back));
+    }
+    // over long: a fourth byte, or a value past 16 bits
+    const char overlong[] = { '\x80', '\x80', '\x80', '\x00' };
+    const char tooBig[] = { '\xFF', '\xFF', '\x07' };
+    int pos = 0;
+    int16_t step;
+    NETJOY_CHECK(!get_zigzag16(overlong, sizeof(overlong), pos, step));
+    pos = 0;
+    NETJOY_CHECK(!get_zigzag16(tooBig, sizeof(tooBig), pos, step));
+}
+
+static void put_word(char* report, int offset, uint16_t word) {
+    std::memcpy(report + offset, &word, sizeof(word));
+}
+
+// Pins the wire format: a report counter tick, a timestamp step and one of each varint length
+static void check_golden() {
+    char base[DS4_TEST_REPORT_SIZE] = {};
+    char report[DS4_TEST_REPORT_SIZE] = {};
+    report[DS4_SPECIAL_OFFSET] = 0x04;
+    put_word(report, DS4_TIMESTAMP_OFFSET, 188);
+    put_word(report, DS4_MOTION_OFFSET + 0, 1);
+    put_word(report, DS4_MOTION_OFFSET + 2, 0xFFFF);     // -1
+    put_word(report, DS4_MOTION_OFFSET + 4, 0x7FFF);     // +32767
+    put_word(report, DS4_MOTION_OFFSET + 6, 0x8000);     // -32768
+
+    const unsigned char expected[] = {
+        0x34, 0x12, 0x00,               // baseSeq, flags
+        0x04,                           // bSpecial
+        0xF8, 0x02,                     // wTimestamp +188
+        0x02, 0x01,                     // +1, -1
+        0xFE, 0xFF, 0x03,               // +32767
+        0xFF, 0xFF, 0x03,               // -32768
+        0x00, 0x00,                     // unchanged
+    };
+    char encoded[MAX_IMU_DELTA_SIZE];
+    int size = encode_imu_delta(encoded, 0x1234, base, report, DS4_TEST_REPORT_SIZE);
+    NETJOY_CHECK_EQ(size, sizeof(expected));
+    NETJOY_CHECK(size == sizeof(expected) && std::memcmp(encoded, expected, size) == 0);
+
+    char decoded[DS4_TEST_REPORT_SIZE];
+    NETJOY_CHECK_EQ(decode_imu_delta(decoded, base, DS4_TEST_REPORT_SIZE, encoded, size), DS4_TEST_REPORT_SIZE);
+    NETJOY_CHECK(std::memcmp(decoded, report, DS4_TEST_REPORT_SIZE) == 0);
+}
+
+// Encodes report against base, decodes it back and checks every byte, plus every shorter cut being refused
+static bool round_trip(const char* base, const char* report, int size) {
+    char encoded[MAX_IMU_DELTA_SIZE];
+    char decoded[MAX_FRAME_PAYLOAD_SIZE];
+    int encodedSize = encode_imu_delta(encoded, 7, base, report, size);
+    NETJOY_CHECK(encodedSize > IMU_DELTA_HEADER_SIZE && encodedSize <= MAX_IMU_DELTA_SIZE);
+    if (encodedSize <= 0) return false;
+    bool exact = decode_imu_delta(decoded, base, size, encoded, encodedSize) == size && std::memcmp(decoded, report, size) == 0;
+    NETJOY_CHECK(exact);
+    for (int cut = 0; cut < encodedSize; ++cut) {
+        if (decode_imu_delta(decoded, base, size, encoded, cut) != 0) {
+            NETJOY_CHECK(!"a truncated delta decoded");
+            return false;
+        }
+    }
+    return exact;
+}
+
+// Full scale swings both ways and the wTimestamp wrap, each word stepping across the int16 edge
+static void check_edges() {
+    const uint16_t words[] = { 0x0000, 0x0001, 0x7FFE, 0x7FFF, 0x8000, 0x8001, 0xFFFE, 0xFFFF };
+    char base[DS4_TEST_REPORT_SIZE] = {};
+    char report[DS4_TEST_REPORT_SIZE] = {};
+    for (uint16_t from : words) {
+        for (uint16_t to : words) {
+            put_word(base, DS4_TIMESTAMP_OFFSET, from);
+            put_word(report, DS4_TIMESTAMP_OFFSET, to);
+            for (int i = 0; i < DS4_MOTION_WORDS; ++i) {
+                put_word(base, DS4_MOTION_OFFSET + i * 2, (i & 1) ? to : from);
+                put_word(report, DS4_MOTION_OFFSET + i * 2, (i & 1) ? from : to);
+            }
+            round_trip(base, report, DS4_TEST_REPORT_SIZE);
+        }
+    }
+    put_word(base, DS4_TIMESTAMP_OFFSET, 0xFFF0);
+    put_word(report, DS4_TIMESTAMP_OFFSET, 0x0010);
+    round_trip(base, report, DS4_TEST_REPORT_SIZE);
+
+    // every block flagged at once: controls, battery and the tail
+    std::memset(report, 0x5A, sizeof(report));
+    NETJOY_CHECK(round_trip(base, report, DS4_TEST_REPORT_SIZE));
+}
+
+// Chains each report of a stream off the one rebuilt before it, as the receiver does
+static int check_stream(const std::vector<std::string>& reports) {
+    int failures = 0;
+    for (size_t i = 1; i < reports.size(); ++i) {
+        if (!round_trip(reports[i - 1].data(), reports[i].data(), static_cast<int>(reports[i].size()))) ++failures;
+    }
+    return failures;
+}
+
+static std::vector<std::string> generated_stream(uint64_t seed, int count) {
+    Ds4Stream ds4(seed);
+    std::vector<std::string> reports;
+    for (int i = 0; i < count; ++i) reports.emplace_back(ds4.next(), DS4_TEST_REPORT_SIZE);
+    return reports;
+}
+
+static void check_capture(const char* path) {
+    std::ifstream file(path, std::ios::binary);
+    NETJOY_CHECK(file.good());
+    std::vector<std::string> reports;
+    char record[DS4_TEST_REPORT_SIZE];
+    while (file.read(record, sizeof(record))) reports.emplace_back(record, sizeof(record));
+    NETJOY_CHECK_EQ(check_stream(reports), 0);
+    std::printf("%s: %zu reports replayed\n", path, reports.size());
+}
+
+// Frame seq n is a full report every IMU_ANCHOR_INTERVAL, otherwise a delta against n - 1
+struct TestFrame {
+    FrameHeader hdr{};
+    int size = 0;
+    char payload[MAX_IMU_DELTA_SIZE];
+};
+
+static std::vector<TestFrame> encode_frames(const std::vector<std::string>& reports, uint16_t firstSeq) {
+    std::vector<TestFrame> frames(reports.size());
+    for (size_t i = 0; i < reports.size(); ++i) {
+        TestFrame& f = frames[i];
+        f.hdr.seq = static_cast<uint16_t>(firstSeq + i);
+        if (i % IMU_ANCHOR_INTERVAL == 0) {
+            f.hdr.type = FRAME_REPORT;
+            f.size = DS4_TEST_REPORT_SIZE;
+            std::memcpy(f.payload, reports[i].data(), f.size);
+        }
+        else {
+            f.hdr.type = FRAME_IMU_DELTA;
+            f.size = encode_imu_delta(f.payload, static_cast<uint16_t>(f.hdr.seq - 1), reports[i - 1].data(), reports[i].data(), DS4_TEST_REPORT_SIZE);
+        }
+    }
+    return frames;
+}
+
+// Hands frames to an ImuDeltaDecoder in the given order, returns the reports rebuilt by seq offset
+static std::vector<std::string> decode_frames(ImuDeltaDecoder& imu, const std::vector<TestFrame>& frames, const std::vector<int>& order) {
+    std::vector<std::string> out(frames.size());
+    const uint16_t firstSeq = frames[0].hdr.seq;
+    char report[MAX_FRAME_PAYLOAD_SIZE];
+    for (int index : order) {
+        const TestFrame& f = frames[index];
+        int size;
+        if (f.hdr.type == FRAME_IMU_DELTA) size = imu.decode(f.hdr, f.payload, f.size, report);
+        else {
+            size = f.size;
+            std::memcpy(report, f.payload, size);
+            imu.keep(f.hdr.seq, report, size);
+        }
+        if (size > 0) out[index].assign(report, size);
+        FrameHeader hdr;
+        while ((size = imu.next_ready(hdr, report)) > 0) out[static_cast<uint16_t>(hdr.seq - firstSeq)].assign(report, size);
+    }
+    return out;
+}
+
+static void check_decoder() {
+    const int count = 400;
+    std::vector<std::string> reports = generated_stream(11, count);
+    // seq wraps part way through
+    std::vector<TestFrame> frames = encode_frames(reports, static_cast<uint16_t>(0xFFFF - 100));
+    ImuDeltaDecoder imu;
+
+    // in order
+    std::vector<int> order;
+    for (int i = 0; i < count; ++i) order.push_back(i);
+    imu.reset();
+    NETJOY_CHECK(decode_frames(imu, frames, order) == reports);
+    NETJOY_CHECK_EQ(imu.expired, 0);
+
+    // every fifth frame held back by up to a FEC group, as parity recovers it, and a few swapped pairs
+    TestRandom random(3);
+    std::vector<int> late;
+    order.clear();
+    for (int i = 0; i < count; ++i) {
+        if (i % 5 == 2) late.push_back(i);
+        else if (i % 7 == 3 && i + 1 < count && (i + 1) % 5 != 2) {
+            order.push_back(i + 1);
+            order.push_back(i++);
+        }
+        else order.push_back(i);
+        if (!late.empty() && (random.chance(30) || i - late.front() >= MAX_FEC_GROUP - 1)) {
+            order.push_back(late.front());
+            late.erase(late.begin());
+        }
+    }
+    order.insert(order.end(), late.begin(), late.end());
+    NETJOY_CHECK_EQ(static_cast<int>(order.size()), count);
+    imu.reset();
+    NETJOY_CHECK(decode_frames(imu, frames, order) == reports);
+    NETJOY_CHECK_EQ(imu.expired, 0);
+    NETJOY_CHECK_EQ(imu.held(), 0);
+
+    // lost for good: the chain resumes at the next anchor, and the deltas stuck behind the hole expire
+    order.clear();
+    for (int i = 0; i < count; ++i) {
+        if (i != 9 && i != 100) order.push_back(i);
+    }
+    imu.reset();
+    std::vector<std::string> out = decode_frames(imu, frames, order);
+    int rebuilt = 0;
+    for (int i = 0; i < count; ++i) {
+        if (out[i].empty()) continue;
+        ++rebuilt;
+        NETJOY_CHECK(out[i] == reports[i]);
+    }
+    // 9 and 100 and the deltas chained off them up to the next anchor (16 and 104)
+    NETJOY_CHECK_EQ(rebuilt, count - (16 - 9) - (104 - 100));
+    NETJOY_CHECK_EQ(imu.expired + imu.held(), (16 - 9 - 1) + (104 - 100 - 1));
+}
+
+int main(int argc, char** argv) {
+    check_zigzag();
+    check_golden();
+    check_edges();
+    for (uint64_t seed = 1; seed <= 8; ++seed) NETJOY_CHECK_EQ(check_stream(generated_stream(seed, 2000)), 0);
+    check_decoder();
+    for (int i = 1; i < argc; ++i) check_capture(argv[i]);
+    return netjoy_test_result("ImuDeltaTest");
+}
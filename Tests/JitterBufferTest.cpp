@@ -0,0 +1,151 @@
+/*
+Copyright (c) 2025 Dave Quinn <qcent@yahoo.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+
+// JitterBuffer on a simulated clock: playout order, the late / duplicate / recovered counters,
+// depth following the measured jitter up to its cap, and seq / sender clock wrap
+
+#include "JitterBuffer.hpp"
+#include "NetJoyTest.hpp"
+#include <vector>
+
+constexpr int64_t START = 5000000000LL;    // receiver clock, us
+constexpr int64_t FRAME_US = 4000;          // 250 Hz
+constexpr int64_t TRANSIT_US = 10000;
+
+static FrameHeader frame(uint16_t seq, uint32_t stamp) {
+    FrameHeader hdr{};
+    hdr.type = FRAME_REPORT;
+    hdr.seq = seq;
+    hdr.timestamp = stamp;
+    return hdr;
+}
+
+static bool push(JitterBuffer& jb, uint16_t seq, uint32_t stamp, int64_t arrival, bool redundant = false) {
+    char report[2] = { static_cast<char>(seq), static_cast<char>(seq >> 8) };
+    return jb.push(frame(seq, stamp), report, sizeof(report), arrival, redundant);
+}
+
+static int popped_seq(JitterBuffer& jb, int64_t now) {
+    char out[MAX_FRAME_PAYLOAD_SIZE];
+    if (jb.pop(out, now) != 2) return -1;
+    return static_cast<uint8_t>(out[0]) | (static_cast<uint8_t>(out[1]) << 8);
+}
+
+// constant transit: no jitter, every frame plays the moment it arrives, in order, across both wraps
+static void check_steady() {
+    JitterBuffer jb(50);
+    const uint16_t firstSeq = 0xFFF0;
+    const uint32_t firstStamp = 0xFFFFFFFFu - 20 * FRAME_US;
+    for (int i = 0; i < 64; ++i) {
+        uint16_t seq = static_cast<uint16_t>(firstSeq + i);
+        uint32_t stamp = firstStamp + static_cast<uint32_t>(i * FRAME_US);
+        int64_t arrival = START + i * FRAME_US + TRANSIT_US;
+        NETJOY_CHECK(push(jb, seq, stamp, arrival));
+        NETJOY_CHECK_EQ(jb.time_until_next(arrival), 0);
+        NETJOY_CHECK_EQ(popped_seq(jb, arrival), seq);
+        NETJOY_CHECK_EQ(jb.time_until_next(arrival), -1);
+    }
+    NETJOY_CHECK_EQ(jb.played, 64);
+    NETJOY_CHECK_EQ(jb.droppedLate, 0);
+    NETJOY_CHECK(jb.depth_ms() == 0.0);
+}
+
+static void check_order_and_counters() {
+    JitterBuffer jb(50);
+    int64_t t = START;
+    // 0 sets the base transit, 2 overtakes 1
+    NETJOY_CHECK(push(jb, 0, 0, t + TRANSIT_US));
+    NETJOY_CHECK(push(jb, 2, 2 * FRAME_US, t + 2 * FRAME_US + TRANSIT_US));
+    NETJOY_CHECK(push(jb, 1, FRAME_US, t + 2 * FRAME_US + TRANSIT_US + 100));
+    const int64_t later = t + 10 * FRAME_US + TRANSIT_US;
+    NETJOY_CHECK_EQ(popped_seq(jb, later), 0);
+    NETJOY_CHECK_EQ(popped_seq(jb, later), 1);
+    NETJOY_CHECK_EQ(popped_seq(jb, later), 2);
+
+    // after 2 played: 1 again is late, 2 again a duplicate, a redundant copy of either is ignored
+    NETJOY_CHECK(!push(jb, 1, FRAME_US, later));
+    NETJOY_CHECK(!push(jb, 2, 2 * FRAME_US, later));
+    NETJOY_CHECK(!push(jb, 1, FRAME_US, later, true));
+    NETJOY_CHECK_EQ(jb.droppedLate, 1);
+    NETJOY_CHECK_EQ(jb.droppedDuplicate, 1);
+
+    // 4 arrives, a redundant copy fills in 3 before 4 plays, and a copy of 4 is not a duplicate
+    NETJOY_CHECK(push(jb, 4, 4 * FRAME_US, later));
+    NETJOY_CHECK(push(jb, 3, 3 * FRAME_US, later, true));
+    NETJOY_CHECK(!push(jb, 4, 4 * FRAME_US, later, true));
+    NETJOY_CHECK_EQ(jb.recovered, 1);
+    NETJOY_CHECK_EQ(jb.droppedDuplicate, 1);
+    NETJOY_CHECK_EQ(popped_seq(jb, later), 3);
+    NETJOY_CHECK_EQ(popped_seq(jb, later), 4);
+    NETJOY_CHECK_EQ(jb.received, 6);
+    NETJOY_CHECK_EQ(jb.played, 5);
+}
+
+// transit swinging by 4 ms every frame: the RFC 3550 estimate settles near 4 ms and the depth at
+// three times that, unless the cap is lower. A frame is held for the depth before it plays
+static void check_depth() {
+    for (int cap : { 0, 5, 50 }) {
+        JitterBuffer jb(cap);
+        for (int i = 0; i < 200; ++i) {
+            int64_t arrival = START + i * FRAME_US + TRANSIT_US + ((i & 1) ? 4000 : 0);
+            push(jb, static_cast<uint16_t>(i), static_cast<uint32_t>(i * FRAME_US), arrival);
+            char out[MAX_FRAME_PAYLOAD_SIZE];
+            while (jb.pop(out, arrival) > 0) {}
+        }
+        NETJOY_CHECK(jb.jitter_ms() > 3.9 && jb.jitter_ms() < 4.1);
+        const double expected = cap < 12 ? cap : 3 * jb.jitter_ms();
+        NETJOY_CHECK(jb.depth_ms() > expected - 0.1 && jb.depth_ms() < expected + 0.1);
+
+        // the next frame on time waits out the depth
+        char out[MAX_FRAME_PAYLOAD_SIZE];
+        while (jb.pop(out, START + 1000000) > 0) {}
+        const int64_t sent = 200 * FRAME_US;
+        const int64_t arrival = START + sent + TRANSIT_US;
+        push(jb, 200, static_cast<uint32_t>(sent), arrival);
+        const int64_t wait = jb.time_until_next(arrival);
+        NETJOY_CHECK(wait > static_cast<int64_t>(jb.depth_ms() * 1000) - 10 && wait <= static_cast<int64_t>(jb.depth_ms() * 1000));
+        if (wait > 0) NETJOY_CHECK_EQ(popped_seq(jb, arrival + wait - 1), -1);
+        NETJOY_CHECK_EQ(popped_seq(jb, arrival + wait), 200);
+    }
+}
+
+// a backlog of half the slots plays out at once rather than waiting for its time
+static void check_backlog() {
+    JitterBuffer jb(1000);
+    int64_t t = START;
+    push(jb, 0, 0, t + TRANSIT_US);
+    NETJOY_CHECK_EQ(popped_seq(jb, t + TRANSIT_US), 0);
+    // the sender's clock ran ahead, every later frame looks a second early
+    for (int i = 1; i <= JitterBuffer::SLOTS / 2; ++i) push(jb, static_cast<uint16_t>(i), static_cast<uint32_t>(1000000 + i * FRAME_US), t + TRANSIT_US + i);
+    NETJOY_CHECK_EQ(jb.size(), JitterBuffer::SLOTS / 2);
+    NETJOY_CHECK_EQ(popped_seq(jb, t + TRANSIT_US + 100), 1);
+    NETJOY_CHECK_EQ(popped_seq(jb, t + TRANSIT_US + 100), -1);
+}
+
+int main() {
+    check_steady();
+    check_order_and_counters();
+    check_depth();
+    check_backlog();
+    return netjoy_test_result("JitterBufferTest");
+}
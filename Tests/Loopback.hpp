@@ -0,0 +1,142 @@
+/*
+Copyright (c) 2025 Dave Quinn <qcent@yahoo.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "Impairment.hpp"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef int socklen_t;
+#else
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+typedef int SOCKET;
+#define INVALID_SOCKET (-1)
+#define SOCKET_ERROR (-1)
+#define closesocket close
+#endif
+
+// Starts Winsock once for the process, a no-op elsewhere
+inline bool loopback_startup() {
+#ifdef _WIN32
+    static bool started = false;
+    if (!started) {
+        WSADATA wsaData;
+        started = WSAStartup(MAKEWORD(2, 2), &wsaData) == 0;
+    }
+    return started;
+#else
+    return true;
+#endif
+}
+
+// A UDP socket bound to an ephemeral port on 127.0.0.1
+class LoopbackUdp {
+private:
+    SOCKET sock = INVALID_SOCKET;
+    sockaddr_in bound{};
+
+public:
+    LoopbackUdp(int receiveBufferBytes = 1 << 20) {
+        if (!loopback_startup()) return;
+        sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (sock == INVALID_SOCKET) return;
+        setsockopt(sock, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<const char*>(&receiveBufferBytes), sizeof(receiveBufferBytes));
+        bound.sin_family = AF_INET;
+        bound.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bound.sin_port = 0;
+        socklen_t len = sizeof(bound);
+        if (bind(sock, reinterpret_cast<sockaddr*>(&bound), sizeof(bound)) == SOCKET_ERROR
+            || getsockname(sock, reinterpret_cast<sockaddr*>(&bound), &len) == SOCKET_ERROR) {
+            closesocket(sock);
+            sock = INVALID_SOCKET;
+        }
+    }
+    ~LoopbackUdp() {
+        if (sock != INVALID_SOCKET) closesocket(sock);
+    }
+    LoopbackUdp(const LoopbackUdp&) = delete;
+    LoopbackUdp& operator=(const LoopbackUdp&) = delete;
+
+    bool ok() const { return sock != INVALID_SOCKET; }
+    SOCKET handle() const { return sock; }
+    const sockaddr_in& address() const { return bound; }
+
+    int send_to(const char* data, int size, const sockaddr_in& to) {
+        return static_cast<int>(sendto(sock, data, size, 0, reinterpret_cast<const sockaddr*>(&to), sizeof(to)));
+    }
+
+    // Waits up to timeoutMillisec for a datagram, returns its size, 0 on timeout or < 0 on error
+    int receive(char* buffer, int bufferSize, int timeoutMillisec, sockaddr_in* from = nullptr) {
+        fd_set readSet;
+        FD_ZERO(&readSet);
+        FD_SET(sock, &readSet);
+        timeval timeout{ timeoutMillisec / 1000, (timeoutMillisec % 1000) * 1000 };
+        int ready = select(static_cast<int>(sock) + 1, &readSet, nullptr, nullptr, &timeout);
+        if (ready <= 0) return ready;
+        sockaddr_in peer{};
+        socklen_t len = sizeof(peer);
+        int size = static_cast<int>(recvfrom(sock, buffer, bufferSize, 0, reinterpret_cast<sockaddr*>(&peer), &len));
+        if (from) *from = peer;
+        return size;
+    }
+};
+
+// Loss injecting wrapper: what is sent passes through a JoyProxy ImpairedLink first, on the
+// test's own clock, so a seed gives the same fates every run
+class LossySender {
+private:
+    LoopbackUdp& socket;
+    sockaddr_in to;
+    ImpairedLink link;
+
+public:
+    std::vector<PacketFate> fates;  // of every packet sent, in order
+
+    LossySender(LoopbackUdp& from, const sockaddr_in& destination, const ImpairmentProfile& profile, uint64_t seed)
+        : socket(from), to(destination), link(profile, seed) {}
+
+    // Admits a packet at now and puts on the wire whatever the link lets out by then
+    PacketFate send(const char* data, int size, int64_t now) {
+        PacketFate fate = link.admit(0, data, size, now);
+        fates.push_back(fate);
+        flush(now);
+        return fate;
+    }
+
+    // Datagrams put on the wire so far
+    int flush(int64_t now) {
+        ImpairedLink::Packet p;
+        while (link.pop_due(now, p)) socket.send_to(p.data.data(), static_cast<int>(p.data.size()), to);
+        return static_cast<int>(link.sent);
+    }
+
+    const ImpairedLink& stats() const { return link; }
+};
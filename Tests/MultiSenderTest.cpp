@@ -0,0 +1,166 @@
+/*
+Copyright (c) 2025 Dave Quinn <qcent@yahoo.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+
+// 4 to 16 synthetic senders on their own threads and sockets stream 250 Hz frames over loopback to
+// one receiving socket, which drains them in batches and sorts them into per sender sessions by
+// source address, the way SessionTable does, each with its own jitter buffer. Every session must
+// get every frame of its sender and nothing of anyone else's. The virtual pads behind SessionTable
+// need ViGEm, JoyLoad loads the real receiver on Windows
+
+#include "NetJoyProtocol.h"
+#include "JitterBuffer.hpp"
+#include "DatagramBatch.hpp"
+#include "Loopback.hpp"
+#include "NetJoyTest.hpp"
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+constexpr int XBOX_TEST_REPORT_SIZE = 12;   // XBOX_REPORT_NETWORK_DATA_SIZE
+constexpr int SEND_RATE = 250;
+
+struct TestSession {
+    sockaddr_in address{};
+    JitterBuffer jitter{ 0 };
+    int sender = -1;            // from the first report, every later one must match
+    uint32_t frames = 0;
+    uint32_t played = 0;
+    uint32_t foreign = 0;       // reports of another sender
+    int lastPlayed = -1;
+    bool outOfOrder = false;
+};
+
+static void sender_thread(int id, const sockaddr_in& to, int frames, std::atomic<int>& failures) {
+    LoopbackUdp socket;
+    if (!socket.ok()) {
+        ++failures;
+        return;
+    }
+    FrameWriter writer;
+    writer.reset(NETJOY_PROTOCOL_VERSION);
+    char report[XBOX_TEST_REPORT_SIZE] = {};
+    char packet[MAX_FRAME_PACKET_SIZE];
+    auto next = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; ++i) {
+        report[0] = static_cast<char>(id);
+        std::memcpy(report + 1, &i, sizeof(i));
+        int size = writer.write(packet, report, XBOX_TEST_REPORT_SIZE);
+        if (socket.send_to(packet, size, to) != size) ++failures;
+        next += std::chrono::microseconds(1000000 / SEND_RATE);
+        std::this_thread::sleep_until(next);
+    }
+}
+
+static void run(int senders, int frames) {
+    LoopbackUdp server(8 << 20);
+    NETJOY_CHECK(server.ok());
+#ifdef _WIN32
+    u_long nonBlocking = 1;
+    ioctlsocket(server.handle(), FIONBIO, &nonBlocking);
+#endif
+    std::vector<std::unique_ptr<TestSession>> sessions;
+    std::atomic<int> sendFailures{ 0 };
+    std::vector<std::thread> threads;
+    const int64_t start = netjoy_now_us();
+    for (int id = 0; id < senders; ++id)
+        threads.emplace_back(sender_thread, id, server.address(), frames, std::ref(sendFailures));
+
+    UDPBatch batch;
+    uint64_t datagrams = 0, passes = 0;
+    int largestBatch = 0;
+    const uint64_t expected = static_cast<uint64_t>(senders) * frames;
+    int64_t lastHeard = netjoy_now_us();
+    char report[MAX_FRAME_PAYLOAD_SIZE];
+    while (datagrams < expected && netjoy_now_us() - lastHeard < 2000000) {
+        fd_set readSet;
+        FD_ZERO(&readSet);
+        FD_SET(server.handle(), &readSet);
+        timeval timeout{ 0, 100000 };
+        if (select(static_cast<int>(server.handle()) + 1, &readSet, nullptr, nullptr, &timeout) <= 0) continue;
+        batch.clear();
+        int error = 0;
+        int count = receive_datagrams(server.handle(), batch, error);
+        NETJOY_CHECK_EQ(error, 0);
+        if (count > largestBatch) largestBatch = count;
+        ++passes;
+        lastHeard = netjoy_now_us();
+
+        for (int i = 0; i < count; ++i) {
+            const UDPBatch::Packet& p = batch.packets[i];
+            ++datagrams;
+            TestSession* s = nullptr;
+            for (auto& candidate : sessions) {
+                if (candidate->address.sin_port == p.address.sin_port && candidate->address.sin_addr.s_addr == p.address.sin_addr.s_addr) s = candidate.get();
+            }
+            if (s == nullptr) {
+                sessions.emplace_back(new TestSession());
+                s = sessions.back().get();
+                s->address = p.address;
+            }
+            FrameHeader hdr;
+            NETJOY_CHECK(is_frame_packet(p.data, p.size));
+            std::memcpy(&hdr, p.data, FRAME_HEADER_SIZE);
+            NETJOY_CHECK_EQ(hdr.type, FRAME_REPORT);
+            ++s->frames;
+            s->jitter.push(hdr, p.data + FRAME_HEADER_SIZE, p.size - FRAME_HEADER_SIZE, lastHeard);
+        }
+        // then every session plays what is due, as SessionTable::update does once per pass
+        for (auto& s : sessions) {
+            int size;
+            while ((size = s->jitter.pop(report, lastHeard)) > 0) {
+                int sender = static_cast<uint8_t>(report[0]);
+                int frame;
+                std::memcpy(&frame, report + 1, sizeof(frame));
+                if (s->sender < 0) s->sender = sender;
+                if (sender != s->sender) ++s->foreign;
+                if (frame <= s->lastPlayed) s->outOfOrder = true;
+                s->lastPlayed = frame;
+                ++s->played;
+            }
+        }
+    }
+    for (std::thread& t : threads) t.join();
+    const double seconds = (netjoy_now_us() - start) / 1e6;
+
+    NETJOY_CHECK_EQ(sendFailures.load(), 0);
+    NETJOY_CHECK_EQ(sessions.size(), senders);
+    NETJOY_CHECK_EQ(datagrams, expected);
+    std::vector<bool> seen(senders, false);
+    for (auto& s : sessions) {
+        NETJOY_CHECK_EQ(s->frames, frames);
+        NETJOY_CHECK_EQ(s->played + s->jitter.size(), frames);
+        NETJOY_CHECK_EQ(s->foreign, 0);
+        NETJOY_CHECK(!s->outOfOrder);
+        NETJOY_CHECK(s->sender >= 0 && s->sender < senders && !seen[s->sender]);
+        if (s->sender >= 0 && s->sender < senders) seen[s->sender] = true;
+    }
+    std::printf("%2d senders x %d Hz: %llu datagrams in %.2f s (%.0f/s), %.1f per pass, largest batch %d\n",
+        senders, SEND_RATE, static_cast<unsigned long long>(datagrams), seconds, datagrams / seconds,
+        passes ? static_cast<double>(datagrams) / passes : 0.0, largestBatch);
+}
+
+int main() {
+    for (int senders : { 4, 8, 16 }) run(senders, SEND_RATE);
+    return netjoy_test_result("MultiSenderTest");
+}
@@ -0,0 +1,109 @@
+/*
+Copyright (c) 2025 Dave Quinn <qcent@yahoo.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <ctime>
+#endif
+
+// Checks shared by the portable tests: a failed check prints where it was and fails the run,
+// the rest of the test still runs so one pass shows every failure
+static int netjoyTestFailures = 0;
+
+#define NETJOY_CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            ++netjoyTestFailures; \
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        } \
+    } while (0)
+
+#define NETJOY_CHECK_EQ(a, b) \
+    do { \
+        long long netjoyA = static_cast<long long>(a), netjoyB = static_cast<long long>(b); \
+        if (netjoyA != netjoyB) { \
+            ++netjoyTestFailures; \
+            std::fprintf(stderr, "%s:%d: check failed: %s == %s (%lld != %lld)\n", __FILE__, __LINE__, #a, #b, netjoyA, netjoyB); \
+        } \
+    } while (0)
+
+// Prints the outcome, returns the process exit code
+inline int netjoy_test_result(const char* name) {
+    if (netjoyTestFailures == 0) std::printf("%s: passed\n", name);
+    else std::printf("%s: %d check(s) failed\n", name, netjoyTestFailures);
+    return netjoyTestFailures == 0 ? 0 : 1;
+}
+
+// Benchmarks run a short pass with --quick (as ctest does), the full measurement otherwise
+inline bool netjoy_quick_run(int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--quick") == 0) return true;
+    }
+    return false;
+}
+
+inline int64_t netjoy_now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// CPU time spent by the calling thread, in microseconds
+inline int64_t netjoy_thread_cpu_us() {
+#ifdef _WIN32
+    FILETIME created, exited, kernel, user;
+    GetThreadTimes(GetCurrentThread(), &created, &exited, &kernel, &user);
+    uint64_t k = (static_cast<uint64_t>(kernel.dwHighDateTime) << 32) | kernel.dwLowDateTime;
+    uint64_t u = (static_cast<uint64_t>(user.dwHighDateTime) << 32) | user.dwLowDateTime;
+    return static_cast<int64_t>((k + u) / 10);
+#else
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+// xorshift64*, the same generator JoyProxy rolls its dice with, so a run is repeatable
+class TestRandom {
+private:
+    uint64_t state;
+
+public:
+    explicit TestRandom(uint64_t seed) : state(seed ? seed : 0x9E3779B97F4A7C15ull) {}
+
+    uint64_t next() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 0x2545F4914F6CDD1Dull;
+    }
+    // [0, n)
+    int below(int n) { return static_cast<int>(next() % static_cast<uint64_t>(n)); }
+    bool chance(int percent) { return below(100) < percent; }
+};
@@ -0,0 +1,144 @@
+/*
+Copyright (c) 2025 Dave Quinn <qcent@yahoo.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+
+// Delta reports: encode_delta / decode_delta round trips on the Xbox and DS4 report sizes (odd
+// sized, so the last word is a single byte), and a FrameWriter stream rebuilt the way the
+// receiver does, from keyframes it acknowledges
+
+#include "NetJoyProtocol.h"
+#include "Ds4Stream.hpp"
+
+constexpr int XBOX_TEST_REPORT_SIZE = 12;  // XBOX_REPORT_NETWORK_DATA_SIZE
+
+static void check_delta_codec() {
+    TestRandom random(9);
+    for (int size : { 1, XBOX_TEST_REPORT_SIZE, DS4_TEST_REPORT_SIZE, MAX_FRAME_PAYLOAD_SIZE }) {
+        char base[MAX_FRAME_PAYLOAD_SIZE], report[MAX_FRAME_PAYLOAD_SIZE];
+        char encoded[DELTA_HEADER_SIZE + MAX_FRAME_PAYLOAD_SIZE], decoded[MAX_FRAME_PAYLOAD_SIZE];
+        for (int i = 0; i < size; ++i) base[i] = static_cast<char>(random.below(256));
+        for (int round = 0; round < 500; ++round) {
+            std::memcpy(report, base, size);
+            int changes = random.below(size + 1);
+            for (int c = 0; c < changes; ++c) report[random.below(size)] = static_cast<char>(random.below(256));
+
+            int encodedSize = encode_delta(encoded, 77, base, report, size);
+            DeltaHeader dh;
+            std::memcpy(&dh, encoded, DELTA_HEADER_SIZE);
+            NETJOY_CHECK_EQ(dh.baseSeq, 77);
+            // the bytes of every word that changed, nothing for the rest
+            int expected = DELTA_HEADER_SIZE;
+            for (int w = 0; w * DELTA_WORD_SIZE < size; ++w) {
+                int n = delta_word_size(w, size);
+                if (std::memcmp(base + w * DELTA_WORD_SIZE, report + w * DELTA_WORD_SIZE, n) != 0) expected += n;
+            }
+            NETJOY_CHECK_EQ(encodedSize, expected);
+            NETJOY_CHECK_EQ(decode_delta(decoded, base, size, encoded, encodedSize), size);
+            NETJOY_CHECK(std::memcmp(decoded, report, size) == 0);
+            for (int cut = 0; cut < encodedSize; ++cut) {
+                if (decode_delta(decoded, base, size, encoded, cut) != 0) {
+                    NETJOY_CHECK(!"a truncated delta decoded");
+                    break;
+                }
+            }
+        }
+    }
+}
+
+static void check_seq() {
+    NETJOY_CHECK(seq_newer(1, 0));
+    NETJOY_CHECK(!seq_newer(0, 1));
+    NETJOY_CHECK(!seq_newer(5, 5));
+    NETJOY_CHECK(seq_newer(0, 0xFFFF));
+    NETJOY_CHECK(seq_newer(0x7FFF, 0));
+    NETJOY_CHECK(!seq_newer(0x8000, 0));
+}
+
+// Rebuilds one FrameWriter datagram like InputReceiver::decode_report, returns the report size or 0
+static int rebuild(KeyframeStore& keyframes, const char* packet, int size, char* out, bool& keyframe, uint16_t& seq) {
+    FrameHeader hdr;
+    std::memcpy(&hdr, packet, FRAME_HEADER_SIZE);
+    const char* payload = packet + FRAME_HEADER_SIZE;
+    int payloadSize = size - FRAME_HEADER_SIZE;
+    seq = hdr.seq;
+    keyframe = (hdr.flags & FRAME_FLAG_KEYFRAME) != 0;
+    if (hdr.type == FRAME_DELTA) {
+        DeltaHeader dh;
+        std::memcpy(&dh, payload, DELTA_HEADER_SIZE);
+        int baseSize = 0;
+        const char* base = keyframes.find(dh.baseSeq, baseSize);
+        return base ? decode_delta(out, base, baseSize, payload, payloadSize) : 0;
+    }
+    NETJOY_CHECK_EQ(hdr.type, FRAME_REPORT);
+    std::memcpy(out, payload, payloadSize);
+    if (keyframe) keyframes.store(hdr.seq, payload, payloadSize);
+    return payloadSize;
+}
+
+// Until a keyframe is acknowledged every report goes out whole, a keyframe every KEYFRAME_RETRY_INTERVAL.
+// After the ack, deltas against it and a keyframe every KEYFRAME_INTERVAL
+static void check_writer() {
+    FrameWriter writer;
+    writer.reset(NETJOY_PROTOCOL_DELTA);
+    KeyframeStore keyframes;
+    keyframes.reset();
+    Ds4Stream ds4(17);
+    char packet[MAX_FRAME_PACKET_SIZE];
+    char report[MAX_FRAME_PAYLOAD_SIZE];
+    int keyframeCount = 0, deltas = 0, whole = 0;
+    bool acked = false;
+    for (int i = 0; i < 1000; ++i) {
+        const char* input = ds4.next();
+        int size = writer.write(packet, input, DS4_TEST_REPORT_SIZE);
+        bool keyframe;
+        uint16_t seq;
+        int rebuilt = rebuild(keyframes, packet, size, report, keyframe, seq);
+        NETJOY_CHECK_EQ(seq, i);
+        NETJOY_CHECK_EQ(rebuilt, DS4_TEST_REPORT_SIZE);
+        NETJOY_CHECK(std::memcmp(report, input, DS4_TEST_REPORT_SIZE) == 0);
+        if (keyframe) {
+            ++keyframeCount;
+            // the first keyframe goes unacknowledged (as if its feedback was lost), the retry gets through
+            if (keyframeCount == 1) NETJOY_CHECK_EQ(i, 0);
+            if (keyframeCount == 2) NETJOY_CHECK_EQ(i, KEYFRAME_RETRY_INTERVAL);
+            if (keyframeCount > 2) NETJOY_CHECK_EQ((i - KEYFRAME_RETRY_INTERVAL) % KEYFRAME_INTERVAL, 0);
+            if (keyframeCount >= 2) {
+                writer.acknowledge(seq);
+                acked = true;
+            }
+        }
+        else if (packet[0] == FRAME_DELTA) {
+            NETJOY_CHECK(acked);
+            ++deltas;
+        }
+        else ++whole;
+    }
+    NETJOY_CHECK(deltas > 900);
+    std::printf("1000 DS4 reports: %d keyframes, %d deltas, %d whole\n", keyframeCount, deltas, whole);
+}
+
+int main() {
+    check_delta_codec();
+    check_seq();
+    check_writer();
+    return netjoy_test_result("ProtocolTest");
+}
@@ -0,0 +1,225 @@
+/*
+Copyright (c) 2025 Dave Quinn <qcent@yahoo.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+
+// RateController: the AIMD steps one LinkReport at a time, then the controller in a closed loop
+// with an impairment shim, a JoyProxy ImpairedLink with a bottleneck queue, on a simulated clock.
+// From above the bottleneck it has to come down under it and stay there with little loss, and on
+// a clean link climb to the ceiling
+
+#include "RateController.hpp"
+#include "Impairment.hpp"
+#include "NetJoyTest.hpp"
+#include <vector>
+
+static LinkReport report(int rate, double loss = 0.0, int64_t roundTripUs = 10000, int64_t jitterUs = 0) {
+    LinkReport r{};
+    r.rate = static_cast<uint16_t>(rate);
+    r.loss = static_cast<uint8_t>(loss * 256 > 255 ? 255 : loss * 256);
+    r.jitter = static_cast<uint8_t>(jitterUs / 100);
+    r.roundTrip = static_cast<uint16_t>(roundTripUs / 100);
+    return r;
+}
+
+static void check_steps() {
+    RateController rc;
+    int64_t t0;
+
+    // a fixed rate ignores reports
+    rc.reset(125, 0, 0, true);
+    t0 = netjoy_clock_us();   // reset() starts its hold timers on this clock
+    NETJOY_CHECK(!rc.is_adaptive());
+    rc.on_report(report(125, 1.0), t0 + 10000000);
+    NETJOY_CHECK_EQ(rc.rate(), 125);
+
+    // loss: a cut by DECREASE_FACTOR once the hold since the last change has passed, then one per hold
+    rc.reset(200, 60, 500, true);
+    t0 = netjoy_clock_us();
+    NETJOY_CHECK(rc.is_adaptive());
+    int64_t t = t0 + RateController::DECREASE_HOLD_US / 2;
+    rc.on_report(report(200, 0.5), t);
+    NETJOY_CHECK_EQ(rc.rate(), 200);
+    t = t0 + RateController::DECREASE_HOLD_US;
+    rc.on_report(report(200, 0.5), t);
+    NETJOY_CHECK_EQ(rc.rate(), 170);
+    rc.on_report(report(200, 0.5), t + RateController::DECREASE_HOLD_US - 1);
+    NETJOY_CHECK_EQ(rc.rate(), 170);
+    t += RateController::DECREASE_HOLD_US;
+    rc.on_report(report(170, 0.5), t);
+    NETJOY_CHECK_EQ(rc.rate(), 144);
+    // down to the floor and no further
+    for (int i = 0; i < 20; ++i) {
+        t += RateController::DECREASE_HOLD_US;
+        rc.on_report(report(rc.rate(), 0.5), t);
+    }
+    NETJOY_CHECK_EQ(rc.rate(), 60);
+
+    // clean: nothing for INCREASE_HOLD_US after the cut, then +1/20th per INCREASE_STEP_US up to the ceiling
+    rc.reset(100, 60, 120, true);
+    t0 = netjoy_clock_us();
+    t = t0 + RateController::DECREASE_HOLD_US;
+    rc.on_report(report(100, 1.0), t);
+    NETJOY_CHECK_EQ(rc.rate(), 85);
+    const int64_t cut = t;
+    // the smoothed loss has to clear first
+    for (int i = 0; i < 20; ++i) rc.on_report(report(85), cut + 1000 + i);
+    rc.on_report(report(85), cut + RateController::INCREASE_HOLD_US - 1);
+    NETJOY_CHECK_EQ(rc.rate(), 85);
+    rc.on_report(report(85), cut + RateController::INCREASE_HOLD_US);
+    NETJOY_CHECK_EQ(rc.rate(), 89);
+    rc.on_report(report(89), cut + RateController::INCREASE_HOLD_US + RateController::INCREASE_STEP_US - 1);
+    NETJOY_CHECK_EQ(rc.rate(), 89);
+    t = cut + RateController::INCREASE_HOLD_US;
+    for (int i = 0; i < 20; ++i) {
+        t += RateController::INCREASE_STEP_US;
+        rc.on_report(report(rc.rate()), t);
+    }
+    NETJOY_CHECK_EQ(rc.rate(), 120);
+
+    // jitter wider than the frame interval holds the rate where it is
+    rc.reset(100, 60, 200, true);
+    t0 = netjoy_clock_us();
+    t = t0 + RateController::INCREASE_HOLD_US;
+    rc.on_report(report(100, 0.0, 10000, 12000), t);
+    NETJOY_CHECK_EQ(rc.rate(), 100);
+    rc.on_report(report(100, 0.0, 10000, 0), t);
+    NETJOY_CHECK_EQ(rc.rate(), 105);
+
+    // a round trip grown more than QUEUE_DELAY_US (or two frame intervals) past its baseline is
+    // congestion without any loss
+    rc.reset(250, 60, 500, true);
+    t0 = netjoy_clock_us();
+    t = t0 + RateController::DECREASE_HOLD_US;
+    rc.on_report(report(250, 0.0, 10000), t - 1);
+    rc.on_report(report(250, 0.0, 10000 + RateController::QUEUE_DELAY_US), t);
+    NETJOY_CHECK_EQ(rc.rate(), 250);
+    rc.on_report(report(250, 0.0, 10000 + RateController::QUEUE_DELAY_US + 1000), t);
+    NETJOY_CHECK_EQ(rc.rate(), 212);
+
+    // a change is announced until the host's reports carry it, at most every ANNOUNCE_RETRY_US
+    NETJOY_CHECK(rc.announce_due(t0 + 10000000));
+    NETJOY_CHECK(!rc.announce_due(t0 + 10000000 + RateController::ANNOUNCE_RETRY_US - 1));
+    NETJOY_CHECK(rc.announce_due(t0 + 10000000 + RateController::ANNOUNCE_RETRY_US));
+    rc.on_report(report(212, 0.0, 10000), t + 1);
+    NETJOY_CHECK(!rc.announce_due(t0 + 20000000));
+}
+
+struct LoopResult {
+    double meanRate = 0.0;      // reports per second over the second half
+    double loss = 0.0;          // fraction over the second half
+    int finalRate = 0;
+};
+
+// Closed loop on a simulated clock: frames go through the shim, the receiver reports loss, jitter and
+// round trip every FEEDBACK_US over a clean return path, the sender follows rate()
+static LoopResult run_loop(const ImpairmentProfile& shim, int start, int floor, int ceiling, int seconds) {
+    constexpr int DATAGRAM_BYTES = 97;      // DS4 frame + IP / UDP headers
+    constexpr int64_t FEEDBACK_US = 20000;
+    constexpr int64_t RETURN_US = 5000;     // feedback path delay
+
+    ImpairedLink link(shim, 99);
+    RateController rc;
+    rc.reset(start, floor, ceiling, true);
+    const int64_t t0 = netjoy_clock_us();
+    const int64_t end = static_cast<int64_t>(seconds) * 1000000;
+    const std::vector<char> datagram(DATAGRAM_BYTES);
+
+    int64_t nextSend = 0, nextFeedback = FEEDBACK_US;
+    uint32_t arrivedTotal = 0, arrivedReported = 0;
+    uint64_t droppedReported = 0;
+    int64_t lastTransit = -1, newestTransit = 0;
+    double jitter = 0.0;
+    uint64_t halfSent = 0, halfArrived = 0;
+    double rateSum = 0.0;
+    int rateSamples = 0;
+    std::vector<int64_t> sendTimes;
+
+    for (int64_t now = 0; now < end; now += 100) {
+        while (nextSend <= now) {
+            sendTimes.push_back(nextSend);
+            link.admit(0, datagram.data(), DATAGRAM_BYTES, nextSend);
+            if (nextSend >= end / 2) ++halfSent;
+            nextSend += 1000000 / rc.rate();
+        }
+        ImpairedLink::Packet p;
+        while (link.pop_due(now, p)) {
+            const int64_t transit = now - sendTimes[p.id];
+            if (lastTransit >= 0) jitter += (static_cast<double>(transit > lastTransit ? transit - lastTransit : lastTransit - transit) - jitter) / 16.0;
+            lastTransit = transit;
+            newestTransit = transit;
+            ++arrivedTotal;
+            if (sendTimes[p.id] >= end / 2) ++halfArrived;
+        }
+        if (now >= nextFeedback) {
+            // the receiver sees losses as gaps in seq: the frames dropped against those that made it
+            const uint64_t dropped = link.lost + link.queueDrops;
+            const double arrivedInterval = static_cast<double>(arrivedTotal - arrivedReported);
+            const double droppedInterval = static_cast<double>(dropped - droppedReported);
+            const double loss = (arrivedInterval + droppedInterval > 0) ? droppedInterval / (arrivedInterval + droppedInterval) : 0.0;
+            arrivedReported = arrivedTotal;
+            droppedReported = dropped;
+            rc.on_report(report(rc.rate(), loss, newestTransit + RETURN_US, static_cast<int64_t>(jitter)), t0 + now + RETURN_US);
+            nextFeedback += FEEDBACK_US;
+        }
+        if (now >= end / 2 && now % 100000 == 0) {
+            rateSum += rc.rate();
+            ++rateSamples;
+        }
+    }
+    LoopResult result;
+    result.meanRate = rateSamples ? rateSum / rateSamples : 0.0;
+    result.loss = halfSent ? 1.0 - static_cast<double>(halfArrived) / halfSent : 0.0;
+    result.finalRate = rc.rate();
+    return result;
+}
+
+int main() {
+    check_steps();
+
+    // 200 kbit/s with a 4 KB queue carries about 257 reports a second
+    ImpairmentProfile bottleneck;
+    bottleneck.delayMs = 5.0;
+    bottleneck.rateKbps = 200;
+    bottleneck.queueBytes = 4096;
+    const double capacity = bottleneck.rateKbps * 1000.0 / 8 / 97;
+    LoopResult down = run_loop(bottleneck, 500, 60, 1000, 60);
+    std::printf("bottleneck %.0f/s, from 500/s: settles at %.0f/s (%.1f%% lost)\n", capacity, down.meanRate, down.loss * 100.0);
+    NETJOY_CHECK(down.meanRate < capacity);
+    NETJOY_CHECK(down.meanRate > capacity * 0.6);
+    NETJOY_CHECK(down.loss < 0.02);
+
+    // a clean link probes all the way up
+    ImpairmentProfile clean;
+    clean.delayMs = 5.0;
+    LoopResult up = run_loop(clean, 125, 60, 500, 60);
+    std::printf("clean link, from 125/s: %d/s (ceiling 500)\n", up.finalRate);
+    NETJOY_CHECK_EQ(up.finalRate, 500);
+
+    // random loss above the threshold holds it at the floor
+    ImpairmentProfile lossy;
+    lossy.delayMs = 5.0;
+    lossy.loss = 0.15;
+    LoopResult floor = run_loop(lossy, 250, 60, 500, 30);
+    std::printf("15%% random loss, from 250/s: %d/s (floor 60)\n", floor.finalRate);
+    NETJOY_CHECK_EQ(floor.finalRate, 60);
+    return netjoy_test_result("RateControllerTest");
+}
@@ -0,0 +1,199 @@
+/*
+Copyright (c) 2025 Dave Quinn <qcent@yahoo.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+// Handoff between the network and apply threads (PadApplier): SpscRing against a mutex and
+// condition variable queue of the same depth. Throughput pushes reports as fast as the consumer
+// takes them; latency stamps reports pushed at 1 kHz and measures push to pop, first on an
+// idle machine, then with a busy thread on every core contending for the CPU. Every report
+// must arrive once, in order and intact
+
+#include "NetJoyProtocol.h"
+#include "SpscRing.hpp"
+#include "LatencyHistogram.hpp"
+#include "NetJoyTest.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+constexpr int RING_SLOTS = 16;              // APPLY_RING_SLOTS
+constexpr int REPORT_SIZE = MAX_FRAME_PAYLOAD_SIZE;
+
+// What the ring replaces: a bounded queue behind a mutex, the consumer sleeping on a condition
+class MutexQueue {
+private:
+    struct Report {
+        int size;
+        char data[REPORT_SIZE];
+    };
+    std::mutex lock;
+    std::condition_variable pushed;
+    std::deque<Report> queue;
+
+public:
+    bool push(const char* data, int size) {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (queue.size() == RING_SLOTS) return false;
+            queue.emplace_back();
+            queue.back().size = size;
+            std::memcpy(queue.back().data, data, size);
+        }
+        pushed.notify_one();
+        return true;
+    }
+
+    int pop(char* out) {
+        std::lock_guard<std::mutex> guard(lock);
+        if (queue.empty()) return -1;
+        int size = queue.front().size;
+        std::memcpy(out, queue.front().data, size);
+        queue.pop_front();
+        return size;
+    }
+
+    void wait(int timeoutMillisec) {
+        std::unique_lock<std::mutex> guard(lock);
+        pushed.wait_for(guard, std::chrono::milliseconds(timeoutMillisec), [this] { return !queue.empty(); });
+    }
+};
+
+using Ring = SpscRing<RING_SLOTS, REPORT_SIZE>;
+
+struct Report {
+    uint32_t n;
+    int64_t stamp;
+};
+
+static void fill(char* data, uint32_t n, int64_t stamp) {
+    std::memset(data, static_cast<int>(n & 0xFF), REPORT_SIZE);
+    Report r{ n, stamp };
+    std::memcpy(data, &r, sizeof(r));
+}
+
+// Checks the report is the next one and intact, returns its stamp
+static int64_t take(const char* data, int size, uint32_t& expected, int& errors) {
+    Report r;
+    std::memcpy(&r, data, sizeof(r));
+    bool ok = size == REPORT_SIZE && r.n == expected;
+    for (int i = sizeof(r); ok && i < REPORT_SIZE; ++i) ok = data[i] == static_cast<char>(r.n & 0xFF);
+    if (!ok) ++errors;
+    expected = r.n + 1;
+    return r.stamp;
+}
+
+struct Result {
+    double perSecond = 0.0;
+    LatencyHistogram latency;
+    uint32_t full = 0;          // pushes that found the queue full and were retried
+    int errors = 0;
+};
+
+// Pushes count reports, every intervalUs (0 as fast as they go), a consumer thread pops them
+template <typename Queue>
+static Result run(int count, int64_t intervalUs) {
+    Queue queue;
+    Result r;
+    std::thread consumer([&] {
+        char data[REPORT_SIZE];
+        uint32_t expected = 0;
+        while (expected < static_cast<uint32_t>(count)) {
+            int size = queue.pop(data);
+            if (size < 0) {
+                queue.wait(100);
+                continue;
+            }
+            int64_t stamp = take(data, size, expected, r.errors);
+            if (intervalUs > 0) r.latency.record(netjoy_now_us() - stamp);
+        }
+    });
+
+    char data[REPORT_SIZE];
+    const int64_t start = netjoy_now_us();
+    for (int n = 0; n < count; ++n) {
+        if (intervalUs > 0) {
+            const int64_t due = start + n * intervalUs;
+            while (netjoy_now_us() < due) std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        fill(data, static_cast<uint32_t>(n), netjoy_now_us());
+        while (!queue.push(data, REPORT_SIZE)) {
+            ++r.full;
+            std::this_thread::yield();
+        }
+    }
+    consumer.join();
+    r.perSecond = count * 1e6 / (netjoy_now_us() - start);
+    return r;
+}
+
+// A thread per core spinning until stop, so the consumer has to win a CPU back to wake
+class Contention {
+private:
+    std::atomic<bool> stop{ false };
+    std::vector<std::thread> threads;
+
+public:
+    explicit Contention(bool on) {
+        if (!on) return;
+        unsigned cores = std::thread::hardware_concurrency();
+        for (unsigned i = 0; i < (cores ? cores : 1); ++i) {
+            threads.emplace_back([this] {
+                volatile uint64_t spin = 0;
+                while (!stop.load(std::memory_order_relaxed)) ++spin;
+            });
+        }
+    }
+
+    ~Contention() {
+        stop.store(true);
+        for (std::thread& t : threads) t.join();
+    }
+};
+
+int main(int argc, char** argv) {
+    const bool quick = netjoy_quick_run(argc, argv);
+    const int throughputCount = quick ? 100000 : 5000000;
+    const int latencyCount = quick ? 200 : 5000;
+
+    std::printf("throughput, %d byte reports, %d deep\n", REPORT_SIZE, RING_SLOTS);
+    Result ring = run<Ring>(throughputCount, 0);
+    Result mutex = run<MutexQueue>(throughputCount, 0);
+    std::printf("  SpscRing   %12.0f reports/s, %u pushes found it full\n", ring.perSecond, ring.full);
+    std::printf("  MutexQueue %12.0f reports/s, %u pushes found it full\n", mutex.perSecond, mutex.full);
+    NETJOY_CHECK_EQ(ring.errors, 0);
+    NETJOY_CHECK_EQ(mutex.errors, 0);
+
+    std::printf("push to pop latency at 1 kHz, p50 / p90 / p99 / p99.9 / max\n");
+    for (int busy = 0; busy < 2; ++busy) {
+        Contention contention(busy != 0);
+        const char* load = busy ? "busy" : "idle";
+        ring = run<Ring>(latencyCount, 1000);
+        mutex = run<MutexQueue>(latencyCount, 1000);
+        std::printf("  SpscRing   %s  %s\n", load, ring.latency.summary().c_str());
+        std::printf("  MutexQueue %s  %s\n", load, mutex.latency.summary().c_str());
+        NETJOY_CHECK_EQ(ring.errors, 0);
+        NETJOY_CHECK_EQ(mutex.errors, 0);
+    }
+    return netjoy_test_result("SpscRingBench");
+}
@@ -0,0 +1,176 @@
+/*
+Copyright (c) 2025 Dave Quinn <qcent@yahoo.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+
+// StreamReader: length-prefixed messages come out whole and in order however the TCP stream is
+// cut into reads, a DS4 stream written by FrameWriter::write_stream rebuilds byte for byte, and a
+// header announcing too long a message marks the stream corrupt
+
+#include "NetJoyProtocol.h"
+#include "Ds4Stream.hpp"
+#include <string>
+#include <vector>
+
+// Hands out a byte stream in reads of at most chunk bytes, as receive_data would
+struct ChunkedConnection {
+    std::string bytes;
+    size_t pos = 0;
+    int chunk = 1;
+
+    int receive_data(char* buffer, int bufferSize) {
+        int n = static_cast<int>(bytes.size() - pos);
+        if (n > chunk) n = chunk;
+        if (n > bufferSize) n = bufferSize;
+        std::memcpy(buffer, bytes.data() + pos, n);
+        pos += n;
+        return n;
+    }
+    bool done() const { return pos == bytes.size(); }
+};
+
+struct TestMessage {
+    uint8_t type;
+    std::string data;
+};
+
+static void check_chunking() {
+    TestRandom random(23);
+    std::vector<TestMessage> messages;
+    std::string stream;
+    char message[STREAM_HEADER_SIZE + MAX_STREAM_PAYLOAD];
+    // well past STREAM_BUFFER_SIZE, so the buffer has to be compacted along the way
+    while (stream.size() < 8 * STREAM_BUFFER_SIZE) {
+        TestMessage m;
+        m.type = static_cast<uint8_t>(STREAM_INPUT + random.below(4));
+        int size = random.chance(5) ? MAX_STREAM_PAYLOAD : random.below(70);
+        for (int i = 0; i < size; ++i) m.data.push_back(static_cast<char>(random.below(256)));
+        stream.append(message, write_stream_message(message, m.type, m.data.data(), size));
+        messages.push_back(m);
+    }
+
+    for (int chunk : { 1, 2, 3, 7, STREAM_HEADER_SIZE + 1, 64, 200, 1000, STREAM_BUFFER_SIZE }) {
+        ChunkedConnection connection;
+        connection.bytes = stream;
+        connection.chunk = chunk;
+        StreamReader reader;
+        reader.reset();
+        size_t next = 0;
+        bool same = true;
+        while (!connection.done()) {
+            NETJOY_CHECK(reader.fill(connection) > 0);
+            StreamReader::Message msg;
+            while (reader.next(msg)) {
+                same = same && next < messages.size() && msg.type == messages[next].type
+                    && std::string(msg.data, msg.size) == messages[next].data;
+                ++next;
+            }
+        }
+        NETJOY_CHECK(same);
+        NETJOY_CHECK_EQ(next, messages.size());
+        NETJOY_CHECK(!reader.corrupt());
+    }
+}
+
+// append() takes bytes received outside of fill(), as the receiver does with what it drains outside of receive()
+static void check_append() {
+    StreamReader reader;
+    reader.reset();
+    char message[STREAM_HEADER_SIZE + 4];
+    int size = write_stream_message(message, STREAM_SIGNAL, "abcd", 4);
+    NETJOY_CHECK(reader.append(message, 3));
+    StreamReader::Message msg;
+    NETJOY_CHECK(!reader.next(msg));
+    NETJOY_CHECK(reader.append(message + 3, size - 3));
+    NETJOY_CHECK(reader.next(msg));
+    NETJOY_CHECK(msg.type == STREAM_SIGNAL && msg.size == 4 && std::memcmp(msg.data, "abcd", 4) == 0);
+    NETJOY_CHECK(!reader.next(msg));
+
+    // what does not fit is refused rather than cut
+    std::vector<char> big(STREAM_BUFFER_SIZE + 1);
+    NETJOY_CHECK(!reader.append(big.data(), static_cast<int>(big.size())));
+}
+
+static void check_corrupt() {
+    StreamReader reader;
+    reader.reset();
+    StreamHeader header{};
+    header.type = STREAM_INPUT;
+    header.length = MAX_STREAM_PAYLOAD + 1;
+    NETJOY_CHECK(reader.append(reinterpret_cast<const char*>(&header), STREAM_HEADER_SIZE));
+    StreamReader::Message msg;
+    NETJOY_CHECK(!reader.next(msg));
+    NETJOY_CHECK(reader.corrupt());
+    reader.reset();
+    NETJOY_CHECK(!reader.corrupt());
+}
+
+// write_stream sends a DS4 report as motion steps from the one before once the host agreed to them
+static void check_write_stream() {
+    FrameWriter writer;
+    writer.reset(NETJOY_PROTOCOL_IMU);
+    writer.stream = true;
+    writer.imu = true;
+    Ds4Stream ds4(31);
+    std::vector<std::string> reports;
+    ChunkedConnection connection;
+    char message[STREAM_HEADER_SIZE + MAX_FRAME_PAYLOAD_SIZE];
+    int deltas = 0;
+    for (int i = 0; i < 2000; ++i) {
+        reports.emplace_back(ds4.next(), DS4_TEST_REPORT_SIZE);
+        int size = writer.write_stream(message, reports.back().data(), DS4_TEST_REPORT_SIZE);
+        deltas += message[0] == STREAM_IMU_DELTA;
+        connection.bytes.append(message, size);
+    }
+    NETJOY_CHECK(deltas > 1900);
+    connection.chunk = 100;
+
+    StreamReader reader;
+    reader.reset();
+    char previous[MAX_FRAME_PAYLOAD_SIZE];
+    char report[MAX_FRAME_PAYLOAD_SIZE];
+    int previousSize = 0;
+    size_t next = 0;
+    bool same = true;
+    while (!connection.done()) {
+        reader.fill(connection);
+        StreamReader::Message msg;
+        while (reader.next(msg)) {
+            int size = msg.size;
+            if (msg.type == STREAM_IMU_DELTA) size = decode_imu_delta(report, previous, previousSize, msg.data, msg.size);
+            else std::memcpy(report, msg.data, size);
+            same = same && next < reports.size() && std::string(report, size) == reports[next];
+            std::memcpy(previous, report, size);
+            previousSize = size;
+            ++next;
+        }
+    }
+    NETJOY_CHECK(same);
+    NETJOY_CHECK_EQ(next, reports.size());
+}
+
+int main() {
+    check_chunking();
+    check_append();
+    check_corrupt();
+    check_write_stream();
+    return netjoy_test_result("StreamReaderTest");
+}